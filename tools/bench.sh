@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+#  Benchmark of the plugin on the synthetic clips of make_clips.c
+#
+#  Usage: tools/bench.sh [clip directory] > results.jsonl
+#
+#  Expects the plugin and the tools built as described at the top of
+#  tools/voo_driver.c and tools/make_clips.c; PLUGIN, DRIVER and MAKE_CLIPS
+#  point elsewhere. The clips are made once, if the directory does not exist.
+#  Each scenario runs in a process of its own, so its peak RSS is its own.
+#  One JSON object per clip and scenario goes to stdout, see voo_driver.c; the
+#  status is 1 if any clip failed to open or showed a wrong picture.
+#  Settings like VOOPLUS_CACHE=0 or VOOPLUS_THREAD_MODE=gop apply as usual.
+
+dir=${1:-clips}
+PLUGIN=${PLUGIN:-./voo+.so}
+DRIVER=${DRIVER:-./voo_driver}
+MAKE_CLIPS=${MAKE_CLIPS:-./make_clips}
+status=0
+
+if [ ! -d "$dir" ]; then
+	"$MAKE_CLIPS" "$dir" >&2 || exit 1
+fi
+
+for clip in "$dir"/*; do
+	for scenario in play seek reverse scrub; do
+		# seek, reverse and scrub are checked against the pictures played in order
+		case $scenario in
+		play) list=play ;;
+		*) list=play,$scenario ;;
+		esac
+		out=$("$DRIVER" -p "$PLUGIN" -s "$list" "$clip") || status=1
+		printf '%s\n' "$out" | grep "\"scenario\":\"$scenario\""
+	done
+done
+exit $status
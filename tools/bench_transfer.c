@@ -0,0 +1,108 @@
+/**
+ *  Microbenchmark of the plane transfer in voo+.c against plain memcpy
+ *  Copyright (c) 2018  Arion Neddens
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/*
+ *	Build with: gcc -O2 -I. -o bench_transfer tools/bench_transfer.c -lavformat -lavcodec -lavutil -lpthread
+ *
+ *	Prints one line per case: resolution, format, source padding, method, MB/s.
+ */
+
+#include "../voo+.c"
+
+#include <time.h>
+
+#define ITERATIONS 20
+
+typedef struct {
+	const char *name;
+	int32_t width, height;
+	int32_t pel_width;
+	int32_t chr_sh_x, chr_sh_y;
+} bench_case_t;
+
+static const bench_case_t g_cases[] = {
+	{ "1080p 8bit 420", 1920, 1080, 1, 1, 1 },
+	{ "2160p 10bit 420", 3840, 2160, 2, 1, 1 },
+	{ "2160p 10bit 422", 3840, 2160, 2, 1, 0 },
+	{ "4320p 10bit 422", 7680, 4320, 2, 1, 0 },
+	{ "4320p 16bit 444", 7680, 4320, 2, 0, 0 },
+};
+
+static double now_s( void ){
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// what in_load did before: one memcpy per plane, ignoring the source stride
+static void copy_memcpy( const plane_desc_t *planes ){
+	int32_t i;
+	for( i = 0; i < 3; i++ )
+		memcpy( planes[ i ].p_dst, planes[ i ].p_src, (size_t)planes[ i ].row_bytes * planes[ i ].rows );
+}
+
+int main( int argc, char **argv ){
+	size_t c;
+	int32_t pad, i, it, method;
+	static const char *methods[] = { "memcpy", "transfer", "transfer-parallel" };
+
+	for( c = 0; c < sizeof(g_cases) / sizeof(g_cases[ 0 ]); c++ ){
+		const bench_case_t *p_case = &g_cases[ c ];
+		for( pad = 0; pad <= 64; pad += 64 ){
+			plane_desc_t planes[ 3 ];
+			uint8_t *p_src[ 3 ], *p_dst;
+			size_t total = 0;
+
+			for( i = 0; i < 3; i++ ){
+				planes[ i ].row_bytes = planes[ i ].dst_stride = p_case->pel_width * ( i ? p_case->width >> p_case->chr_sh_x : p_case->width );
+				planes[ i ].rows = i ? p_case->height >> p_case->chr_sh_y : p_case->height;
+				planes[ i ].src_stride = planes[ i ].row_bytes + pad;
+				p_src[ i ] = (uint8_t *)av_malloc( (size_t)planes[ i ].src_stride * planes[ i ].rows );
+				memset( p_src[ i ], i + 1, (size_t)planes[ i ].src_stride * planes[ i ].rows );
+				planes[ i ].p_src = p_src[ i ];
+				total += (size_t)planes[ i ].row_bytes * planes[ i ].rows;
+			}
+			p_dst = (uint8_t *)av_malloc( total );
+			memset( p_dst, 0, total );
+			for( i = 0, total = 0; i < 3; i++ ){
+				planes[ i ].p_dst = p_dst + total;
+				total += (size_t)planes[ i ].row_bytes * planes[ i ].rows;
+			}
+
+			for( method = 0; method < 3; method++ ){
+				double t;
+				// memcpy is only a valid reference without padding
+				if( 0 == method && pad )
+					continue;
+				transfer_planes( planes, 3, FALSE ); // warm up
+				t = now_s();
+				for( it = 0; it < ITERATIONS; it++ ){
+					if( 0 == method )
+						copy_memcpy( planes );
+					else
+						transfer_planes( planes, 3, 2 == method );
+				}
+				t = now_s() - t;
+				printf( "%s\tpad=%i\t%s\t%.0f MB/s\n", p_case->name, pad, methods[ method ],
+					total * (double)ITERATIONS / t / ( 1 << 20 ) );
+			}
+			for( i = 0; i < 3; i++ )
+				av_free( p_src[ i ] );
+			av_free( p_dst );
+		}
+	}
+	pool_shutdown();
+	return 0;
+}
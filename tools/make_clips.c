@@ -0,0 +1,252 @@
+/**
+ *  Generator of synthetic test clips for voo+.c
+ *  Copyright (c) 2018  Arion Neddens
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/*
+ *	Build with: gcc -O2 -o make_clips tools/make_clips.c -lavformat -lavcodec -lavutil
+ *
+ *	Usage: make_clips [-s WxH] [-n frames] directory
+ *
+ *	Writes one clip per codec, pixel format and GOP structure into the
+ *	directory (1280x720, 120 frames at 25 fps by default): H.264 and HEVC at
+ *	8 and 10 bit with GOPs of 1, 12 and 120 pictures, ProRes 422 and 4444,
+ *	MJPEG, and uncompressed 4:2:2 as v210 (10 bit) and yuyv (8 bit). Encoders
+ *	this libavcodec lacks, like libx265, or pixel formats an encoder was built
+ *	without, like 10 bit in an 8 bit libx264, are skipped with a note.
+ *
+ *	Every picture differs from every other, a gradient moving with the frame
+ *	number and a bar at a position given by it, so a wrong frame is never
+ *	mistaken for the right one. Encoders run single-threaded and bit-exact:
+ *	the same libraries produce the same files.
+ */
+
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+typedef struct {
+	const char *filename;
+	const char *encoder;
+	enum AVPixelFormat pix_fmt;
+	int32_t gop;                // 1 for intra-only
+	int32_t b_frames;
+	const char *options;        // the encoder's private options, "key=value:key=value"
+} clip_t;
+
+static const clip_t g_clips[] = {
+	{ "h264_gop1.mp4",         "libx264",   AV_PIX_FMT_YUV420P,   1,   0, "preset=veryfast" },
+	{ "h264_gop12.mp4",        "libx264",   AV_PIX_FMT_YUV420P,   12,  2, "preset=veryfast" },
+	{ "h264_gop120.mp4",       "libx264",   AV_PIX_FMT_YUV420P,   120, 3, "preset=veryfast" },
+	{ "h264_10bit_gop12.mov",  "libx264",   AV_PIX_FMT_YUV420P10, 12,  2, "preset=veryfast" },
+	{ "h264_422_10bit_gop1.mov", "libx264", AV_PIX_FMT_YUV422P10, 1,   0, "preset=veryfast" },
+	{ "hevc_gop12.mp4",        "libx265",   AV_PIX_FMT_YUV420P,   12,  2, "preset=veryfast:x265-params=log-level=error" },
+	{ "hevc_gop120.mp4",       "libx265",   AV_PIX_FMT_YUV420P,   120, 3, "preset=veryfast:x265-params=log-level=error" },
+	{ "hevc_10bit_gop12.mp4",  "libx265",   AV_PIX_FMT_YUV420P10, 12,  2, "preset=veryfast:x265-params=log-level=error" },
+	{ "prores_422.mov",        "prores_ks", AV_PIX_FMT_YUV422P10, 1,   0, "profile=2" },
+	{ "prores_4444.mov",       "prores_ks", AV_PIX_FMT_YUV444P10, 1,   0, "profile=4" },
+	{ "mjpeg_422.mov",         "mjpeg",     AV_PIX_FMT_YUVJ422P,  1,   0, NULL },
+	{ "mjpeg_420.mkv",         "mjpeg",     AV_PIX_FMT_YUVJ420P,  1,   0, NULL },
+	{ "v210.mov",              "v210",      AV_PIX_FMT_YUV422P10, 1,   0, NULL },
+	{ "yuyv_8bit.mov",         "rawvideo",  AV_PIX_FMT_YUYV422,   1,   0, NULL },
+};
+
+// Component c of pixel x, y of picture "frame", at full scale of "depth" bits.
+static uint16_t pattern( int32_t c, int32_t x, int32_t y, int32_t frame, int32_t width, int32_t depth ){
+	int32_t bar = ( frame * 37 ) % width, v;
+	if( 0 == c ){
+		v = x >= bar && x < bar + 16 ? 235 : 16 + ( ( x + y + 4 * frame ) & 127 ) + ( ( y / 32 + frame ) & 1 ) * 64;
+		return (uint16_t)( v << ( depth - 8 ) );
+	}
+	v = 128 + ( ( 1 == c ? x : y ) / 8 + frame ) % 64 - 32;
+	return (uint16_t)( v << ( depth - 8 ) );
+}
+
+// Any pixel format libavutil can describe, planar or packed.
+static void fill_picture( AVFrame *p_frame, int32_t frame ){
+	const AVPixFmtDescriptor *p_desc = av_pix_fmt_desc_get( (enum AVPixelFormat)p_frame->format );
+	uint16_t *line = (uint16_t *)malloc( p_frame->width * sizeof(uint16_t) );
+	int32_t c, x, y, w, h, sx, sy;
+
+	for( c = 0; c < p_desc->nb_components; c++ ){
+		sx = c && c < 3 ? p_desc->log2_chroma_w : 0;
+		sy = c && c < 3 ? p_desc->log2_chroma_h : 0;
+		w = AV_CEIL_RSHIFT( p_frame->width, sx );
+		h = AV_CEIL_RSHIFT( p_frame->height, sy );
+		for( y = 0; y < h; y++ ){
+			for( x = 0; x < w; x++ )
+				line[ x ] = pattern( c, x << sx, y << sy, frame, p_frame->width, p_desc->comp[ c ].depth );
+			av_write_image_line( line, p_frame->data, p_frame->linesize, p_desc, 0, y, c, w );
+		}
+	}
+	free( line );
+}
+
+// sends p_frame, NULL to drain, and writes what comes out
+static int32_t encode_write( AVFormatContext *p_oc, AVStream *p_st, AVCodecContext *ctx, AVFrame *p_frame ){
+	AVPacket pkt;
+	int32_t i_ret = avcodec_send_frame( ctx, p_frame );
+
+	av_init_packet( &pkt );
+	pkt.data = NULL;
+	pkt.size = 0;
+	while( 0 <= i_ret ){
+		if( (i_ret = avcodec_receive_packet( ctx, &pkt )) < 0 )
+			break;
+		av_packet_rescale_ts( &pkt, ctx->time_base, p_st->time_base );
+		pkt.stream_index = p_st->index;
+		i_ret = av_interleaved_write_frame( p_oc, &pkt );
+	}
+	return AVERROR( EAGAIN ) == i_ret || AVERROR_EOF == i_ret ? 0 : i_ret;
+}
+
+// 1 written, 0 skipped, negative on errors
+static int32_t make_clip( const clip_t *p_clip, const char *dir, int32_t width, int32_t height, int32_t frames ){
+	AVCodec *p_codec = avcodec_find_encoder_by_name( p_clip->encoder );
+	AVFormatContext *p_oc = NULL;
+	AVCodecContext *ctx = NULL;
+	AVDictionary *p_opts = NULL;
+	AVFrame *p_frame = NULL;
+	AVStream *p_st;
+	char path[ 1024 ], err[ 128 ];
+	int32_t i, i_ret;
+
+	snprintf( path, sizeof(path), "%s/%s", dir, p_clip->filename );
+	if( !p_codec ){
+		printf( "skipped %s: no %s encoder\n", p_clip->filename, p_clip->encoder );
+		return 0;
+	}
+	if( !(ctx = avcodec_alloc_context3( p_codec )) )
+		return AVERROR( ENOMEM );
+	ctx->width = width;
+	ctx->height = height;
+	ctx->pix_fmt = p_clip->pix_fmt;
+	ctx->time_base = av_make_q( 1, 25 );
+	ctx->framerate = av_make_q( 25, 1 );
+	ctx->gop_size = p_clip->gop;
+	ctx->max_b_frames = p_clip->b_frames;
+	ctx->thread_count = 1;
+	ctx->flags |= AV_CODEC_FLAG_BITEXACT;
+	// at a quality worth decoding rather than the default 200 kb/s
+	if( AV_CODEC_ID_MJPEG == p_codec->id ){
+		ctx->flags |= AV_CODEC_FLAG_QSCALE;
+		ctx->global_quality = FF_QP2LAMBDA * 2;
+	}
+
+	if( (i_ret = avformat_alloc_output_context2( &p_oc, NULL, NULL, path )) < 0 )
+		goto fail;
+	if( p_oc->oformat->flags & AVFMT_GLOBALHEADER )
+		ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+	if( p_clip->options )
+		av_dict_parse_string( &p_opts, p_clip->options, "=", ":", 0 );
+	i_ret = avcodec_open2( ctx, p_codec, &p_opts );
+	av_dict_free( &p_opts );
+	if( i_ret < 0 ){
+		av_strerror( i_ret, err, sizeof(err) );
+		printf( "skipped %s: %s cannot encode %s (%s)\n", p_clip->filename, p_clip->encoder, av_get_pix_fmt_name( p_clip->pix_fmt ), err );
+		avformat_free_context( p_oc );
+		avcodec_free_context( &ctx );
+		return 0;
+	}
+
+	if( !(p_st = avformat_new_stream( p_oc, NULL )) ){
+		i_ret = AVERROR( ENOMEM );
+		goto fail;
+	}
+	p_st->time_base = ctx->time_base;
+	if( (i_ret = avcodec_parameters_from_context( p_st->codecpar, ctx )) < 0 )
+		goto fail;
+	p_oc->flags |= AVFMT_FLAG_BITEXACT;
+	if( (i_ret = avio_open( &p_oc->pb, path, AVIO_FLAG_WRITE )) < 0 || (i_ret = avformat_write_header( p_oc, NULL )) < 0 )
+		goto fail;
+
+	if( !(p_frame = av_frame_alloc()) ){
+		i_ret = AVERROR( ENOMEM );
+		goto fail;
+	}
+	p_frame->format = ctx->pix_fmt;
+	p_frame->width = width;
+	p_frame->height = height;
+	if( (i_ret = av_frame_get_buffer( p_frame, 32 )) < 0 )
+		goto fail;
+	for( i = 0; i < frames; i++ ){
+		if( (i_ret = av_frame_make_writable( p_frame )) < 0 )
+			goto fail;
+		fill_picture( p_frame, i );
+		p_frame->pts = i;
+		if( (i_ret = encode_write( p_oc, p_st, ctx, p_frame )) < 0 )
+			goto fail;
+	}
+	if( (i_ret = encode_write( p_oc, p_st, ctx, NULL )) < 0 || (i_ret = av_write_trailer( p_oc )) < 0 )
+		goto fail;
+
+	printf( "wrote %s: %s, %s, %ix%i, %i frames, GOP %i\n", path, p_clip->encoder, av_get_pix_fmt_name( ctx->pix_fmt ),
+		width, height, frames, p_clip->gop );
+	av_frame_free( &p_frame );
+	avio_closep( &p_oc->pb );
+	avformat_free_context( p_oc );
+	avcodec_free_context( &ctx );
+	return 1;
+
+fail:
+	av_strerror( i_ret, err, sizeof(err) );
+	fprintf( stderr, "%s: %s\n", path, err );
+	av_frame_free( &p_frame );
+	if( p_oc ){
+		avio_closep( &p_oc->pb );
+		avformat_free_context( p_oc );
+	}
+	avcodec_free_context( &ctx );
+	return i_ret;
+}
+
+int main( int argc, char **argv ){
+	int32_t width = 1280, height = 720, frames = 120, i, status = 0;
+	const char *dir = NULL;
+	size_t c;
+
+	for( i = 1; i < argc; i++ ){
+		if( !strcmp( argv[ i ], "-s" ) && i + 1 < argc && 2 == sscanf( argv[ i + 1 ], "%dx%d", &width, &height ) )
+			i++;
+		else if( !strcmp( argv[ i ], "-n" ) && i + 1 < argc )
+			frames = atoi( argv[ ++i ] );
+		else if( '-' != argv[ i ][ 0 ] && !dir )
+			dir = argv[ i ];
+		else
+			break;
+	}
+	if( i < argc || !dir || width < 16 || height < 16 || ( width | height ) & 1 || frames < 1 ){
+		fprintf( stderr, "usage: make_clips [-s WxH] [-n frames] directory\n" );
+		return 2;
+	}
+	if( mkdir( dir, 0755 ) && EEXIST != errno ){
+		perror( dir );
+		return 1;
+	}
+
+#if LIBAVFORMAT_VERSION_MAJOR < 58
+	av_register_all();
+#endif
+	av_log_set_level( AV_LOG_ERROR );
+	for( c = 0; c < sizeof(g_clips) / sizeof(g_clips[ 0 ]); c++ )
+		if( make_clip( &g_clips[ c ], dir, width, height, frames ) < 0 )
+			status = 1;
+	return status;
+}
@@ -0,0 +1,394 @@
+/**
+ *  Headless driver for the input plugin: opens movies through input_plugin_t
+ *  as vooya does and measures playback scenarios
+ *  Copyright (c) 2018  Arion Neddens
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/*
+ *	Build the plugin and the driver (Linux) with:
+ *		gcc -O2 -shared -fPIC -o voo+.so voo+.c -lavformat -lavcodec -lavutil -lpthread
+ *		gcc -O2 -I. -o voo_driver tools/voo_driver.c -ldl
+ *
+ *	Usage: voo_driver [-p plugin] [-s scenarios] [-n frames] [-k jumps] [-r seed] [-m] movie...
+ *
+ *	  -p  the plugin library, ./voo+.so by default
+ *	  -s  comma-separated, in this order by default: play,seek,reverse,scrub
+ *	  -n  frames played at most, 300 by default
+ *	  -k  random seeks, backward steps and scrub positions, 64 by default
+ *	  -r  seed of the random seeks
+ *	  -m  the meta information after each scenario, on stderr
+ *
+ *	Every scenario opens the movie anew, so none profits from pictures another
+ *	one left in the plugin's frame cache. Pictures are hashed; those of "play",
+ *	loaded in order, are the reference for the same frames loaded by the
+ *	others. One JSON object per movie and scenario goes to stdout:
+ *
+ *	{"file":"clips/h264_gop12.mp4","scenario":"seek","width":1280,"height":720,
+ *	 "frames":64,"open_ms":3.1,"seconds":0.912,"fps":70.2,
+ *	 "latency_ms":{"p50":12.5,"p95":20.1,"max":31.0},"mismatches":0,
+ *	 "reloads":0,"peak_rss_kb":183312}
+ *
+ *	Latencies are those of seek( ... ) and load( ... ) of a frame together,
+ *	"seconds" their sum. Without "play", the first picture loaded of a frame
+ *	is the reference.
+ *	The peak RSS is the process', so run one scenario per process to compare
+ *	them. The exit status is 1 if a movie did not open or a picture differed
+ *	from the reference.
+ */
+
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "voo_plugin.h"
+
+#define MAX_SCENARIOS 8
+// a rest longer than VOOPLUS_SCRUB_MS, after which the plugin decodes exactly
+#define SCRUB_REST_MS 400
+#define SCRUB_STEP_MS 20
+
+typedef enum { SCENARIO_PLAY, SCENARIO_SEEK, SCENARIO_REVERSE, SCENARIO_SCRUB } scenario_t;
+
+static const char *g_scenario_names[] = { "play", "seek", "reverse", "scrub" };
+
+typedef struct
+{
+	input_plugin_t *p_input;
+	int32_t max_frames;
+	int32_t jumps;
+	uint32_t seed;
+	vooBOOL b_meta;
+} driver_t;
+
+// one movie, across its scenarios
+typedef struct
+{
+	const char *filename;
+	voo_sequence_t info;
+	int32_t frames;           // played at most
+	uint64_t *hashes;         // of the frames played in order, 0 where unknown
+	char *p_buffer;
+} movie_t;
+
+typedef struct
+{
+	double *latencies;        // milliseconds
+	int32_t count;
+	int32_t mismatches;
+	double open_ms;
+	double seconds;           // in seek( ... ) and load( ... ), which excludes hashing and the pauses of scrubbing
+} result_t;
+
+static volatile int g_reloads;
+
+static double now_s( void ){
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void sleep_ms( int32_t ms ){
+	usleep( ms * 1000 );
+}
+
+static void on_message( void *p_cargo, const char *text ){
+	fprintf( stderr, "%s: %s%s", (const char *)p_cargo, text, *text && '\n' == text[ strlen( text ) - 1 ] ? "" : "\n" );
+}
+
+// the plugin asks for this once scrubbing has come to rest
+static int on_reload( void *p_cargo ){
+	__atomic_fetch_add( &g_reloads, 1, __ATOMIC_RELAXED );
+	return 1;
+}
+
+// never 0, which stands for a frame without reference
+static uint64_t hash_picture( const char *p_buffer, size_t size ){
+	uint64_t h = 0xcbf29ce484222325ULL, w;
+	size_t i;
+	for( i = 0; i + 8 <= size; i += 8 ){
+		memcpy( &w, p_buffer + i, 8 );
+		h = ( h ^ w ) * 0x100000001b3ULL;
+	}
+	for( ; i < size; i++ )
+		h = ( h ^ (uint8_t)p_buffer[ i ] ) * 0x100000001b3ULL;
+	return h ? h : 1;
+}
+
+static int compare_doubles( const void *a, const void *b ){
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+static uint32_t next_random( uint32_t *p_state ){
+	*p_state = *p_state * 1664525u + 1013904223u;
+	return *p_state >> 8;
+}
+
+static void print_json_string( const char *s ){
+	putchar( '"' );
+	for( ; *s; s++ ){
+		if( '"' == *s || '\\' == *s )
+			putchar( '\\' );
+		if( (unsigned char)*s >= 0x20 )
+			putchar( *s );
+	}
+	putchar( '"' );
+}
+
+static void print_meta( driver_t *p_driver, void *p_seq ){
+	char key[ 64 ], value[ 1024 ];
+	int idx;
+	if( !p_driver->p_input->get_meta )
+		return;
+	for( idx = 0; key[ 0 ] = value[ 0 ] = 0, p_driver->p_input->get_meta( idx, key, value, p_seq ); idx++ )
+		fprintf( stderr, "  %s: %s\n", key, value );
+}
+
+// Loads "frame" as vooya does after a jump, timed, and checks it against the
+// picture played in order unless it is only an approximation.
+static vooBOOL load_frame( driver_t *p_driver, movie_t *p_movie, void *p_seq, int32_t frame, vooBOOL b_seek, vooBOOL b_check, result_t *p_result ){
+	input_plugin_t *p_input = p_driver->p_input;
+	void *p_frame_user = NULL;
+	vooBOOL b_skipped = FALSE, b_ok;
+	uint64_t h;
+	double start = now_s();
+
+	if( b_seek )
+		p_input->seek( (unsigned int)frame, p_seq );
+	b_ok = p_input->load( (unsigned int)frame, p_movie->p_buffer, &b_skipped, &p_frame_user, p_seq );
+	p_result->latencies[ p_result->count++ ] = ( now_s() - start ) * 1e3;
+	if( !b_ok || b_skipped )
+		return b_ok;
+
+	h = hash_picture( p_movie->p_buffer, p_movie->info.frame_size );
+	if( !b_check )
+		return TRUE;
+	if( !p_movie->hashes[ frame ] )
+		p_movie->hashes[ frame ] = h;
+	else if( p_movie->hashes[ frame ] != h ){
+		fprintf( stderr, "%s: frame %i differs from the one played in order\n", p_movie->filename, frame );
+		p_result->mismatches++;
+	}
+	return TRUE;
+}
+
+static vooBOOL run_scenario( driver_t *p_driver, movie_t *p_movie, scenario_t scenario, result_t *p_result ){
+	input_plugin_t *p_input = p_driver->p_input;
+	voo_app_info_t app_info;
+	void *p_seq = NULL;
+	const char *p_err = NULL;
+	uint32_t state = p_driver->seed;
+	int32_t i, frame, n = 0;
+	double start;
+
+	memset( &app_info, 0, sizeof(app_info) );
+	app_info.pf_console_message = on_message;
+	app_info.p_message_cargo = (void *)p_movie->filename;
+	app_info.pf_trigger_reload = on_reload;
+
+	start = now_s();
+	if( !p_input->open( p_movie->filename, &app_info, &p_seq ) ){
+		if( p_input->error_msg )
+			p_input->error_msg( &p_err, p_seq );
+		fprintf( stderr, "%s: %s\n", p_movie->filename, p_err ? p_err : "cannot be opened" );
+		return FALSE;
+	}
+	if( !p_input->get_properties( &p_movie->info, p_seq ) || !p_movie->info.frame_size ){
+		fprintf( stderr, "%s: no properties\n", p_movie->filename );
+		p_input->close( p_seq );
+		return FALSE;
+	}
+	p_result->open_ms = ( now_s() - start ) * 1e3;
+
+	if( !p_movie->p_buffer ){
+		unsigned int count = p_input->framecount( p_seq );
+		p_movie->frames = ~0U == count || !count || count > (unsigned int)p_driver->max_frames ? p_driver->max_frames : (int32_t)count;
+		p_movie->hashes = (uint64_t *)calloc( p_movie->frames, sizeof(uint64_t) );
+		p_movie->p_buffer = (char *)malloc( p_movie->info.frame_size );
+	}
+	p_result->latencies = (double *)calloc( p_movie->frames + 2 * p_driver->jumps + 1, sizeof(double) );
+	g_reloads = 0;
+
+	switch( scenario ){
+	case SCENARIO_PLAY:
+		p_input->seek( 0, p_seq );
+		for( frame = 0; frame < p_movie->frames && load_frame( p_driver, p_movie, p_seq, frame, FALSE, TRUE, p_result ); frame++ );
+		p_movie->frames = frame; // the container may have promised more
+		break;
+	case SCENARIO_SEEK:
+		for( i = 0; i < p_driver->jumps && p_movie->frames; i++ )
+			load_frame( p_driver, p_movie, p_seq, (int32_t)( next_random( &state ) % (uint32_t)p_movie->frames ), TRUE, TRUE, p_result );
+		break;
+	case SCENARIO_REVERSE:
+		// stepping back from the end, each step a seek and a load as vooya does
+		for( frame = p_movie->frames - 1; frame >= 0 && n < p_driver->jumps; frame--, n++ )
+			load_frame( p_driver, p_movie, p_seq, frame, TRUE, TRUE, p_result );
+		break;
+	case SCENARIO_SCRUB:
+		// dragging the playhead across the movie shows approximations, the
+		// picture it rests on has to be exact once the plugin asks to reload
+		for( i = 0; i < p_driver->jumps && p_movie->frames; i++ ){
+			frame = (int32_t)( (int64_t)i * ( p_movie->frames - 1 ) / ( p_driver->jumps > 1 ? p_driver->jumps - 1 : 1 ) );
+			load_frame( p_driver, p_movie, p_seq, frame, TRUE, FALSE, p_result );
+			sleep_ms( SCRUB_STEP_MS );
+		}
+		if( p_movie->frames ){
+			sleep_ms( SCRUB_REST_MS );
+			load_frame( p_driver, p_movie, p_seq, frame, FALSE, TRUE, p_result );
+		}
+		break;
+	}
+	for( i = 0; i < p_result->count; i++ )
+		p_result->seconds += p_result->latencies[ i ] / 1e3;
+
+	if( p_driver->b_meta ){
+		fprintf( stderr, "%s, %s:\n", p_movie->filename, g_scenario_names[ scenario ] );
+		print_meta( p_driver, p_seq );
+	}
+	p_input->close( p_seq );
+	return TRUE;
+}
+
+static void print_result( const movie_t *p_movie, scenario_t scenario, result_t *p_result ){
+	struct rusage usage;
+	double p50 = 0, p95 = 0, max = 0;
+
+	if( p_result->count ){
+		qsort( p_result->latencies, p_result->count, sizeof(double), compare_doubles );
+		p50 = p_result->latencies[ ( p_result->count - 1 ) / 2 ];
+		p95 = p_result->latencies[ ( p_result->count - 1 ) * 95 / 100 ];
+		max = p_result->latencies[ p_result->count - 1 ];
+	}
+	getrusage( RUSAGE_SELF, &usage );
+	printf( "{\"file\":" );
+	print_json_string( p_movie->filename );
+	printf( ",\"scenario\":\"%s\",\"width\":%i,\"height\":%i,\"frames\":%i,\"open_ms\":%.1f,\"seconds\":%.3f,\"fps\":%.1f,"
+		"\"latency_ms\":{\"p50\":%.2f,\"p95\":%.2f,\"max\":%.2f},\"mismatches\":%i,\"reloads\":%i,\"peak_rss_kb\":%ld}\n",
+		g_scenario_names[ scenario ], p_movie->info.width, p_movie->info.height, p_result->count, p_result->open_ms,
+		p_result->seconds, p_result->seconds > 0 ? p_result->count / p_result->seconds : 0, p50, p95, max,
+		p_result->mismatches, g_reloads, usage.ru_maxrss );
+	fflush( stdout );
+}
+
+static void print_failure( const char *filename, scenario_t scenario ){
+	printf( "{\"file\":" );
+	print_json_string( filename );
+	printf( ",\"scenario\":\"%s\",\"error\":\"cannot be opened\"}\n", g_scenario_names[ scenario ] );
+	fflush( stdout );
+}
+
+// "play,seek" into scenario numbers
+static int32_t parse_scenarios( const char *list, scenario_t *p_scenarios ){
+	int32_t n = 0, s;
+	size_t len;
+	while( *list && n < MAX_SCENARIOS ){
+		len = strcspn( list, "," );
+		for( s = 0; s < 4 && ( strlen( g_scenario_names[ s ] ) != len || strncmp( list, g_scenario_names[ s ], len ) ); s++ );
+		if( 4 == s )
+			return 0;
+		p_scenarios[ n++ ] = (scenario_t)s;
+		list += len + ( ',' == list[ len ] );
+	}
+	return n;
+}
+
+static void usage( void ){
+	fprintf( stderr, "usage: voo_driver [-p plugin] [-s play,seek,reverse,scrub] [-n frames] [-k jumps] [-r seed] [-m] movie...\n" );
+	exit( 2 );
+}
+
+int main( int argc, char **argv ){
+	const char *plugin = "./voo+.so";
+	scenario_t scenarios[ MAX_SCENARIOS ] = { SCENARIO_PLAY, SCENARIO_SEEK, SCENARIO_REVERSE, SCENARIO_SCRUB };
+	int32_t n_scenarios = 4, i, s, opt, status = 0;
+	void (*describe)( voo_plugin_t * );
+	voo_plugin_t plugin_desc;
+	driver_t driver;
+	void *p_lib;
+
+	memset( &driver, 0, sizeof(driver) );
+	driver.max_frames = 300;
+	driver.jumps = 64;
+	driver.seed = 1;
+	while( -1 != (opt = getopt( argc, argv, "p:s:n:k:r:m" )) ){
+		switch( opt ){
+		case 'p': plugin = optarg; break;
+		case 's': if( !(n_scenarios = parse_scenarios( optarg, scenarios )) ) usage(); break;
+		case 'n': driver.max_frames = atoi( optarg ); break;
+		case 'k': driver.jumps = atoi( optarg ); break;
+		case 'r': driver.seed = (uint32_t)strtoul( optarg, NULL, 0 ); break;
+		case 'm': driver.b_meta = TRUE; break;
+		default: usage();
+		}
+	}
+	if( optind >= argc || driver.max_frames < 1 || driver.jumps < 1 )
+		usage();
+
+	if( !(p_lib = dlopen( plugin, RTLD_NOW | RTLD_LOCAL )) ){
+		fprintf( stderr, "%s\n", dlerror() );
+		return 2;
+	}
+	if( !(describe = (void (*)( voo_plugin_t * ))dlsym( p_lib, "voo_describe" )) ){
+		fprintf( stderr, "%s: no voo_describe\n", plugin );
+		return 2;
+	}
+	memset( &plugin_desc, 0, sizeof(plugin_desc) );
+	describe( &plugin_desc );
+	if( VOO_PLUGIN_API_VERSION != plugin_desc.voo_version || !plugin_desc.input.open ){
+		fprintf( stderr, "%s: not an input plugin of API version %i\n", plugin, VOO_PLUGIN_API_VERSION );
+		return 2;
+	}
+	driver.p_input = &plugin_desc.input;
+
+	for( i = optind; i < argc; i++ ){
+		movie_t movie;
+		char magic[ 16 ];
+		FILE *f;
+
+		memset( &movie, 0, sizeof(movie) );
+		movie.filename = argv[ i ];
+		memset( magic, 0, sizeof(magic) );
+		if( (f = fopen( movie.filename, "rb" )) ){
+			if( fread( magic, 1, sizeof(magic), f ) ){}
+			fclose( f );
+		}
+		if( driver.p_input->responsible && !driver.p_input->responsible( movie.filename, magic, plugin_desc.p_user ) )
+			fprintf( stderr, "%s: the plugin does not consider itself responsible, opening it anyway\n", movie.filename );
+
+		for( s = 0; s < n_scenarios; s++ ){
+			result_t result;
+			memset( &result, 0, sizeof(result) );
+			if( run_scenario( &driver, &movie, scenarios[ s ], &result ) )
+				print_result( &movie, scenarios[ s ], &result );
+			else {
+				print_failure( movie.filename, scenarios[ s ] );
+				status = 1;
+			}
+			if( result.mismatches )
+				status = 1;
+			free( result.latencies );
+		}
+		free( movie.hashes );
+		free( movie.p_buffer );
+	}
+
+	if( plugin_desc.on_unload_plugin )
+		plugin_desc.on_unload_plugin( plugin_desc.p_user );
+	dlclose( p_lib );
+	return status;
+}
@@ -13,8 +13,15 @@
  *  Lesser General Public License for more details.
  */
 
+/*
+ *	Build with: gcc -O2 -fPIC -shared -o ./voo+.so voo+.c -lavformat -lavcodec -lavutil -lpthread
+ */
+
 #include <assert.h>
 #include <ctype.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "voo_plugin.h"
 
@@ -28,96 +35,5604 @@
 
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
+#include <libavutil/cpu.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/time.h>
+
+#ifdef WIN32
+	#include <windows.h>
+	#include <process.h>
+	#include <direct.h>
+	#include <io.h>
+	typedef CRITICAL_SECTION voo_mutex_t;
+	typedef CONDITION_VARIABLE voo_cond_t;
+	typedef HANDLE voo_thread_t;
+	typedef INIT_ONCE voo_once_t;
+	#define VOO_ONCE_INIT INIT_ONCE_STATIC_INIT
+#else
+	#include <pthread.h>
+	#include <time.h>
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <poll.h>
+	#include <sys/mman.h>
+	#include <sys/uio.h>
+	typedef pthread_mutex_t voo_mutex_t;
+	typedef pthread_cond_t voo_cond_t;
+	typedef pthread_t voo_thread_t;
+	typedef pthread_once_t voo_once_t;
+	#define VOO_ONCE_INIT PTHREAD_ONCE_INIT
+#endif
+#if defined( __linux__ )
+	#include <sys/inotify.h>
+#endif
+#if defined( __linux__ ) && defined( __has_include )
+	#if __has_include( <linux/io_uring.h> )
+		#include <linux/io_uring.h>
+		#include <sys/syscall.h>
+		#define HAVE_IO_URING 1
+	#endif
+#endif
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+	#include <immintrin.h>
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+	#include <arm_neon.h>
+#endif
+#if defined( __GNUC__ ) || defined( __clang__ )
+	#define TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+#else
+	#define TARGET_AVX2
+#endif
+
+
+// Minimal threading layer, just enough for the background workers below.
+typedef struct {
+	void (*fn)( void * );
+	void *arg;
+} thread_start_t;
+
+#ifdef WIN32
+static unsigned __stdcall thread_trampoline( void *p ){
+	thread_start_t start = *(thread_start_t *)p;
+	free( p );
+	start.fn( start.arg );
+	return 0;
+}
+static void voo_mutex_init( voo_mutex_t *m ){ InitializeCriticalSection( m ); }
+static void voo_mutex_destroy( voo_mutex_t *m ){ DeleteCriticalSection( m ); }
+static void voo_mutex_lock( voo_mutex_t *m ){ EnterCriticalSection( m ); }
+static void voo_mutex_unlock( voo_mutex_t *m ){ LeaveCriticalSection( m ); }
+static void voo_cond_init( voo_cond_t *c ){ InitializeConditionVariable( c ); }
+static void voo_cond_destroy( voo_cond_t *c ){ (void)c; }
+static void voo_cond_wait( voo_cond_t *c, voo_mutex_t *m ){ SleepConditionVariableCS( c, m, INFINITE ); }
+static void voo_cond_timedwait( voo_cond_t *c, voo_mutex_t *m, int32_t ms ){ SleepConditionVariableCS( c, m, ms ); }
+static void voo_cond_broadcast( voo_cond_t *c ){ WakeAllConditionVariable( c ); }
+static vooBOOL voo_thread_create( voo_thread_t *t, void (*fn)( void * ), void *arg ){
+	thread_start_t *p_start = (thread_start_t *)malloc( sizeof(thread_start_t) );
+	p_start->fn = fn;
+	p_start->arg = arg;
+	*t = (HANDLE)_beginthreadex( NULL, 0, thread_trampoline, p_start, 0, NULL );
+	if( !*t ) free( p_start );
+	return *t != NULL;
+}
+static void voo_thread_join( voo_thread_t t ){
+	WaitForSingleObject( t, INFINITE );
+	CloseHandle( t );
+}
+static BOOL CALLBACK once_trampoline( PINIT_ONCE once, PVOID p_fn, PVOID *pp_ctx ){
+	( (void (*)( void ))p_fn )();
+	return TRUE;
+}
+static void voo_once( voo_once_t *o, void (*fn)( void ) ){ InitOnceExecuteOnce( o, once_trampoline, (PVOID)fn, NULL ); }
+static int64_t voo_atomic_get( volatile int64_t *p ){ return InterlockedCompareExchange64( p, 0, 0 ); }
+static void voo_atomic_set( volatile int64_t *p, int64_t v ){ InterlockedExchange64( p, v ); }
+static void voo_atomic_add( volatile int64_t *p, int64_t v ){ InterlockedExchangeAdd64( p, v ); }
+#else
+static void *thread_trampoline( void *p ){
+	thread_start_t start = *(thread_start_t *)p;
+	free( p );
+	start.fn( start.arg );
+	return NULL;
+}
+static void voo_mutex_init( voo_mutex_t *m ){ pthread_mutex_init( m, NULL ); }
+static void voo_mutex_destroy( voo_mutex_t *m ){ pthread_mutex_destroy( m ); }
+static void voo_mutex_lock( voo_mutex_t *m ){ pthread_mutex_lock( m ); }
+static void voo_mutex_unlock( voo_mutex_t *m ){ pthread_mutex_unlock( m ); }
+static void voo_cond_init( voo_cond_t *c ){ pthread_cond_init( c, NULL ); }
+static void voo_cond_destroy( voo_cond_t *c ){ pthread_cond_destroy( c ); }
+static void voo_cond_wait( voo_cond_t *c, voo_mutex_t *m ){ pthread_cond_wait( c, m ); }
+static void voo_cond_timedwait( voo_cond_t *c, voo_mutex_t *m, int32_t ms ){
+	struct timespec ts;
+	clock_gettime( CLOCK_REALTIME, &ts );
+	ts.tv_sec += ms / 1000;
+	ts.tv_nsec += ( ms % 1000 ) * 1000000L;
+	if( ts.tv_nsec >= 1000000000L ){
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+	pthread_cond_timedwait( c, m, &ts );
+}
+static void voo_cond_broadcast( voo_cond_t *c ){ pthread_cond_broadcast( c ); }
+static vooBOOL voo_thread_create( voo_thread_t *t, void (*fn)( void * ), void *arg ){
+	thread_start_t *p_start = (thread_start_t *)malloc( sizeof(thread_start_t) );
+	p_start->fn = fn;
+	p_start->arg = arg;
+	if( pthread_create( t, NULL, thread_trampoline, p_start ) ){
+		free( p_start );
+		return FALSE;
+	}
+	return TRUE;
+}
+static void voo_thread_join( voo_thread_t t ){ pthread_join( t, NULL ); }
+static void voo_once( voo_once_t *o, void (*fn)( void ) ){ pthread_once( o, fn ); }
+static int64_t voo_atomic_get( volatile int64_t *p ){ return __atomic_load_n( p, __ATOMIC_ACQUIRE ); }
+static void voo_atomic_set( volatile int64_t *p, int64_t v ){ __atomic_store_n( p, v, __ATOMIC_RELEASE ); }
+static void voo_atomic_add( volatile int64_t *p, int64_t v ){ __atomic_fetch_add( p, v, __ATOMIC_RELAXED ); }
+// for pointers published to another thread, so far only the prefetcher's
+static void *voo_atomic_get_ptr( void *volatile *p ){ return __atomic_load_n( p, __ATOMIC_ACQUIRE ); }
+static void voo_atomic_set_ptr( void *volatile *p, void *v ){ __atomic_store_n( p, v, __ATOMIC_RELEASE ); }
+#endif
+
+
+// Process-wide worker pool. Work is submitted in batches of "count" items;
+// whoever waits for a batch works on its remaining items itself, so waiting
+// from inside a pool thread cannot deadlock.
+typedef struct pool_batch_s
+{
+	void (*fn)( void *p_ctx, int32_t i );
+	void *p_ctx;
+	int32_t count;
+	int32_t next;    // next item to hand out
+	int32_t done;
+	struct pool_batch_s *queue_next;
+} pool_batch_t;
+
+#define MAX_POOL_THREADS 64
+
+static struct
+{
+	voo_mutex_t lock;
+	voo_cond_t work;
+	voo_cond_t done;
+	pool_batch_t *head;
+	pool_batch_t *tail;
+	int32_t n_threads;
+	vooBOOL b_stop;
+	voo_thread_t threads[ MAX_POOL_THREADS ];
+} g_pool;
+
+static voo_once_t g_pool_once = VOO_ONCE_INIT;
+
+// with the lock held: takes the next item of p_batch, unqueueing the batch once all are handed out
+static int32_t pool_take( pool_batch_t *p_batch ){
+	pool_batch_t **pp;
+	int32_t i = p_batch->next++;
+	if( p_batch->next == p_batch->count ){
+		for( pp = &g_pool.head; *pp != p_batch; pp = &(*pp)->queue_next );
+		*pp = p_batch->queue_next;
+		if( g_pool.tail == p_batch ){
+			for( g_pool.tail = g_pool.head; g_pool.tail && g_pool.tail->queue_next; g_pool.tail = g_pool.tail->queue_next );
+		}
+	}
+	return i;
+}
+
+static void pool_run_item( pool_batch_t *p_batch, int32_t i ){
+	voo_mutex_unlock( &g_pool.lock );
+	p_batch->fn( p_batch->p_ctx, i );
+	voo_mutex_lock( &g_pool.lock );
+	if( ++p_batch->done == p_batch->count )
+		voo_cond_broadcast( &g_pool.done );
+}
+
+static void pool_thread( void *p_arg ){
+	pool_batch_t *p_batch;
+	voo_mutex_lock( &g_pool.lock );
+	while( !g_pool.b_stop ){
+		if( !(p_batch = g_pool.head) ){
+			voo_cond_wait( &g_pool.work, &g_pool.lock );
+			continue;
+		}
+		pool_run_item( p_batch, pool_take( p_batch ) );
+	}
+	voo_mutex_unlock( &g_pool.lock );
+}
+
+static void pool_init( void ){
+	int32_t i;
+	voo_mutex_init( &g_pool.lock );
+	voo_cond_init( &g_pool.work );
+	voo_cond_init( &g_pool.done );
+	// the thread waiting for a batch works as well
+	g_pool.n_threads = FFMIN( FFMAX( av_cpu_count() - 1, 1 ), MAX_POOL_THREADS );
+	for( i = 0; i < g_pool.n_threads; i++ )
+		if( !voo_thread_create( &g_pool.threads[ i ], pool_thread, NULL ) )
+			break;
+	g_pool.n_threads = i;
+}
+
+static int32_t pool_threads( void ){
+	voo_once( &g_pool_once, pool_init );
+	return g_pool.n_threads;
+}
+
+static void pool_submit( pool_batch_t *p_batch ){
+	voo_once( &g_pool_once, pool_init );
+	p_batch->next = p_batch->done = 0;
+	p_batch->queue_next = NULL;
+	if( p_batch->count <= 0 )
+		return;
+	voo_mutex_lock( &g_pool.lock );
+	if( g_pool.tail )
+		g_pool.tail->queue_next = p_batch;
+	else
+		g_pool.head = p_batch;
+	g_pool.tail = p_batch;
+	voo_cond_broadcast( &g_pool.work );
+	voo_mutex_unlock( &g_pool.lock );
+}
+
+static void pool_wait( pool_batch_t *p_batch ){
+	if( p_batch->count <= 0 )
+		return;
+	voo_mutex_lock( &g_pool.lock );
+	while( p_batch->next < p_batch->count )
+		pool_run_item( p_batch, pool_take( p_batch ) );
+	while( p_batch->done < p_batch->count )
+		voo_cond_wait( &g_pool.done, &g_pool.lock );
+	voo_mutex_unlock( &g_pool.lock );
+}
+
+static void pool_run( void (*fn)( void *, int32_t ), void *p_ctx, int32_t count ){
+	pool_batch_t batch;
+	batch.fn = fn;
+	batch.p_ctx = p_ctx;
+	batch.count = count;
+	pool_submit( &batch );
+	pool_wait( &batch );
+}
+
+// called when vooya unloads the plugin; threads must not outlive the library
+static void pool_shutdown( void ){
+	int32_t i;
+	if( !g_pool.n_threads )
+		return;
+	voo_mutex_lock( &g_pool.lock );
+	g_pool.b_stop = TRUE;
+	voo_cond_broadcast( &g_pool.work );
+	voo_mutex_unlock( &g_pool.lock );
+	for( i = 0; i < g_pool.n_threads; i++ )
+		voo_thread_join( g_pool.threads[ i ] );
+	g_pool.n_threads = 0;
+}
+
+
+// Plane transfer: copies picture planes of arbitrary stride into vooya's
+// tightly packed buffer. Large pictures are written with non-temporal
+// stores, since vooya reads them much later than the cache would keep
+// them, and their rows are split across the worker pool.
+typedef struct
+{
+	const uint8_t *p_src;
+	uint8_t *p_dst;
+	int32_t src_stride;
+	int32_t dst_stride;
+	int32_t row_bytes;
+	int32_t rows;
+} plane_desc_t;
+
+#define MAX_TRANSFER_PLANES 4
+// pictures above these sizes are streamed past the cache / split into row bands
+#define TRANSFER_STREAM_BYTES ( 8 << 20 )
+#define TRANSFER_BAND_BYTES ( 2 << 20 )
+
+typedef void (*row_copy_fn)( uint8_t *p_dst, const uint8_t *p_src, size_t n );
+
+static void copy_row_c( uint8_t *p_dst, const uint8_t *p_src, size_t n ){
+	memcpy( p_dst, p_src, n );
+}
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+static void copy_row_sse2_nt( uint8_t *p_dst, const uint8_t *p_src, size_t n ){
+	size_t head = FFMIN( ( 16 - ( (uintptr_t)p_dst & 15 ) ) & 15, n );
+	memcpy( p_dst, p_src, head );
+	p_dst += head; p_src += head; n -= head;
+	for( ; n >= 64; n -= 64, p_src += 64, p_dst += 64 ){
+		__m128i a = _mm_loadu_si128( (const __m128i *)p_src );
+		__m128i b = _mm_loadu_si128( (const __m128i *)( p_src + 16 ) );
+		__m128i c = _mm_loadu_si128( (const __m128i *)( p_src + 32 ) );
+		__m128i d = _mm_loadu_si128( (const __m128i *)( p_src + 48 ) );
+		_mm_stream_si128( (__m128i *)p_dst, a );
+		_mm_stream_si128( (__m128i *)( p_dst + 16 ), b );
+		_mm_stream_si128( (__m128i *)( p_dst + 32 ), c );
+		_mm_stream_si128( (__m128i *)( p_dst + 48 ), d );
+	}
+	memcpy( p_dst, p_src, n );
+}
+
+TARGET_AVX2 static void copy_row_avx2_nt( uint8_t *p_dst, const uint8_t *p_src, size_t n ){
+	size_t head = FFMIN( ( 32 - ( (uintptr_t)p_dst & 31 ) ) & 31, n );
+	memcpy( p_dst, p_src, head );
+	p_dst += head; p_src += head; n -= head;
+	for( ; n >= 128; n -= 128, p_src += 128, p_dst += 128 ){
+		__m256i a = _mm256_loadu_si256( (const __m256i *)p_src );
+		__m256i b = _mm256_loadu_si256( (const __m256i *)( p_src + 32 ) );
+		__m256i c = _mm256_loadu_si256( (const __m256i *)( p_src + 64 ) );
+		__m256i d = _mm256_loadu_si256( (const __m256i *)( p_src + 96 ) );
+		_mm256_stream_si256( (__m256i *)p_dst, a );
+		_mm256_stream_si256( (__m256i *)( p_dst + 32 ), b );
+		_mm256_stream_si256( (__m256i *)( p_dst + 64 ), c );
+		_mm256_stream_si256( (__m256i *)( p_dst + 96 ), d );
+	}
+	memcpy( p_dst, p_src, n );
+}
+#endif
+
+#if defined( __aarch64__ ) || defined( _M_ARM64 )
+static void copy_row_neon( uint8_t *p_dst, const uint8_t *p_src, size_t n ){
+	for( ; n >= 64; n -= 64, p_src += 64, p_dst += 64 ){
+		uint8x16_t a = vld1q_u8( p_src );
+		uint8x16_t b = vld1q_u8( p_src + 16 );
+		uint8x16_t c = vld1q_u8( p_src + 32 );
+		uint8x16_t d = vld1q_u8( p_src + 48 );
+		vst1q_u8( p_dst, a );
+		vst1q_u8( p_dst + 16, b );
+		vst1q_u8( p_dst + 32, c );
+		vst1q_u8( p_dst + 48, d );
+	}
+	memcpy( p_dst, p_src, n );
+}
+#endif
+
+static row_copy_fn select_row_copy( vooBOOL b_stream ){
+#if defined( __x86_64__ ) || defined( _M_X64 )
+	if( b_stream )
+		return ( av_get_cpu_flags() & AV_CPU_FLAG_AVX2 ) ? copy_row_avx2_nt : copy_row_sse2_nt;
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+	if( b_stream )
+		return copy_row_neon;
+#endif
+	(void)b_stream;
+	return copy_row_c;
+}
+
+typedef struct
+{
+	const plane_desc_t *planes;
+	int32_t n_planes;
+	int32_t n_bands;
+	row_copy_fn copy;
+} transfer_job_t;
+
+static void transfer_band( void *p_ctx, int32_t band ){
+	transfer_job_t *p_job = (transfer_job_t *)p_ctx;
+	int32_t i, row, begin, end;
+
+	for( i = 0; i < p_job->n_planes; i++ ){
+		const plane_desc_t *p = &p_job->planes[ i ];
+		begin = (int32_t)( (int64_t)p->rows * band / p_job->n_bands );
+		end = (int32_t)( (int64_t)p->rows * ( band + 1 ) / p_job->n_bands );
+		if( p->src_stride == p->row_bytes && p->dst_stride == p->row_bytes ){
+			p_job->copy( p->p_dst + (size_t)begin * p->row_bytes, p->p_src + (size_t)begin * p->row_bytes,
+				(size_t)( end - begin ) * p->row_bytes );
+			continue;
+		}
+		for( row = begin; row < end; row++ )
+			p_job->copy( p->p_dst + (size_t)row * p->dst_stride, p->p_src + (size_t)row * p->src_stride, p->row_bytes );
+	}
+#if defined( __x86_64__ ) || defined( _M_X64 )
+	if( p_job->copy != copy_row_c )
+		_mm_sfence();
+#endif
+}
+
+static void transfer_planes( const plane_desc_t *planes, int32_t n_planes, vooBOOL b_parallel ){
+	transfer_job_t job;
+	int64_t bytes = 0;
+	int32_t i, min_rows = INT32_MAX;
+
+	for( i = 0; i < n_planes; i++ ){
+		bytes += (int64_t)planes[ i ].row_bytes * planes[ i ].rows;
+		min_rows = FFMIN( min_rows, planes[ i ].rows );
+	}
+	job.planes = planes;
+	job.n_planes = n_planes;
+	job.copy = select_row_copy( bytes >= TRANSFER_STREAM_BYTES );
+	job.n_bands = 1;
+	if( b_parallel && bytes >= 2 * TRANSFER_BAND_BYTES )
+		job.n_bands = (int32_t)FFMIN( FFMIN( bytes / TRANSFER_BAND_BYTES, pool_threads() + 1 ), FFMAX( min_rows, 1 ) );
+
+	if( job.n_bands > 1 )
+		pool_run( transfer_band, &job, job.n_bands );
+	else
+		transfer_band( &job, 0 );
+}
+
+
+// Pixel formats. Layouts vooya reads natively are passed through plane by
+// plane; everything else is repacked into the nearest native layout
+// ("layout_fmt") by the kernels below. Alpha planes are not shown.
+typedef struct
+{
+	int32_t n_planes;
+	int32_t row_bytes[ MAX_TRANSFER_PLANES ];
+	int32_t rows[ MAX_TRANSFER_PLANES ];
+	size_t offset[ MAX_TRANSFER_PLANES ];
+	size_t size;
+} voo_layout_t;
+
+typedef void (*repack_fn)( const AVFrame *p_frame, const voo_layout_t *p_layout, uint8_t *p_dst, int32_t band, int32_t n_bands );
+
+typedef struct
+{
+	enum AVPixelFormat pix_fmt;     // as delivered by the decoder
+	enum AVPixelFormat layout_fmt;  // whose memory layout vooya gets
+	voo_dataArrangement_t arrangement;
+	voo_colorSpace_t color_space;
+	voo_channelOrder_t channel_order;
+	repack_fn repack;               // NULL if the planes are passed through
+} pix_fmt_map_t;
+
+static void band_range( int32_t rows, int32_t band, int32_t n_bands, int32_t *p_begin, int32_t *p_end ){
+	*p_begin = (int32_t)( (int64_t)rows * band / n_bands );
+	*p_end = (int32_t)( (int64_t)rows * ( band + 1 ) / n_bands );
+}
+
+#define SRC_ROW( f, i, row ) ( (const uint8_t *)( f )->data[ i ] + (ptrdiff_t)( row ) * ( f )->linesize[ i ] )
+#define DST_ROW( l, p, i, row ) ( ( p ) + ( l )->offset[ i ] + (size_t)( row ) * ( l )->row_bytes[ i ] )
+
+// n interleaved byte pairs to two rows; p_b may be NULL to keep the first bytes only
+static void deinterleave8( uint8_t *p_a, uint8_t *p_b, const uint8_t *p_src, int32_t n ){
+	int32_t i = 0;
+#if defined( __x86_64__ ) || defined( _M_X64 )
+	const __m128i lo = _mm_set1_epi16( 0x00ff );
+	for( ; i + 16 <= n; i += 16 ){
+		__m128i x = _mm_loadu_si128( (const __m128i *)( p_src + 2 * i ) );
+		__m128i y = _mm_loadu_si128( (const __m128i *)( p_src + 2 * i + 16 ) );
+		_mm_storeu_si128( (__m128i *)( p_a + i ), _mm_packus_epi16( _mm_and_si128( x, lo ), _mm_and_si128( y, lo ) ) );
+		if( p_b )
+			_mm_storeu_si128( (__m128i *)( p_b + i ), _mm_packus_epi16( _mm_srli_epi16( x, 8 ), _mm_srli_epi16( y, 8 ) ) );
+	}
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+	for( ; i + 16 <= n; i += 16 ){
+		uint8x16x2_t v = vld2q_u8( p_src + 2 * i );
+		vst1q_u8( p_a + i, v.val[ 0 ] );
+		if( p_b )
+			vst1q_u8( p_b + i, v.val[ 1 ] );
+	}
+#endif
+	for( ; i < n; i++ ){
+		p_a[ i ] = p_src[ 2 * i ];
+		if( p_b )
+			p_b[ i ] = p_src[ 2 * i + 1 ];
+	}
+}
+
+// n interleaved 16 bit pairs to two rows
+static void deinterleave16( uint16_t *p_a, uint16_t *p_b, const uint16_t *p_src, int32_t n ){
+	int32_t i = 0;
+#if defined( __x86_64__ ) || defined( _M_X64 )
+	// SSE2 only packs with signed saturation, so the words are biased into range and back
+	const __m128i lo = _mm_set1_epi32( 0xffff ), bias = _mm_set1_epi32( 0x8000 ), unbias = _mm_set1_epi16( (short)0x8000 );
+	for( ; i + 8 <= n; i += 8 ){
+		__m128i x = _mm_loadu_si128( (const __m128i *)( p_src + 2 * i ) );
+		__m128i y = _mm_loadu_si128( (const __m128i *)( p_src + 2 * i + 8 ) );
+		__m128i a = _mm_packs_epi32( _mm_sub_epi32( _mm_and_si128( x, lo ), bias ), _mm_sub_epi32( _mm_and_si128( y, lo ), bias ) );
+		__m128i b = _mm_packs_epi32( _mm_sub_epi32( _mm_srli_epi32( x, 16 ), bias ), _mm_sub_epi32( _mm_srli_epi32( y, 16 ), bias ) );
+		_mm_storeu_si128( (__m128i *)( p_a + i ), _mm_xor_si128( a, unbias ) );
+		_mm_storeu_si128( (__m128i *)( p_b + i ), _mm_xor_si128( b, unbias ) );
+	}
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+	for( ; i + 8 <= n; i += 8 ){
+		uint16x8x2_t v = vld2q_u16( p_src + 2 * i );
+		vst1q_u16( p_a + i, v.val[ 0 ] );
+		vst1q_u16( p_b + i, v.val[ 1 ] );
+	}
+#endif
+	for( ; i < n; i++ ){
+		p_a[ i ] = p_src[ 2 * i ];
+		p_b[ i ] = p_src[ 2 * i + 1 ];
+	}
+}
+
+// swaps the bytes of n pairs, VU to UV
+static void swap_pairs8( uint8_t *p_dst, const uint8_t *p_src, int32_t n ){
+	int32_t i = 0;
+#if defined( __x86_64__ ) || defined( _M_X64 )
+	for( ; i + 8 <= n; i += 8 ){
+		__m128i x = _mm_loadu_si128( (const __m128i *)( p_src + 2 * i ) );
+		_mm_storeu_si128( (__m128i *)( p_dst + 2 * i ), _mm_or_si128( _mm_slli_epi16( x, 8 ), _mm_srli_epi16( x, 8 ) ) );
+	}
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+	for( ; i + 8 <= n; i += 8 )
+		vst1q_u8( p_dst + 2 * i, vrev16q_u8( vld1q_u8( p_src + 2 * i ) ) );
+#endif
+	for( ; i < n; i++ ){
+		p_dst[ 2 * i ] = p_src[ 2 * i + 1 ];
+		p_dst[ 2 * i + 1 ] = p_src[ 2 * i ];
+	}
+}
+
+// moves the leading byte of n 4 byte pixels to the end, xABC to ABCx
+static void rotate_pixels32( uint8_t *p_dst, const uint8_t *p_src, int32_t n ){
+	int32_t i = 0;
+#if defined( __x86_64__ ) || defined( _M_X64 )
+	for( ; i + 4 <= n; i += 4 ){
+		__m128i x = _mm_loadu_si128( (const __m128i *)( p_src + 4 * i ) );
+		_mm_storeu_si128( (__m128i *)( p_dst + 4 * i ), _mm_or_si128( _mm_srli_epi32( x, 8 ), _mm_slli_epi32( x, 24 ) ) );
+	}
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+	for( ; i + 4 <= n; i += 4 ){
+		uint32x4_t x = vreinterpretq_u32_u8( vld1q_u8( p_src + 4 * i ) );
+		vst1q_u8( p_dst + 4 * i, vreinterpretq_u8_u32( vorrq_u32( vshrq_n_u32( x, 8 ), vshlq_n_u32( x, 24 ) ) ) );
+	}
+#endif
+	for( ; i < n; i++ ){
+		p_dst[ 4 * i ] = p_src[ 4 * i + 1 ];
+		p_dst[ 4 * i + 1 ] = p_src[ 4 * i + 2 ];
+		p_dst[ 4 * i + 2 ] = p_src[ 4 * i + 3 ];
+		p_dst[ 4 * i + 3 ] = p_src[ 4 * i ];
+	}
+}
+
+static void repack_copy_plane( const AVFrame *p_frame, const voo_layout_t *p_layout, uint8_t *p_dst, int32_t i, int32_t band, int32_t n_bands ){
+	int32_t row, begin, end;
+	band_range( p_layout->rows[ i ], band, n_bands, &begin, &end );
+	for( row = begin; row < end; row++ )
+		memcpy( DST_ROW( p_layout, p_dst, i, row ), SRC_ROW( p_frame, i, row ), p_layout->row_bytes[ i ] );
+}
+
+// luma as is, the interleaved chroma plane split in two
+static void repack_semiplanar( const AVFrame *p_frame, const voo_layout_t *p_layout, uint8_t *p_dst, int32_t band, int32_t n_bands,
+	vooBOOL b_16bit, vooBOOL b_vu ){
+	int32_t row, begin, end;
+	repack_copy_plane( p_frame, p_layout, p_dst, 0, band, n_bands );
+	band_range( p_layout->rows[ 1 ], band, n_bands, &begin, &end );
+	for( row = begin; row < end; row++ ){
+		uint8_t *p_u = DST_ROW( p_layout, p_dst, b_vu ? 2 : 1, row );
+		uint8_t *p_v = DST_ROW( p_layout, p_dst, b_vu ? 1 : 2, row );
+		if( b_16bit )
+			deinterleave16( (uint16_t *)p_u, (uint16_t *)p_v, (const uint16_t *)SRC_ROW( p_frame, 1, row ), p_layout->row_bytes[ 1 ] / 2 );
+		else
+			deinterleave8( p_u, p_v, SRC_ROW( p_frame, 1, row ), p_layout->row_bytes[ 1 ] );
+	}
+}
+
+static void repack_nv( const AVFrame *p_frame, const voo_layout_t *p_layout, uint8_t *p_dst, int32_t band, int32_t n_bands ){
+	repack_semiplanar( p_frame, p_layout, p_dst, band, n_bands, FALSE, FALSE );
+}
+
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT( 56, 31, 100 )
+static void repack_nv_vu( const AVFrame *p_frame, const voo_layout_t *p_layout, uint8_t *p_dst, int32_t band, int32_t n_bands ){
+	repack_semiplanar( p_frame, p_layout, p_dst, band, n_bands, FALSE, TRUE );
+}
+#endif
+
+static void repack_nv_16( const AVFrame *p_frame, const voo_layout_t *p_layout, uint8_t *p_dst, int32_t band, int32_t n_bands ){
+	repack_semiplanar( p_frame, p_layout, p_dst, band, n_bands, TRUE, FALSE );
+}
+
+// NV21 to NV12
+static void repack_nv21( const AVFrame *p_frame, const voo_layout_t *p_layout, uint8_t *p_dst, int32_t band, int32_t n_bands ){
+	int32_t row, begin, end;
+	repack_copy_plane( p_frame, p_layout, p_dst, 0, band, n_bands );
+	band_range( p_layout->rows[ 1 ], band, n_bands, &begin, &end );
+	for( row = begin; row < end; row++ )
+		swap_pairs8( DST_ROW( p_layout, p_dst, 1, row ), SRC_ROW( p_frame, 1, row ), p_layout->row_bytes[ 1 ] / 2 );
+}
+
+// 4:4:0 to 4:4:4 by doubling the chroma rows
+static void repack_440( const AVFrame *p_frame, const voo_layout_t *p_layout, uint8_t *p_dst, int32_t band, int32_t n_bands ){
+	int32_t i, row, begin, end;
+	repack_copy_plane( p_frame, p_layout, p_dst, 0, band, n_bands );
+	for( i = 1; i < 3; i++ ){
+		band_range( p_layout->rows[ i ], band, n_bands, &begin, &end );
+		for( row = begin; row < end; row++ )
+			memcpy( DST_ROW( p_layout, p_dst, i, row ), SRC_ROW( p_frame, i, row >> 1 ), p_layout->row_bytes[ i ] );
+	}
+}
+
+// ARGB/ABGR/0RGB/0BGR to RGBA/BGRA/RGB0/BGR0
+static void repack_rotate32( const AVFrame *p_frame, const voo_layout_t *p_layout, uint8_t *p_dst, int32_t band, int32_t n_bands ){
+	int32_t row, begin, end;
+	band_range( p_layout->rows[ 0 ], band, n_bands, &begin, &end );
+	for( row = begin; row < end; row++ )
+		rotate_pixels32( DST_ROW( p_layout, p_dst, 0, row ), SRC_ROW( p_frame, 0, row ), p_layout->row_bytes[ 0 ] / 4 );
+}
+
+// palette lookup to RGB24; the palette holds native endian 0xAARRGGBB words
+static void repack_pal8( const AVFrame *p_frame, const voo_layout_t *p_layout, uint8_t *p_dst, int32_t band, int32_t n_bands ){
+	const uint32_t *p_pal = (const uint32_t *)p_frame->data[ 1 ];
+	int32_t x, row, begin, end, w = p_layout->row_bytes[ 0 ] / 3;
+	band_range( p_layout->rows[ 0 ], band, n_bands, &begin, &end );
+	for( row = begin; row < end; row++ ){
+		const uint8_t *p_s = SRC_ROW( p_frame, 0, row );
+		uint8_t *p_d = DST_ROW( p_layout, p_dst, 0, row );
+		for( x = 0; x < w; x++, p_d += 3 ){
+			uint32_t c = p_pal[ p_s[ x ] ];
+			p_d[ 0 ] = (uint8_t)( c >> 16 );
+			p_d[ 1 ] = (uint8_t)( c >> 8 );
+			p_d[ 2 ] = (uint8_t)c;
+		}
+	}
+}
+
+// gray with alpha to gray
+static void repack_ya8( const AVFrame *p_frame, const voo_layout_t *p_layout, uint8_t *p_dst, int32_t band, int32_t n_bands ){
+	int32_t row, begin, end;
+	band_range( p_layout->rows[ 0 ], band, n_bands, &begin, &end );
+	for( row = begin; row < end; row++ )
+		deinterleave8( DST_ROW( p_layout, p_dst, 0, row ), NULL, SRC_ROW( p_frame, 0, row ), p_layout->row_bytes[ 0 ] );
+}
+
+typedef struct
+{
+	repack_fn fn;
+	const AVFrame *p_frame;
+	const voo_layout_t *p_layout;
+	uint8_t *p_dst;
+	int32_t n_bands;
+} repack_job_t;
+
+static void repack_band( void *p_ctx, int32_t band ){
+	repack_job_t *p_job = (repack_job_t *)p_ctx;
+	p_job->fn( p_job->p_frame, p_job->p_layout, p_job->p_dst, band, p_job->n_bands );
+}
+
+// row bands on the worker pool, like transfer_planes( ... )
+static void repack_frame( repack_fn fn, const AVFrame *p_frame, const voo_layout_t *p_layout, uint8_t *p_dst, vooBOOL b_parallel ){
+	repack_job_t job;
+	int32_t i, min_rows = INT32_MAX;
+
+	for( i = 0; i < p_layout->n_planes; i++ )
+		min_rows = FFMIN( min_rows, p_layout->rows[ i ] );
+	job.fn = fn;
+	job.p_frame = p_frame;
+	job.p_layout = p_layout;
+	job.p_dst = p_dst;
+	job.n_bands = 1;
+	if( b_parallel && p_layout->size >= 2 * TRANSFER_BAND_BYTES )
+		job.n_bands = (int32_t)FFMIN( FFMIN( p_layout->size / TRANSFER_BAND_BYTES, pool_threads() + 1 ), FFMAX( min_rows, 1 ) );
+
+	if( job.n_bands > 1 )
+		pool_run( repack_band, &job, job.n_bands );
+	else
+		repack_band( &job, 0 );
+}
+
+// Pictures decoded at another size than vooya's, full size in proxy mode or
+// reduced by lowres while scrubbing, are scaled by powers of two: down with a
+// box filter, up by repeating samples. Rows are made of elements, a sample in
+// planar formats or a whole pixel in packed ones.
+
+static vooBOOL scale_supported( enum AVPixelFormat fmt ){
+	const AVPixFmtDescriptor *p_desc = av_pix_fmt_desc_get( fmt );
+	if( !p_desc || ( p_desc->flags & ( AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_HWACCEL ) ) )
+		return FALSE;
+#ifdef AV_PIX_FMT_FLAG_FLOAT
+	if( p_desc->flags & AV_PIX_FMT_FLAG_FLOAT )
+		return FALSE;
+#endif
+	// packed pixels sharing subsampled chroma (YUYV) cannot be taken apart this way
+	return ( ( p_desc->flags & AV_PIX_FMT_FLAG_PLANAR ) || !p_desc->log2_chroma_w )
+		&& p_desc->comp[ 0 ].depth >= 8 && p_desc->comp[ 0 ].depth <= 16;
+}
+
+// k > 0 with big >> k == small (rounding up), 0 if there is none
+static int32_t scale_shift( int32_t big, int32_t small ){
+	int32_t k;
+	for( k = 1; k <= 4; k++ )
+		if( AV_CEIL_RSHIFT( big, k ) == small )
+			return k;
+	return 0;
+}
+
+typedef struct
+{
+	int32_t elem;        // bytes
+	int32_t sample;      // bytes, 1 or 2
+	int32_t src_elems;   // of a source row
+	int32_t src_rows;
+	vooBOOL b_be;
+} scale_plane_t;
+
+static void scale_plane( scale_plane_t *p_plane, const AVFrame *p_frame, int32_t i ){
+	const AVPixFmtDescriptor *p_desc = av_pix_fmt_desc_get( (enum AVPixelFormat)p_frame->format );
+	int32_t c, linesizes[ 4 ];
+	p_plane->sample = p_desc->comp[ 0 ].depth > 8 ? 2 : 1;
+	p_plane->elem = p_plane->sample;
+	for( c = 0; c < p_desc->nb_components; c++ )
+		if( p_desc->comp[ c ].plane == i )
+			p_plane->elem = FFMAX( p_plane->elem, p_desc->comp[ c ].step );
+	av_image_fill_linesizes( linesizes, (enum AVPixelFormat)p_frame->format, p_frame->width );
+	p_plane->src_elems = FFMAX( linesizes[ i ] / p_plane->elem, 1 );
+	p_plane->src_rows = ( 1 == i || 2 == i ) ? AV_CEIL_RSHIFT( p_frame->height, p_desc->log2_chroma_h ) : p_frame->height;
+	p_plane->b_be = !!( p_desc->flags & AV_PIX_FMT_FLAG_BE );
+}
+
+// 2x2 box of n 8 bit samples from rows a and b, which hold 2n samples
+static void box2_row8( uint8_t *p_dst, const uint8_t *a, const uint8_t *b, int32_t n ){
+	int32_t i = 0;
+#if defined( __x86_64__ ) || defined( _M_X64 )
+	const __m128i lo = _mm_set1_epi16( 0x00ff ), two = _mm_set1_epi16( 2 );
+	for( ; i + 16 <= n; i += 16 ){
+		__m128i a0 = _mm_loadu_si128( (const __m128i *)( a + 2 * i ) ), a1 = _mm_loadu_si128( (const __m128i *)( a + 2 * i + 16 ) );
+		__m128i b0 = _mm_loadu_si128( (const __m128i *)( b + 2 * i ) ), b1 = _mm_loadu_si128( (const __m128i *)( b + 2 * i + 16 ) );
+		__m128i s0 = _mm_add_epi16( _mm_add_epi16( _mm_and_si128( a0, lo ), _mm_srli_epi16( a0, 8 ) ),
+			_mm_add_epi16( _mm_and_si128( b0, lo ), _mm_srli_epi16( b0, 8 ) ) );
+		__m128i s1 = _mm_add_epi16( _mm_add_epi16( _mm_and_si128( a1, lo ), _mm_srli_epi16( a1, 8 ) ),
+			_mm_add_epi16( _mm_and_si128( b1, lo ), _mm_srli_epi16( b1, 8 ) ) );
+		s0 = _mm_srli_epi16( _mm_add_epi16( s0, two ), 2 );
+		s1 = _mm_srli_epi16( _mm_add_epi16( s1, two ), 2 );
+		_mm_storeu_si128( (__m128i *)( p_dst + i ), _mm_packus_epi16( s0, s1 ) );
+	}
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+	for( ; i + 8 <= n; i += 8 ){
+		uint16x8_t sum = vaddq_u16( vpaddlq_u8( vld1q_u8( a + 2 * i ) ), vpaddlq_u8( vld1q_u8( b + 2 * i ) ) );
+		vst1_u8( p_dst + i, vrshrn_n_u16( sum, 2 ) );
+	}
+#endif
+	for( ; i < n; i++ )
+		p_dst[ i ] = (uint8_t)( ( a[ 2 * i ] + a[ 2 * i + 1 ] + b[ 2 * i ] + b[ 2 * i + 1 ] + 2 ) >> 2 );
+}
+
+// the same for native endian samples of 9 to 16 bits
+static void box2_row16( uint16_t *p_dst, const uint16_t *a, const uint16_t *b, int32_t n ){
+	int32_t i = 0;
+#if defined( __x86_64__ ) || defined( _M_X64 )
+	const __m128i lo = _mm_set1_epi32( 0xffff ), two = _mm_set1_epi32( 2 );
+	const __m128i bias = _mm_set1_epi32( 0x8000 ), unbias = _mm_set1_epi16( (short)0x8000 );
+	for( ; i + 8 <= n; i += 8 ){
+		__m128i a0 = _mm_loadu_si128( (const __m128i *)( a + 2 * i ) ), a1 = _mm_loadu_si128( (const __m128i *)( a + 2 * i + 8 ) );
+		__m128i b0 = _mm_loadu_si128( (const __m128i *)( b + 2 * i ) ), b1 = _mm_loadu_si128( (const __m128i *)( b + 2 * i + 8 ) );
+		__m128i s0 = _mm_add_epi32( _mm_add_epi32( _mm_and_si128( a0, lo ), _mm_srli_epi32( a0, 16 ) ),
+			_mm_add_epi32( _mm_and_si128( b0, lo ), _mm_srli_epi32( b0, 16 ) ) );
+		__m128i s1 = _mm_add_epi32( _mm_add_epi32( _mm_and_si128( a1, lo ), _mm_srli_epi32( a1, 16 ) ),
+			_mm_add_epi32( _mm_and_si128( b1, lo ), _mm_srli_epi32( b1, 16 ) ) );
+		s0 = _mm_sub_epi32( _mm_srli_epi32( _mm_add_epi32( s0, two ), 2 ), bias );
+		s1 = _mm_sub_epi32( _mm_srli_epi32( _mm_add_epi32( s1, two ), 2 ), bias );
+		_mm_storeu_si128( (__m128i *)( p_dst + i ), _mm_xor_si128( _mm_packs_epi32( s0, s1 ), unbias ) );
+	}
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+	for( ; i + 4 <= n; i += 4 ){
+		uint32x4_t sum = vaddq_u32( vpaddlq_u16( vld1q_u16( a + 2 * i ) ), vpaddlq_u16( vld1q_u16( b + 2 * i ) ) );
+		vst1_u16( p_dst + i, vrshrn_n_u32( sum, 2 ) );
+	}
+#endif
+	for( ; i < n; i++ )
+		p_dst[ i ] = (uint16_t)( ( a[ 2 * i ] + a[ 2 * i + 1 ] + b[ 2 * i ] + b[ 2 * i + 1 ] + 2 ) >> 2 );
+}
+
+static inline uint32_t scale_read( const uint8_t *p, const scale_plane_t *p_plane ){
+	if( 1 == p_plane->sample )
+		return p[ 0 ];
+	return p_plane->b_be ? (uint32_t)p[ 0 ] << 8 | p[ 1 ] : (uint32_t)p[ 1 ] << 8 | p[ 0 ];
+}
+
+static inline void scale_write( uint8_t *p, uint32_t v, const scale_plane_t *p_plane ){
+	if( 1 == p_plane->sample ){
+		p[ 0 ] = (uint8_t)v;
+	} else if( p_plane->b_be ){
+		p[ 0 ] = (uint8_t)( v >> 8 );
+		p[ 1 ] = (uint8_t)v;
+	} else {
+		p[ 0 ] = (uint8_t)v;
+		p[ 1 ] = (uint8_t)( v >> 8 );
+	}
+}
+
+static void repack_scale_down( const AVFrame *p_frame, const voo_layout_t *p_layout, uint8_t *p_dst, int32_t band, int32_t n_bands ){
+	scale_plane_t plane;
+	int32_t i, row, begin, end, x, j, dx, dy, n, k = 1, f;
+	uint32_t sum;
+
+	while( AV_CEIL_RSHIFT( p_frame->height, k ) > p_layout->rows[ 0 ] )
+		k++;
+	f = 1 << k;
+	for( i = 0; i < p_layout->n_planes; i++ ){
+		scale_plane( &plane, p_frame, i );
+		n = p_layout->row_bytes[ i ] / plane.elem;
+		band_range( p_layout->rows[ i ], band, n_bands, &begin, &end );
+		for( row = begin; row < end; row++ ){
+			uint8_t *p_row = DST_ROW( p_layout, p_dst, i, row );
+			// the common case, whole 2x2 boxes of planar native endian samples
+			if( 2 == f && plane.elem == plane.sample && !plane.b_be && 2 * row + 1 < plane.src_rows && 2 * n <= plane.src_elems ){
+				if( 1 == plane.sample )
+					box2_row8( p_row, SRC_ROW( p_frame, i, 2 * row ), SRC_ROW( p_frame, i, 2 * row + 1 ), n );
+				else
+					box2_row16( (uint16_t *)p_row, (const uint16_t *)SRC_ROW( p_frame, i, 2 * row ),
+						(const uint16_t *)SRC_ROW( p_frame, i, 2 * row + 1 ), n );
+				continue;
+			}
+			for( x = 0; x < n; x++ )
+				for( j = 0; j < plane.elem; j += plane.sample ){
+					sum = 0;
+					for( dy = 0; dy < f; dy++ ){
+						const uint8_t *p_src = SRC_ROW( p_frame, i, FFMIN( row * f + dy, plane.src_rows - 1 ) );
+						for( dx = 0; dx < f; dx++ )
+							sum += scale_read( p_src + FFMIN( x * f + dx, plane.src_elems - 1 ) * plane.elem + j, &plane );
+					}
+					scale_write( p_row + x * plane.elem + j, ( sum + ( f * f >> 1 ) ) >> ( 2 * k ), &plane );
+				}
+		}
+	}
+}
+
+static void repack_scale_up( const AVFrame *p_frame, const voo_layout_t *p_layout, uint8_t *p_dst, int32_t band, int32_t n_bands ){
+	scale_plane_t plane;
+	int32_t i, row, begin, end, x, n, k = 1;
+
+	while( AV_CEIL_RSHIFT( p_layout->rows[ 0 ], k ) > p_frame->height )
+		k++;
+	for( i = 0; i < p_layout->n_planes; i++ ){
+		scale_plane( &plane, p_frame, i );
+		n = p_layout->row_bytes[ i ] / plane.elem;
+		band_range( p_layout->rows[ i ], band, n_bands, &begin, &end );
+		for( row = begin; row < end; row++ ){
+			const uint8_t *p_src = SRC_ROW( p_frame, i, FFMIN( row >> k, plane.src_rows - 1 ) );
+			uint8_t *p_row = DST_ROW( p_layout, p_dst, i, row );
+			for( x = 0; x < n; x++ )
+				memcpy( p_row + x * plane.elem, p_src + FFMIN( x >> k, plane.src_elems - 1 ) * plane.elem, plane.elem );
+		}
+	}
+}
+
+#define PIX_PASS( fmt, arr, cs, co ) { fmt, fmt, arr, cs, co, NULL }
+#define PIX_PASS_LE_BE( fmt, arr, cs, co ) PIX_PASS( fmt##LE, arr, cs, co ), PIX_PASS( fmt##BE, arr, cs, co )
+#define PIX_REPACK_LE_BE( fmt, layout, arr, fn ) { fmt##LE, layout##LE, arr, vooCS_YUV, vooCO_c123, fn }, \
+	{ fmt##BE, layout##BE, arr, vooCS_YUV, vooCO_c123, fn }
+#define PIX_YUV( fmt, arr ) PIX_PASS( fmt, arr, vooCS_YUV, vooCO_c123 )
+#define PIX_YUV_LE_BE( fmt, arr ) PIX_PASS_LE_BE( fmt, arr, vooCS_YUV, vooCO_c123 )
+#define PIX_GBR( fmt ) PIX_PASS( fmt, vooDA_planar_444, vooCS_RGB, vooCO_c231 )
+#define PIX_GBR_LE_BE( fmt ) PIX_PASS_LE_BE( fmt, vooDA_planar_444, vooCS_RGB, vooCO_c231 )
+
+static const pix_fmt_map_t g_pix_fmts[] = {
+	PIX_YUV( AV_PIX_FMT_YUV420P, vooDA_planar_420 ),
+	PIX_YUV( AV_PIX_FMT_YUVJ420P, vooDA_planar_420 ),
+	PIX_YUV( AV_PIX_FMT_YUVA420P, vooDA_planar_420 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUV420P9, vooDA_planar_420 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUV420P10, vooDA_planar_420 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUV420P12, vooDA_planar_420 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUV420P14, vooDA_planar_420 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUV420P16, vooDA_planar_420 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUVA420P9, vooDA_planar_420 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUVA420P10, vooDA_planar_420 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUVA420P16, vooDA_planar_420 ),
+	PIX_YUV( AV_PIX_FMT_YUV422P, vooDA_planar_422 ),
+	PIX_YUV( AV_PIX_FMT_YUVJ422P, vooDA_planar_422 ),
+	PIX_YUV( AV_PIX_FMT_YUVA422P, vooDA_planar_422 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUV422P9, vooDA_planar_422 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUV422P10, vooDA_planar_422 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUV422P12, vooDA_planar_422 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUV422P14, vooDA_planar_422 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUV422P16, vooDA_planar_422 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUVA422P9, vooDA_planar_422 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUVA422P10, vooDA_planar_422 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUVA422P16, vooDA_planar_422 ),
+	PIX_YUV( AV_PIX_FMT_YUV444P, vooDA_planar_444 ),
+	PIX_YUV( AV_PIX_FMT_YUVJ444P, vooDA_planar_444 ),
+	PIX_YUV( AV_PIX_FMT_YUVA444P, vooDA_planar_444 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUV444P9, vooDA_planar_444 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUV444P10, vooDA_planar_444 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUV444P12, vooDA_planar_444 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUV444P14, vooDA_planar_444 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUV444P16, vooDA_planar_444 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUVA444P9, vooDA_planar_444 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUVA444P10, vooDA_planar_444 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_YUVA444P16, vooDA_planar_444 ),
+	PIX_YUV( AV_PIX_FMT_YUV410P, vooDA_planar_410 ),
+	PIX_YUV( AV_PIX_FMT_YUV411P, vooDA_planar_411 ),
+	PIX_YUV( AV_PIX_FMT_YUVJ411P, vooDA_planar_411 ),
+	{ AV_PIX_FMT_YUV440P, AV_PIX_FMT_YUV444P, vooDA_planar_444, vooCS_YUV, vooCO_c123, repack_440 },
+	{ AV_PIX_FMT_YUVJ440P, AV_PIX_FMT_YUVJ444P, vooDA_planar_444, vooCS_YUV, vooCO_c123, repack_440 },
+	PIX_REPACK_LE_BE( AV_PIX_FMT_YUV440P10, AV_PIX_FMT_YUV444P10, vooDA_planar_444, repack_440 ),
+	PIX_REPACK_LE_BE( AV_PIX_FMT_YUV440P12, AV_PIX_FMT_YUV444P12, vooDA_planar_444, repack_440 ),
+
+	PIX_YUV( AV_PIX_FMT_NV12, vooDA_nv12 ),
+	{ AV_PIX_FMT_NV21, AV_PIX_FMT_NV12, vooDA_nv12, vooCS_YUV, vooCO_c123, repack_nv21 },
+	PIX_YUV_LE_BE( AV_PIX_FMT_P010, vooDA_p010 ),
+	PIX_YUV_LE_BE( AV_PIX_FMT_P016, vooDA_p016 ),
+	{ AV_PIX_FMT_NV16, AV_PIX_FMT_YUV422P, vooDA_planar_422, vooCS_YUV, vooCO_c123, repack_nv },
+	PIX_REPACK_LE_BE( AV_PIX_FMT_NV20, AV_PIX_FMT_YUV422P10, vooDA_planar_422, repack_nv_16 ),
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT( 56, 31, 100 )
+	{ AV_PIX_FMT_NV24, AV_PIX_FMT_YUV444P, vooDA_planar_444, vooCS_YUV, vooCO_c123, repack_nv },
+	{ AV_PIX_FMT_NV42, AV_PIX_FMT_YUV444P, vooDA_planar_444, vooCS_YUV, vooCO_c123, repack_nv_vu },
+#endif
+	PIX_YUV( AV_PIX_FMT_YUYV422, vooDA_yuyv ),
+	PIX_YUV( AV_PIX_FMT_UYVY422, vooDA_uyvy ),
+
+	PIX_PASS( AV_PIX_FMT_GRAY8, vooDA_single, vooCS_Gray, vooCO_c123 ),
+	PIX_PASS_LE_BE( AV_PIX_FMT_GRAY10, vooDA_single, vooCS_Gray, vooCO_c123 ),
+	PIX_PASS_LE_BE( AV_PIX_FMT_GRAY12, vooDA_single, vooCS_Gray, vooCO_c123 ),
+	PIX_PASS_LE_BE( AV_PIX_FMT_GRAY16, vooDA_single, vooCS_Gray, vooCO_c123 ),
+	{ AV_PIX_FMT_YA8, AV_PIX_FMT_GRAY8, vooDA_single, vooCS_Gray, vooCO_c123, repack_ya8 },
+
+	PIX_PASS( AV_PIX_FMT_RGB24, vooDA_interleaved_444, vooCS_RGB, vooCO_c123 ),
+	PIX_PASS( AV_PIX_FMT_BGR24, vooDA_interleaved_444, vooCS_RGB, vooCO_c321 ),
+	PIX_PASS( AV_PIX_FMT_RGBA, vooDA_interleaved_444, vooCS_RGB, vooCO_c123x ),
+	PIX_PASS( AV_PIX_FMT_RGB0, vooDA_interleaved_444, vooCS_RGB, vooCO_c123x ),
+	PIX_PASS( AV_PIX_FMT_BGRA, vooDA_interleaved_444, vooCS_RGB, vooCO_c321x ),
+	PIX_PASS( AV_PIX_FMT_BGR0, vooDA_interleaved_444, vooCS_RGB, vooCO_c321x ),
+	{ AV_PIX_FMT_ARGB, AV_PIX_FMT_RGBA, vooDA_interleaved_444, vooCS_RGB, vooCO_c123x, repack_rotate32 },
+	{ AV_PIX_FMT_0RGB, AV_PIX_FMT_RGB0, vooDA_interleaved_444, vooCS_RGB, vooCO_c123x, repack_rotate32 },
+	{ AV_PIX_FMT_ABGR, AV_PIX_FMT_BGRA, vooDA_interleaved_444, vooCS_RGB, vooCO_c321x, repack_rotate32 },
+	{ AV_PIX_FMT_0BGR, AV_PIX_FMT_BGR0, vooDA_interleaved_444, vooCS_RGB, vooCO_c321x, repack_rotate32 },
+	PIX_PASS_LE_BE( AV_PIX_FMT_RGB48, vooDA_interleaved_444, vooCS_RGB, vooCO_c123 ),
+	PIX_PASS_LE_BE( AV_PIX_FMT_BGR48, vooDA_interleaved_444, vooCS_RGB, vooCO_c321 ),
+	PIX_PASS_LE_BE( AV_PIX_FMT_RGBA64, vooDA_interleaved_444, vooCS_RGB, vooCO_c123x ),
+	PIX_PASS_LE_BE( AV_PIX_FMT_BGRA64, vooDA_interleaved_444, vooCS_RGB, vooCO_c321x ),
+	{ AV_PIX_FMT_PAL8, AV_PIX_FMT_RGB24, vooDA_interleaved_444, vooCS_RGB, vooCO_c123, repack_pal8 },
+
+	PIX_GBR( AV_PIX_FMT_GBRP ),
+	PIX_GBR( AV_PIX_FMT_GBRAP ),
+	PIX_GBR_LE_BE( AV_PIX_FMT_GBRP9 ),
+	PIX_GBR_LE_BE( AV_PIX_FMT_GBRP10 ),
+	PIX_GBR_LE_BE( AV_PIX_FMT_GBRP12 ),
+	PIX_GBR_LE_BE( AV_PIX_FMT_GBRP14 ),
+	PIX_GBR_LE_BE( AV_PIX_FMT_GBRP16 ),
+	PIX_GBR_LE_BE( AV_PIX_FMT_GBRAP10 ),
+	PIX_GBR_LE_BE( AV_PIX_FMT_GBRAP12 ),
+	PIX_GBR_LE_BE( AV_PIX_FMT_GBRAP16 ),
+	// vooya only swaps 16 bit words, big endian floats are not shown
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT( 56, 14, 100 )
+	PIX_PASS( AV_PIX_FMT_GBRPF32LE, vooDA_planar_444float, vooCS_RGB, vooCO_c231 ),
+	PIX_PASS( AV_PIX_FMT_GBRAPF32LE, vooDA_planar_444float, vooCS_RGB, vooCO_c231 ),
+#endif
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT( 56, 22, 100 )
+	PIX_PASS( AV_PIX_FMT_GRAYF32LE, vooDA_singleFloat, vooCS_Gray, vooCO_c123 ),
+#endif
+};
+
+static const pix_fmt_map_t *pix_fmt_lookup( enum AVPixelFormat fmt ){
+	size_t i;
+	for( i = 0; i < FF_ARRAY_ELEMS( g_pix_fmts ); i++ )
+		if( g_pix_fmts[ i ].pix_fmt == fmt )
+			return &g_pix_fmts[ i ];
+	return NULL;
+}
+
+static const char *pix_fmt_name( enum AVPixelFormat fmt ){
+	const char *name = av_get_pix_fmt_name( fmt );
+	return name ? name : "none";
+}
+
+// Planes of a tightly packed w x h picture in fmt, without the alpha plane.
+static vooBOOL layout_compute( voo_layout_t *p_layout, enum AVPixelFormat fmt, int32_t w, int32_t h ){
+	const AVPixFmtDescriptor *p_desc = av_pix_fmt_desc_get( fmt );
+	int linesizes[ 4 ];
+	int32_t i;
+
+	memset( p_layout, 0, sizeof(voo_layout_t) );
+	if( !p_desc || 0 > av_image_fill_linesizes( linesizes, fmt, w ) )
+		return FALSE;
+	p_layout->n_planes = av_pix_fmt_count_planes( fmt );
+	if( ( p_desc->flags & AV_PIX_FMT_FLAG_ALPHA ) && ( p_desc->flags & AV_PIX_FMT_FLAG_PLANAR ) )
+		p_layout->n_planes--;
+	for( i = 0; i < p_layout->n_planes; i++ ){
+		p_layout->row_bytes[ i ] = linesizes[ i ];
+		p_layout->rows[ i ] = ( 1 == i || 2 == i ) ? AV_CEIL_RSHIFT( h, p_desc->log2_chroma_h ) : h;
+		p_layout->offset[ i ] = p_layout->size;
+		p_layout->size += (size_t)linesizes[ i ] * p_layout->rows[ i ];
+	}
+	return TRUE;
+}
 
 
 void message( void *_, const char *what ){
 	fprintf(stderr, "%s", what);
 }
-void av_mute_log_callback( void *avclass, int level, const char *format, va_list args ){/* mute */}
 
 
-typedef struct  
+// FFmpeg refuses to auto-scale frame threading beyond this and warns above it
+#define MAX_DECODER_THREADS 16
+// forward jumps up to this many frames are decoded through instead of seeking
+#define MAX_DECODE_FORWARD 32
+
+typedef enum {
+	THREAD_MODE_AUTO,   // decoder contexts side by side for intra-only codecs, else frame threading, else slices
+	THREAD_MODE_FRAME,
+	THREAD_MODE_SLICE,
+	THREAD_MODE_OFF,
+	THREAD_MODE_GOP     // like auto, plus GOPs side by side on decoder contexts once the index is complete
+} thread_mode_t;
+
+#define MAX_PREFETCH 64
+// average packet size from which packets are read ahead, see prefetcher_t
+#define PREFETCH_MIN_PACKET ( 1 << 20 )
+
+typedef enum
 {
-	voo_sequence_t properties;
+	IO_READ,            // large buffers, with readahead hints
+	IO_MMAP,            // the file mapped into memory
+	IO_FFMPEG,          // libavformat's own file protocol
+	IO_STREAM           // stdin, pipes and FIFOs, whatever VOOPLUS_IO says
+} io_backend_t;
 
-	AVPacket avpkt;
-	AVFormatContext *format_ctx;
-	AVCodecContext *codec_ctx;
-	AVStream *stream;
-	AVFrame *picture;
-	AVCodec *codec;
+// decoded pictures a stream keeps for stepping back, even without VOOPLUS_CACHE
+#define STREAM_HISTORY 16
+
+// Per-instance tunables. Defaults come from the environment at in_open( ... ),
+// so each sequence opened in vooya can be configured independently.
+typedef struct
+{
+	thread_mode_t thread_mode;  // VOOPLUS_THREAD_MODE=auto|frame|slice|off|gop
+	int32_t thread_count;       // VOOPLUS_THREADS=n, 0 scales with the core count
+	int32_t decode_ahead;       // VOOPLUS_DECODE_AHEAD=n frames, 0 decodes on vooya's thread
+	vooBOOL index;              // VOOPLUS_INDEX=0 disables the background packet index
+	vooBOOL index_cache;        // VOOPLUS_INDEX_CACHE=0 neither reads nor writes index files
+	int64_t cache_bytes;        // VOOPLUS_CACHE=bytes for decoded pictures, 0 disables the cache
+	vooBOOL direct;             // VOOPLUS_DIRECT=0 always lets libavcodec allocate pictures
+	vooBOOL parallel_copy;      // VOOPLUS_PARALLEL_COPY=0 copies large pictures on one thread
+	int64_t gop_memory;         // VOOPLUS_GOP_MEMORY=bytes of pictures buffered across GOPs in flight
+	vooBOOL reverse;            // VOOPLUS_REVERSE=0 serves backward steps by seeking like any other jump
+	int32_t scrub_ms;           // VOOPLUS_SCRUB_MS=jumps closer together are scrubbing, 0 always decodes exactly
+	int32_t scrub_lowres;       // VOOPLUS_SCRUB_LOWRES=log2 of the resolution reduction while scrubbing
+	vooBOOL realtime;           // VOOPLUS_REALTIME=1 drops pictures to hold the frame rate
+	int32_t proxy;              // VOOPLUS_PROXY=2|4 shows pictures at half or quarter size, as log2
+	io_backend_t io;            // VOOPLUS_IO=read|mmap|ffmpeg for local files
+	int64_t io_buffer;          // VOOPLUS_IO_BUFFER=bytes read at once
+	int64_t io_readahead;       // VOOPLUS_IO_READAHEAD=bytes the OS is asked to fetch ahead
+	int32_t prefetch;           // VOOPLUS_PREFETCH=packets read ahead asynchronously, 0 reads on demand
+	int64_t stream_buffer;      // VOOPLUS_STREAM_BUFFER=bytes of stdin or a pipe read ahead of the demuxer
+	vooBOOL follow;             // VOOPLUS_FOLLOW=1 keeps indexing a file that is still being written
+	int32_t follow_ms;          // VOOPLUS_FOLLOW_MS=interval it is checked at without inotify
+	const char *init_segment;   // read before the file, for fMP4 segments of a playlist
+	vooBOOL fast_open;          // VOOPLUS_FAST_OPEN=0 analyzes the streams before the first picture is shown
+	int64_t probe_size;         // VOOPLUS_PROBESIZE=bytes a demuxer may read to find the streams
+	int32_t analyze_ms;         // VOOPLUS_ANALYZE_MS=stream duration it may read for that
+	int64_t memory;             // VOOPLUS_MEMORY=bytes of pictures and packets a sequence may hold, 0 for no limit
+	int32_t log_level;          // VOOPLUS_LOG=quiet|error|warning|info for libav* messages on vooya's console
+	int32_t stats_s;            // VOOPLUS_STATS=seconds between timing summaries on vooya's console, 0 for none
+} reader_settings_t;
+
+static int32_t env_int( const char *name, int32_t def ){
+	const char *v = getenv( name );
+	if( !v || !*v )
+		return def;
+	return (int32_t)strtol( v, NULL, 10 );
+}
+
+// accepts a K, M or G suffix
+static int64_t env_bytes( const char *name, int64_t def ){
+	const char *v = getenv( name );
+	char *end;
+	int64_t n;
+	if( !v || !*v )
+		return def;
+	n = strtoll( v, &end, 10 );
+	switch( toupper( *end ) ){
+	case 'G': n <<= 10; /* fall through */
+	case 'M': n <<= 10; /* fall through */
+	case 'K': n <<= 10;
+	default: break;
+	}
+	return n;
+}
+
+static void settings_from_env( reader_settings_t *p_settings ){
+	const char *mode = getenv( "VOOPLUS_THREAD_MODE" );
+	p_settings->thread_mode = THREAD_MODE_AUTO;
+	if( mode ){
+		if( !strcmp( mode, "frame" ) )
+			p_settings->thread_mode = THREAD_MODE_FRAME;
+		else if( !strcmp( mode, "slice" ) )
+			p_settings->thread_mode = THREAD_MODE_SLICE;
+		else if( !strcmp( mode, "off" ) )
+			p_settings->thread_mode = THREAD_MODE_OFF;
+		else if( !strcmp( mode, "gop" ) )
+			p_settings->thread_mode = THREAD_MODE_GOP;
+	}
+	p_settings->thread_count = env_int( "VOOPLUS_THREADS", 0 );
+	p_settings->decode_ahead = env_int( "VOOPLUS_DECODE_AHEAD", 4 );
+	p_settings->index = env_int( "VOOPLUS_INDEX", 1 );
+	p_settings->index_cache = env_int( "VOOPLUS_INDEX_CACHE", 1 );
+	p_settings->cache_bytes = env_bytes( "VOOPLUS_CACHE", (int64_t)1 << 30 );
+	p_settings->direct = env_int( "VOOPLUS_DIRECT", 1 );
+	p_settings->parallel_copy = env_int( "VOOPLUS_PARALLEL_COPY", 1 );
+	p_settings->gop_memory = env_bytes( "VOOPLUS_GOP_MEMORY", (int64_t)2 << 30 );
+	p_settings->reverse = env_int( "VOOPLUS_REVERSE", 1 );
+	p_settings->scrub_ms = FFMAX( env_int( "VOOPLUS_SCRUB_MS", 150 ), 0 );
+	p_settings->scrub_lowres = FFMIN( FFMAX( env_int( "VOOPLUS_SCRUB_LOWRES", 1 ), 0 ), 3 );
+	p_settings->realtime = env_int( "VOOPLUS_REALTIME", 0 );
+	switch( env_int( "VOOPLUS_PROXY", 1 ) ){
+	case 2: p_settings->proxy = 1; break;
+	case 4: p_settings->proxy = 2; break;
+	default: p_settings->proxy = 0; break;
+	}
+	mode = getenv( "VOOPLUS_IO" );
+	p_settings->io = IO_READ;
+	if( mode ){
+		if( !strcmp( mode, "mmap" ) )
+			p_settings->io = IO_MMAP;
+		else if( !strcmp( mode, "ffmpeg" ) )
+			p_settings->io = IO_FFMPEG;
+	}
+	p_settings->io_buffer = FFMIN( FFMAX( env_bytes( "VOOPLUS_IO_BUFFER", 4 << 20 ), 4096 ), 1 << 30 );
+	p_settings->io_readahead = FFMAX( env_bytes( "VOOPLUS_IO_READAHEAD", 64 << 20 ), 0 );
+	p_settings->prefetch = FFMIN( FFMAX( env_int( "VOOPLUS_PREFETCH", 8 ), 0 ), MAX_PREFETCH );
+	p_settings->stream_buffer = FFMAX( env_bytes( "VOOPLUS_STREAM_BUFFER", 64 << 20 ), 1 << 20 );
+	p_settings->follow = env_int( "VOOPLUS_FOLLOW", 0 ) && p_settings->index;
+	p_settings->follow_ms = FFMAX( env_int( "VOOPLUS_FOLLOW_MS", 250 ), 10 );
+	p_settings->fast_open = env_int( "VOOPLUS_FAST_OPEN", 1 );
+	p_settings->probe_size = FFMAX( env_bytes( "VOOPLUS_PROBESIZE", 1 << 20 ), 1 << 16 );
+	p_settings->analyze_ms = FFMAX( env_int( "VOOPLUS_ANALYZE_MS", 500 ), 0 );
+	mode = getenv( "VOOPLUS_LOG" );
+	p_settings->log_level = AV_LOG_ERROR;
+	if( mode ){
+		if( !strcmp( mode, "quiet" ) )
+			p_settings->log_level = AV_LOG_QUIET;
+		else if( !strcmp( mode, "warning" ) )
+			p_settings->log_level = AV_LOG_WARNING;
+		else if( !strcmp( mode, "info" ) )
+			p_settings->log_level = AV_LOG_INFO;
+	}
+	p_settings->stats_s = FFMAX( env_int( "VOOPLUS_STATS", 0 ), 0 );
+	// the frame cache and GOP buffering get their share of the ceiling
+	p_settings->memory = FFMAX( env_bytes( "VOOPLUS_MEMORY", 0 ), 0 );
+	if( p_settings->memory ){
+		p_settings->cache_bytes = FFMIN( p_settings->cache_bytes, p_settings->memory / 2 );
+		p_settings->gop_memory = FFMIN( p_settings->gop_memory, p_settings->memory / 4 );
+	}
+	// a growing index is only looked at from vooya's thread, see follow_t; the
+	// file is read, a mapping would not grow with it
+	if( p_settings->follow ){
+		p_settings->io = IO_READ;
+		p_settings->index_cache = FALSE;
+		p_settings->reverse = FALSE;
+		if( THREAD_MODE_GOP == p_settings->thread_mode )
+			p_settings->thread_mode = THREAD_MODE_AUTO;
+	}
+}
+
+
+// File input of our own for local files, behind an AVIOContext: read in large
+// buffers or mapped into memory. Either way the OS is told which bytes come
+// next, from the read position or, with the index, from the packets ahead.
+// stdin, pipes and FIFOs cannot seek; a thread reads them into a ring the
+// demuxer consumes, so a writer never waits for vooya's decoding.
+typedef struct
+{
+	io_backend_t backend;
+#ifdef WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+	const uint8_t *p_map;
+	int64_t map_size;
+	int64_t pos;
+	int64_t readahead;
+	int64_t hinted_from, hinted_to;   // range the OS was last told about
+	voo_mutex_t lock;                 // hints come from vooya's thread and the demuxing one
+	AVIOContext *p_avio;
+#ifndef WIN32
+	void *volatile p_prefetch;        // prefetcher_t of packets read ahead, see prefetch_want( ... );
+	                                  // set on vooya's thread once, read by voo_atomic_get_ptr( ... )
+#endif
+	// IO_STREAM: both positions only grow and each has a single writer, so
+	// bytes are handed over without the lock; it only parks a side that waits
+	uint8_t *p_ring;
+	int64_t ring_size;
+	volatile int64_t written;         // by the reading thread
+	volatile int64_t consumed;        // by the demuxer, "pos" published
+	vooBOOL b_ended;                  // no more bytes will come, see "status"
+	vooBOOL b_stop;
+	int32_t status;                   // 0 at the end of the stream, else why reading stopped
+	voo_cond_t cond;
+	voo_thread_t thread;
+	vooBOOL b_thread;
+	// following a file that is being written: reads at its end call "caught_up"
+	// and wait for it to grow until *pb_follow_stop is set
+	const volatile vooBOOL *pb_follow_stop;
+	void (*caught_up)( void * );
+	void *p_caught_up_arg;
+	int32_t follow_ms;
+#ifdef __linux__
+	int notify_fd;                    // inotify, -1 polls
+#endif
+	volatile int64_t limit;           // > 0: reads end here, after the last packet known to be complete
+	// fMP4 segments: the init segment they need, read as if it came first
+#ifdef WIN32
+	HANDLE prefix_file;
+#else
+	int prefix_fd;
+#endif
+	int64_t prefix_size;
+} file_io_t;
+
+#ifndef WIN32
+// Asynchronous reads of the packets coming up, for streams whose packets are
+// big enough that reading one on demand shows in the frame time (v210,
+// ProRes 4444 XQ). The reader says which byte ranges it wants, see
+// io_prefetch( ... ); io_read( ... ) takes finished ones and waits for those
+// still in flight. Reads go through io_uring where the kernel has it, else
+// through a few threads calling pread( ).
+
+typedef enum
+{
+	SLOT_FREE,
+	SLOT_QUEUED,    // waiting for a pread thread
+	SLOT_READING,
+	SLOT_DONE,      // "got" bytes are in p_data
+	SLOT_FAILED
+} slot_state_t;
+
+typedef struct
+{
+	int64_t pos;
+	int32_t size;
+	int32_t got;
+	uint8_t *p_data;
+	int32_t capacity;
+	slot_state_t state;
+	struct iovec iov;
+} prefetch_slot_t;
+
+typedef struct prefetcher_s
+{
+	int fd;
+	prefetch_slot_t slots[ MAX_PREFETCH ];
+	int32_t n_slots;
+	int32_t n_reading;
+	int64_t read_pos;             // where the demuxer last read, see prefetch_take( ... )
+	vooBOOL b_stop;
+	voo_mutex_t lock;
+	voo_cond_t cond;
+	voo_thread_t threads[ 4 ];
+	int32_t n_threads;
+	uint64_t hits, waits, misses;
+#ifdef HAVE_IO_URING
+	int ring_fd;                  // -1 without io_uring
+	uint32_t *sq_head, *sq_tail, *sq_mask, *sq_array;
+	uint32_t *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *p_sq_ring, *p_cq_ring;
+	size_t sq_ring_size, cq_ring_size, sqes_size;
+#endif
+} prefetcher_t;
+
+#define PREFETCH_WAKE_UP UINT64_MAX
+
+static void prefetch_finish( prefetcher_t *p_pf, prefetch_slot_t *p_slot, int64_t got ){
+	p_slot->got = (int32_t)FFMAX( got, 0 );
+	p_slot->state = got > 0 ? SLOT_DONE : SLOT_FAILED;
+	p_pf->n_reading--;
+	voo_cond_broadcast( &p_pf->cond );
+}
+
+#ifdef HAVE_IO_URING
+static void uring_close( prefetcher_t *p_pf ){
+	if( MAP_FAILED != (void *)p_pf->sqes ) munmap( p_pf->sqes, p_pf->sqes_size );
+	if( MAP_FAILED != p_pf->p_cq_ring ) munmap( p_pf->p_cq_ring, p_pf->cq_ring_size );
+	if( MAP_FAILED != p_pf->p_sq_ring ) munmap( p_pf->p_sq_ring, p_pf->sq_ring_size );
+	close( p_pf->ring_fd );
+	p_pf->ring_fd = -1;
+}
+
+static vooBOOL uring_open( prefetcher_t *p_pf ){
+	struct io_uring_params params;
+	uint8_t *p_sq, *p_cq;
+
+	memset( &params, 0, sizeof(params) );
+	if( 0 > (p_pf->ring_fd = (int)syscall( __NR_io_uring_setup, MAX_PREFETCH, &params )) )
+		return FALSE;
+	p_pf->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	p_pf->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	p_pf->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	p_pf->p_sq_ring = mmap( NULL, p_pf->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_pf->ring_fd, IORING_OFF_SQ_RING );
+	p_pf->p_cq_ring = mmap( NULL, p_pf->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_pf->ring_fd, IORING_OFF_CQ_RING );
+	p_pf->sqes = (struct io_uring_sqe *)mmap( NULL, p_pf->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_pf->ring_fd, IORING_OFF_SQES );
+	if( MAP_FAILED == p_pf->p_sq_ring || MAP_FAILED == p_pf->p_cq_ring || MAP_FAILED == (void *)p_pf->sqes ){
+		uring_close( p_pf );
+		return FALSE;
+	}
+	p_sq = (uint8_t *)p_pf->p_sq_ring;
+	p_cq = (uint8_t *)p_pf->p_cq_ring;
+	p_pf->sq_head = (uint32_t *)( p_sq + params.sq_off.head );
+	p_pf->sq_tail = (uint32_t *)( p_sq + params.sq_off.tail );
+	p_pf->sq_mask = (uint32_t *)( p_sq + params.sq_off.ring_mask );
+	p_pf->sq_array = (uint32_t *)( p_sq + params.sq_off.array );
+	p_pf->cq_head = (uint32_t *)( p_cq + params.cq_off.head );
+	p_pf->cq_tail = (uint32_t *)( p_cq + params.cq_off.tail );
+	p_pf->cq_mask = (uint32_t *)( p_cq + params.cq_off.ring_mask );
+	p_pf->cqes = (struct io_uring_cqe *)( p_cq + params.cq_off.cqes );
+	return TRUE;
+}
+
+// with p_pf->lock held; p_slot NULL submits a no-op that wakes the reaper
+static vooBOOL uring_submit( prefetcher_t *p_pf, prefetch_slot_t *p_slot ){
+	uint32_t tail = __atomic_load_n( p_pf->sq_tail, __ATOMIC_RELAXED ), idx = tail & *p_pf->sq_mask;
+	struct io_uring_sqe *p_sqe = &p_pf->sqes[ idx ];
+
+	if( tail - __atomic_load_n( p_pf->sq_head, __ATOMIC_ACQUIRE ) > *p_pf->sq_mask )
+		return FALSE;
+	memset( p_sqe, 0, sizeof(struct io_uring_sqe) );
+	if( p_slot ){
+		p_slot->iov.iov_base = p_slot->p_data;
+		p_slot->iov.iov_len = p_slot->size;
+		p_sqe->opcode = IORING_OP_READV;
+		p_sqe->fd = p_pf->fd;
+		p_sqe->off = p_slot->pos;
+		p_sqe->addr = (uint64_t)(uintptr_t)&p_slot->iov;
+		p_sqe->len = 1;
+		p_sqe->user_data = (uint64_t)( p_slot - p_pf->slots );
+	} else {
+		p_sqe->opcode = IORING_OP_NOP;
+		p_sqe->user_data = PREFETCH_WAKE_UP;
+	}
+	p_pf->sq_array[ idx ] = idx;
+	__atomic_store_n( p_pf->sq_tail, tail + 1, __ATOMIC_RELEASE );
+	return 0 <= syscall( __NR_io_uring_enter, p_pf->ring_fd, 1, 0, 0, NULL, 0 );
+}
+
+// Waits for completions and hands the slots to io_read( ... ).
+static void uring_thread( void *p_arg ){
+	prefetcher_t *p_pf = (prefetcher_t *)p_arg;
+	uint32_t head, tail;
+	struct io_uring_cqe *p_cqe;
+
+	for( ;; ){
+		syscall( __NR_io_uring_enter, p_pf->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0 );
+		voo_mutex_lock( &p_pf->lock );
+		head = __atomic_load_n( p_pf->cq_head, __ATOMIC_RELAXED );
+		tail = __atomic_load_n( p_pf->cq_tail, __ATOMIC_ACQUIRE );
+		for( ; head != tail; head++ ){
+			p_cqe = &p_pf->cqes[ head & *p_pf->cq_mask ];
+			if( p_cqe->user_data < (uint64_t)p_pf->n_slots )
+				prefetch_finish( p_pf, &p_pf->slots[ p_cqe->user_data ], p_cqe->res );
+		}
+		__atomic_store_n( p_pf->cq_head, head, __ATOMIC_RELEASE );
+		if( p_pf->b_stop && !p_pf->n_reading ){
+			voo_mutex_unlock( &p_pf->lock );
+			return;
+		}
+		voo_mutex_unlock( &p_pf->lock );
+	}
+}
+#endif
+
+// the pread( ) fallback, earliest queued range first
+static void pread_thread( void *p_arg ){
+	prefetcher_t *p_pf = (prefetcher_t *)p_arg;
+	prefetch_slot_t *p_slot;
+	int64_t got;
+	int32_t i;
+
+	voo_mutex_lock( &p_pf->lock );
+	while( !p_pf->b_stop ){
+		p_slot = NULL;
+		for( i = 0; i < p_pf->n_slots; i++ )
+			if( SLOT_QUEUED == p_pf->slots[ i ].state && ( !p_slot || p_pf->slots[ i ].pos < p_slot->pos ) )
+				p_slot = &p_pf->slots[ i ];
+		if( !p_slot ){
+			voo_cond_wait( &p_pf->cond, &p_pf->lock );
+			continue;
+		}
+		p_slot->state = SLOT_READING;
+		voo_mutex_unlock( &p_pf->lock );
+		got = pread( p_pf->fd, p_slot->p_data, (size_t)p_slot->size, (off_t)p_slot->pos );
+		voo_mutex_lock( &p_pf->lock );
+		prefetch_finish( p_pf, p_slot, got );
+	}
+	voo_mutex_unlock( &p_pf->lock );
+}
+
+static void prefetch_free( prefetcher_t *p_pf ){
+	int32_t i;
+	voo_mutex_lock( &p_pf->lock );
+	p_pf->b_stop = TRUE;
+	voo_cond_broadcast( &p_pf->cond );
+#ifdef HAVE_IO_URING
+	if( p_pf->ring_fd >= 0 )
+		uring_submit( p_pf, NULL );
+#endif
+	voo_mutex_unlock( &p_pf->lock );
+	for( i = 0; i < p_pf->n_threads; i++ )
+		voo_thread_join( p_pf->threads[ i ] );
+#ifdef HAVE_IO_URING
+	if( p_pf->ring_fd >= 0 )
+		uring_close( p_pf );
+#endif
+	for( i = 0; i < p_pf->n_slots; i++ )
+		av_free( p_pf->slots[ i ].p_data );
+	voo_mutex_destroy( &p_pf->lock );
+	voo_cond_destroy( &p_pf->cond );
+	free( p_pf );
+}
+
+static prefetcher_t *prefetch_init( int fd, int32_t n_slots ){
+	prefetcher_t *p_pf = (prefetcher_t *)calloc( 1, sizeof(prefetcher_t) );
+	int32_t i, n;
+	if( !p_pf )
+		return NULL;
+	p_pf->fd = fd;
+	p_pf->n_slots = n_slots;
+	voo_mutex_init( &p_pf->lock );
+	voo_cond_init( &p_pf->cond );
+#ifdef HAVE_IO_URING
+	if( uring_open( p_pf ) ){
+		if( voo_thread_create( &p_pf->threads[ 0 ], uring_thread, p_pf ) ){
+			p_pf->n_threads = 1;
+			return p_pf;
+		}
+		uring_close( p_pf );
+	}
+	// kernels before 5.1, or io_uring disabled (containers, seccomp)
+	p_pf->ring_fd = -1;
+#endif
+	n = FFMIN( n_slots, (int32_t)FF_ARRAY_ELEMS( p_pf->threads ) );
+	for( i = 0; i < n && voo_thread_create( &p_pf->threads[ i ], pread_thread, p_pf ); i++ )
+		p_pf->n_threads++;
+	if( !p_pf->n_threads ){
+		prefetch_free( p_pf );
+		return NULL;
+	}
+	return p_pf;
+}
+
+// Queues reads of the ranges not held or in flight yet, as many as there are
+// slots, leaving out those the demuxer has read past. Slots whose range is
+// no longer wanted, the ones left behind by a seek, are reused.
+static void prefetch_want( prefetcher_t *p_pf, const int64_t *p_pos, const int32_t *p_size, int32_t n ){
+	prefetch_slot_t *p_slot;
+	int32_t i, j, k;
+	vooBOOL b_wanted;
+
+	voo_mutex_lock( &p_pf->lock );
+	for( i = 0; i < n && !p_pf->b_stop; i++ ){
+		if( p_pos[ i ] + p_size[ i ] <= p_pf->read_pos )
+			continue;
+		for( j = 0; j < p_pf->n_slots; j++ )
+			if( SLOT_FREE != p_pf->slots[ j ].state && p_pf->slots[ j ].pos == p_pos[ i ] )
+				break;
+		if( j < p_pf->n_slots )
+			continue;
+		p_slot = NULL;
+		for( j = 0; j < p_pf->n_slots && !p_slot; j++ ){
+			if( SLOT_FREE == p_pf->slots[ j ].state ){
+				p_slot = &p_pf->slots[ j ];
+				break;
+			}
+			if( SLOT_DONE != p_pf->slots[ j ].state && SLOT_FAILED != p_pf->slots[ j ].state )
+				continue;
+			for( b_wanted = FALSE, k = 0; k < n; k++ )
+				b_wanted |= p_pf->slots[ j ].pos == p_pos[ k ];
+			if( !b_wanted )
+				p_slot = &p_pf->slots[ j ];
+		}
+		if( !p_slot )
+			break;
+		if( p_slot->capacity < p_size[ i ] ){
+			av_freep( &p_slot->p_data );
+			p_slot->capacity = 0;
+			p_slot->state = SLOT_FREE;
+			if( !(p_slot->p_data = (uint8_t *)av_malloc( p_size[ i ] )) )
+				break;
+			p_slot->capacity = p_size[ i ];
+		}
+		p_slot->pos = p_pos[ i ];
+		p_slot->size = p_size[ i ];
+		p_slot->got = 0;
+		p_pf->n_reading++;
+#ifdef HAVE_IO_URING
+		if( p_pf->ring_fd >= 0 ){
+			p_slot->state = SLOT_READING;
+			if( !uring_submit( p_pf, p_slot ) ){
+				p_slot->state = SLOT_FREE;
+				p_pf->n_reading--;
+				break;
+			}
+			continue;
+		}
+#endif
+		p_slot->state = SLOT_QUEUED;
+		voo_cond_broadcast( &p_pf->cond );
+	}
+	voo_mutex_unlock( &p_pf->lock );
+}
+
+// Copies what a slot holds at "pos", waiting for a read in flight. 0 if no
+// slot has it; a slot read to its end is free again.
+static int32_t prefetch_take( prefetcher_t *p_pf, int64_t pos, uint8_t *p_buf, int32_t size ){
+	prefetch_slot_t *p_slot = NULL;
+	int32_t i, n = 0;
+
+	voo_mutex_lock( &p_pf->lock );
+	p_pf->read_pos = pos;
+	for( i = 0; i < p_pf->n_slots; i++ )
+		if( SLOT_FREE != p_pf->slots[ i ].state && p_pf->slots[ i ].pos <= pos && pos < p_pf->slots[ i ].pos + p_pf->slots[ i ].size )
+			p_slot = &p_pf->slots[ i ];
+	if( !p_slot ){
+		p_pf->misses++;
+		voo_mutex_unlock( &p_pf->lock );
+		return 0;
+	}
+	if( SLOT_QUEUED == p_slot->state || SLOT_READING == p_slot->state )
+		p_pf->waits++;
+	while( SLOT_QUEUED == p_slot->state || SLOT_READING == p_slot->state )
+		voo_cond_wait( &p_pf->cond, &p_pf->lock );
+	if( SLOT_DONE == p_slot->state && pos < p_slot->pos + p_slot->got ){
+		n = (int32_t)FFMIN( (int64_t)size, p_slot->pos + p_slot->got - pos );
+		memcpy( p_buf, p_slot->p_data + ( pos - p_slot->pos ), n );
+		p_pf->read_pos = pos + n;
+		p_pf->hits++;
+	}
+	if( SLOT_FAILED == p_slot->state || pos + n >= p_slot->pos + p_slot->got )
+		p_slot->state = SLOT_FREE;
+	voo_mutex_unlock( &p_pf->lock );
+	return n;
+}
+#endif
+
+static int64_t io_size( file_io_t *p_io ){
+	int64_t limit = voo_atomic_get( &p_io->limit );
+#ifdef WIN32
+	LARGE_INTEGER size;
+	if( p_io->p_map )
+		return p_io->map_size;
+	if( !GetFileSizeEx( p_io->file, &size ) )
+		return AVERROR( EIO );
+	size.QuadPart += p_io->prefix_size;
+	return limit > 0 ? FFMIN( size.QuadPart, limit ) : size.QuadPart;
+#else
+	struct stat st;
+	if( p_io->p_map )
+		return p_io->map_size;
+	if( fstat( p_io->fd, &st ) )
+		return AVERROR( errno );
+	st.st_size += p_io->prefix_size;
+	return limit > 0 ? FFMIN( (int64_t)st.st_size, limit ) : (int64_t)st.st_size;
+#endif
+}
+
+// Asks the OS to fetch [from, from + len) ahead of time. Ranges mostly told
+// already are not repeated, so this is cheap to call for every read.
+static void io_hint( file_io_t *p_io, int64_t from, int64_t len ){
+	int64_t to;
+	// the file's own bytes, after an init segment
+	if( (from -= p_io->prefix_size) < 0 ){
+		len += from;
+		from = 0;
+	}
+	to = from + len;
+	if( len <= 0 )
+		return;
+	voo_mutex_lock( &p_io->lock );
+	if( from >= p_io->hinted_from && from <= p_io->hinted_to ){
+		if( to - p_io->hinted_to < len / 4 ){
+			voo_mutex_unlock( &p_io->lock );
+			return;
+		}
+		from = p_io->hinted_to;
+	} else
+		p_io->hinted_from = from;
+	p_io->hinted_to = to;
+	voo_mutex_unlock( &p_io->lock );
+
+#ifndef WIN32
+	if( p_io->p_map ){
+		int64_t page = sysconf( _SC_PAGESIZE ), begin = from / page * page;
+		if( begin < p_io->map_size )
+			madvise( (void *)( p_io->p_map + begin ), (size_t)( FFMIN( to, p_io->map_size ) - begin ), MADV_WILLNEED );
+	} else {
+	#if defined( __APPLE__ )
+		struct radvisory ra;
+		ra.ra_offset = from;
+		ra.ra_count = (int)FFMIN( to - from, INT32_MAX );
+		fcntl( p_io->fd, F_RDADVISE, &ra );
+	#else
+		posix_fadvise( p_io->fd, from, to - from, POSIX_FADV_WILLNEED );
+	#endif
+	}
+#endif
+}
+
+// the file may grow while it is read, its size is not taken for granted
+static int64_t io_pread( file_io_t *p_io, uint8_t *p_buf, int size ){
+	int64_t pos = p_io->pos - p_io->prefix_size;
+#ifdef WIN32
+	HANDLE file = p_io->file;
+	OVERLAPPED at;
+	DWORD got = 0;
+	if( pos < 0 ){
+		file = p_io->prefix_file;
+		pos = p_io->pos;
+		size = (int)FFMIN( (int64_t)size, p_io->prefix_size - pos );
+	}
+	memset( &at, 0, sizeof(OVERLAPPED) );
+	at.Offset = (DWORD)pos;
+	at.OffsetHigh = (DWORD)( pos >> 32 );
+	if( !ReadFile( file, p_buf, (DWORD)size, &got, &at ) && ERROR_HANDLE_EOF != GetLastError() )
+		return AVERROR( EIO );
+	return got;
+#else
+	int fd = p_io->fd;
+	ssize_t n;
+	if( pos < 0 ){
+		fd = p_io->prefix_fd;
+		pos = p_io->pos;
+		size = (int)FFMIN( (int64_t)size, p_io->prefix_size - pos );
+	}
+	n = pread( fd, p_buf, (size_t)size, (off_t)pos );
+	return n < 0 ? AVERROR( errno ) : n;
+#endif
+}
+
+// Waits for the followed file to change, at most the poll interval.
+static void follow_wait( file_io_t *p_io ){
+#ifdef __linux__
+	if( p_io->notify_fd >= 0 ){
+		struct pollfd pfd;
+		char events[ 4096 ];
+		pfd.fd = p_io->notify_fd;
+		pfd.events = POLLIN;
+		if( 0 < poll( &pfd, 1, p_io->follow_ms ) )
+			while( 0 < read( p_io->notify_fd, events, sizeof(events) ) );
+		return;
+	}
+#endif
+#ifdef WIN32
+	Sleep( p_io->follow_ms );
+#else
+	usleep( p_io->follow_ms * 1000 );
+#endif
+}
+
+static int io_read( void *opaque, uint8_t *p_buf, int size ){
+	file_io_t *p_io = (file_io_t *)opaque;
+	int64_t n, limit = voo_atomic_get( &p_io->limit );
+
+	if( limit > 0 ){
+		if( p_io->pos >= limit )
+			return AVERROR_EOF;
+		size = (int)FFMIN( (int64_t)size, limit - p_io->pos );
+	}
+	if( p_io->p_map ){
+		n = FFMIN( (int64_t)size, p_io->map_size - p_io->pos );
+		if( n > 0 )
+			memcpy( p_buf, p_io->p_map + p_io->pos, (size_t)n );
+	} else {
+#ifndef WIN32
+		prefetcher_t *p_pf = (prefetcher_t *)voo_atomic_get_ptr( &p_io->p_prefetch );
+		if( p_pf && (n = prefetch_take( p_pf, p_io->pos, p_buf, size )) > 0 ){
+			p_io->pos += n;
+			return (int)n;
+		}
+#endif
+		if( 0 > (n = io_pread( p_io, p_buf, size )) )
+			return (int)n;
+		// the end of a followed file is only where its writer has got to
+		while( !n && p_io->pb_follow_stop && !*p_io->pb_follow_stop ){
+			p_io->caught_up( p_io->p_caught_up_arg );
+			follow_wait( p_io );
+			if( 0 > (n = io_pread( p_io, p_buf, size )) )
+				return (int)n;
+		}
+	}
+	if( n <= 0 )
+		return AVERROR_EOF;
+	p_io->pos += n;
+	io_hint( p_io, p_io->pos, p_io->readahead );
+	return (int)n;
+}
+
+static int64_t io_seek( void *opaque, int64_t offset, int whence ){
+	file_io_t *p_io = (file_io_t *)opaque;
+	switch( whence & ~AVSEEK_FORCE ){
+	case AVSEEK_SIZE: return io_size( p_io );
+	case SEEK_SET: break;
+	case SEEK_CUR: offset += p_io->pos; break;
+	case SEEK_END: offset += io_size( p_io ); break;
+	default: return AVERROR( EINVAL );
+	}
+	if( offset < 0 )
+		return AVERROR( EINVAL );
+	return p_io->pos = offset;
+}
+
+// "-" and "pipe:" are stdin (or "pipe:N" that descriptor), besides named pipes
+// and FIFOs. Opening a FIFO waits for its writer, as probing would anyway.
+#ifdef WIN32
+static HANDLE stream_source( const char *filename ){
+	HANDLE h = INVALID_HANDLE_VALUE, self = GetCurrentProcess(), from = INVALID_HANDLE_VALUE;
+	if( !strcmp( filename, "-" ) || !strcmp( filename, "pipe:" ) )
+		from = GetStdHandle( STD_INPUT_HANDLE );
+	else if( !strncmp( filename, "pipe:", 5 ) )
+		from = (HANDLE)_get_osfhandle( atoi( filename + 5 ) );
+	else if( !strncmp( filename, "\\\\.\\pipe\\", 9 ) )
+		return CreateFileA( filename, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL );
+	if( INVALID_HANDLE_VALUE != from && from )
+		DuplicateHandle( self, from, self, &h, 0, FALSE, DUPLICATE_SAME_ACCESS );
+	return h;
+}
+#else
+static int stream_source( const char *filename ){
+	struct stat st;
+	if( !strcmp( filename, "-" ) || !strcmp( filename, "pipe:" ) )
+		return dup( 0 );
+	if( !strncmp( filename, "pipe:", 5 ) )
+		return dup( atoi( filename + 5 ) );
+	if( !stat( filename, &st ) && S_ISFIFO( st.st_mode ) )
+		return open( filename, O_RDONLY );
+	return -1;
+}
+#endif
+
+// Reads what is there, up to "size" bytes; 0 at the end of the stream.
+static int64_t stream_fill( file_io_t *p_io, uint8_t *p_dst, int64_t size ){
+#ifdef WIN32
+	DWORD got = 0;
+	if( ReadFile( p_io->file, p_dst, (DWORD)FFMIN( size, 1 << 30 ), &got, NULL ) )
+		return got;
+	switch( GetLastError() ){
+	case ERROR_BROKEN_PIPE:
+	case ERROR_HANDLE_EOF: return 0;
+	case ERROR_OPERATION_ABORTED: return AVERROR_EXIT;   // see io_close_file( ... )
+	default: return AVERROR( EIO );
+	}
+#else
+	// polled, so that closing does not wait for a writer that sends nothing
+	struct pollfd pfd;
+	ssize_t n;
+	pfd.fd = p_io->fd;
+	pfd.events = POLLIN;
+	while( !p_io->b_stop ){
+		pfd.revents = 0;
+		if( 0 > poll( &pfd, 1, 100 ) && EINTR != errno )
+			return AVERROR( errno );
+		if( !pfd.revents )
+			continue;
+		if( 0 <= (n = read( p_io->fd, p_dst, (size_t)FFMIN( size, 1 << 30 ) )) )
+			return n;
+		if( EINTR != errno && EAGAIN != errno )
+			return AVERROR( errno );
+	}
+	return AVERROR_EXIT;
+#endif
+}
+
+static void stream_wake( file_io_t *p_io ){
+	voo_mutex_lock( &p_io->lock );
+	voo_cond_broadcast( &p_io->cond );
+	voo_mutex_unlock( &p_io->lock );
+}
+
+static void stream_thread( void *p_arg ){
+	file_io_t *p_io = (file_io_t *)p_arg;
+	int64_t written = 0, n = 0, at;
+
+	while( !p_io->b_stop ){
+		if( written - voo_atomic_get( &p_io->consumed ) == p_io->ring_size ){
+			voo_mutex_lock( &p_io->lock );
+			while( !p_io->b_stop && written - voo_atomic_get( &p_io->consumed ) == p_io->ring_size )
+				voo_cond_wait( &p_io->cond, &p_io->lock );
+			voo_mutex_unlock( &p_io->lock );
+			continue;
+		}
+		at = written % p_io->ring_size;
+		n = FFMIN( p_io->ring_size - ( written - voo_atomic_get( &p_io->consumed ) ), p_io->ring_size - at );
+		if( (n = stream_fill( p_io, p_io->p_ring + at, n )) <= 0 )
+			break;
+		written += n;
+		voo_atomic_set( &p_io->written, written );
+		stream_wake( p_io );
+	}
+
+	voo_mutex_lock( &p_io->lock );
+	p_io->b_ended = TRUE;
+	p_io->status = n < 0 ? (int32_t)n : 0;
+	voo_cond_broadcast( &p_io->cond );
+	voo_mutex_unlock( &p_io->lock );
+}
+
+static int stream_read( void *opaque, uint8_t *p_buf, int size ){
+	file_io_t *p_io = (file_io_t *)opaque;
+	int64_t avail = voo_atomic_get( &p_io->written ) - p_io->pos, n, at, first;
+
+	if( !avail ){
+		voo_mutex_lock( &p_io->lock );
+		while( !(avail = voo_atomic_get( &p_io->written ) - p_io->pos) && !p_io->b_ended && !p_io->b_stop )
+			voo_cond_wait( &p_io->cond, &p_io->lock );
+		voo_mutex_unlock( &p_io->lock );
+		if( !avail )
+			return p_io->b_stop ? AVERROR_EXIT : p_io->status < 0 ? p_io->status : AVERROR_EOF;
+	}
+	n = FFMIN( avail, (int64_t)size );
+	at = p_io->pos % p_io->ring_size;
+	first = FFMIN( n, p_io->ring_size - at );
+	memcpy( p_buf, p_io->p_ring + at, (size_t)first );
+	memcpy( p_buf + first, p_io->p_ring, (size_t)( n - first ) );
+	p_io->pos += n;
+	voo_atomic_set( &p_io->consumed, p_io->pos );
+	stream_wake( p_io );
+	return (int)n;
+}
+
+// Makes reads waiting for the stream return, so that threads demuxing from it
+// can be stopped before it is closed.
+static void stream_abort( file_io_t *p_io ){
+	if( !p_io || IO_STREAM != p_io->backend )
+		return;
+	voo_mutex_lock( &p_io->lock );
+	p_io->b_stop = TRUE;
+	voo_cond_broadcast( &p_io->cond );
+	voo_mutex_unlock( &p_io->lock );
+}
+
+static void stream_close( file_io_t *p_io ){
+	stream_abort( p_io );
+	if( p_io->b_thread ){
+#ifdef WIN32
+		// ReadFile( ... ) on a pipe only returns once cancelled
+		while( WAIT_TIMEOUT == WaitForSingleObject( p_io->thread, 10 ) )
+			CancelSynchronousIo( p_io->thread );
+#endif
+		voo_thread_join( p_io->thread );
+	}
+	voo_cond_destroy( &p_io->cond );
+	av_freep( &p_io->p_ring );
+}
+
+static file_io_t *stream_open( file_io_t *p_io, const reader_settings_t *p_settings ){
+	uint8_t *p_buf;
+	p_io->backend = IO_STREAM;
+	voo_cond_init( &p_io->cond );
+	p_io->ring_size = p_settings->stream_buffer;
+	if( !(p_io->p_ring = (uint8_t *)av_malloc( (size_t)p_io->ring_size )) )
+		return NULL;
+	if( !(p_io->b_thread = voo_thread_create( &p_io->thread, stream_thread, p_io )) )
+		return NULL;
+	// no seek callback: the demuxer knows it cannot seek
+	if( !(p_buf = (uint8_t *)av_malloc( (size_t)p_settings->io_buffer )) )
+		return NULL;
+	if( !(p_io->p_avio = avio_alloc_context( p_buf, (int)p_settings->io_buffer, 0, p_io, stream_read, NULL, NULL )) ){
+		av_free( p_buf );
+		return NULL;
+	}
+	return p_io;
+}
+
+static void io_close_file( file_io_t *p_io ){
+	if( IO_STREAM == p_io->backend )
+		stream_close( p_io );
+	if( p_io->p_avio ){
+		av_freep( &p_io->p_avio->buffer );
+		avio_context_free( &p_io->p_avio );
+	}
+#ifdef WIN32
+	if( p_io->p_map )
+		UnmapViewOfFile( (LPCVOID)p_io->p_map );
+	if( p_io->mapping )
+		CloseHandle( p_io->mapping );
+	if( INVALID_HANDLE_VALUE != p_io->file )
+		CloseHandle( p_io->file );
+	if( p_io->prefix_file && INVALID_HANDLE_VALUE != p_io->prefix_file )
+		CloseHandle( p_io->prefix_file );
+#else
+	if( p_io->p_prefetch )
+		prefetch_free( (prefetcher_t *)p_io->p_prefetch );
+	if( p_io->p_map )
+		munmap( (void *)p_io->p_map, (size_t)p_io->map_size );
+	if( p_io->fd >= 0 )
+		close( p_io->fd );
+	if( p_io->prefix_fd >= 0 )
+		close( p_io->prefix_fd );
+#endif
+#ifdef __linux__
+	if( p_io->pb_follow_stop && p_io->notify_fd >= 0 )
+		close( p_io->notify_fd );
+#endif
+	voo_mutex_destroy( &p_io->lock );
+	free( p_io );
+}
+
+// NULL for anything but regular local files and streams, which libavformat
+// opens itself. A file that cannot be mapped is read instead.
+static file_io_t *io_open_file( const char *filename, const reader_settings_t *p_settings ){
+	file_io_t *p_io;
+	uint8_t *p_buf;
+#ifdef WIN32
+	struct _stat64 st;
+	HANDLE source = stream_source( filename );
+	if( INVALID_HANDLE_VALUE != source ){
+		if( !(p_io = (file_io_t *)calloc( 1, sizeof(file_io_t) )) ){
+			CloseHandle( source );
+			return NULL;
+		}
+		p_io->file = source;
+		p_io->mapping = NULL;
+		voo_mutex_init( &p_io->lock );
+		goto stream;
+	}
+	if( ( IO_FFMPEG == p_settings->io && !p_settings->init_segment ) || strstr( filename, "://" ) || _stat64( filename, &st ) || !( st.st_mode & _S_IFREG ) )
+		return NULL;
+#else
+	struct stat st;
+	int source = stream_source( filename );
+	if( source >= 0 ){
+		if( !(p_io = (file_io_t *)calloc( 1, sizeof(file_io_t) )) ){
+			close( source );
+			return NULL;
+		}
+		p_io->fd = source;
+		p_io->prefix_fd = -1;
+		voo_mutex_init( &p_io->lock );
+		goto stream;
+	}
+	if( ( IO_FFMPEG == p_settings->io && !p_settings->init_segment ) || strstr( filename, "://" ) || stat( filename, &st ) || !S_ISREG( st.st_mode ) )
+		return NULL;
+#endif
+	if( !(p_io = (file_io_t *)calloc( 1, sizeof(file_io_t) )) )
+		return NULL;
+	voo_mutex_init( &p_io->lock );
+	p_io->readahead = p_settings->io_readahead;
+	p_io->backend = IO_READ;
+
+#ifdef WIN32
+	p_io->file = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if( INVALID_HANDLE_VALUE == p_io->file )
+		goto fail;
+	if( p_settings->init_segment ){
+		LARGE_INTEGER size;
+		p_io->prefix_file = CreateFileA( p_settings->init_segment, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL );
+		if( INVALID_HANDLE_VALUE == p_io->prefix_file || !GetFileSizeEx( p_io->prefix_file, &size ) )
+			goto fail;
+		p_io->prefix_size = size.QuadPart;
+	}
+	if( IO_MMAP == p_settings->io && !p_io->prefix_size && st.st_size > 0 && (p_io->mapping = CreateFileMappingA( p_io->file, NULL, PAGE_READONLY, 0, 0, NULL )) ){
+		if( (p_io->p_map = (const uint8_t *)MapViewOfFile( p_io->mapping, FILE_MAP_READ, 0, 0, 0 )) ){
+			p_io->map_size = st.st_size;
+			p_io->backend = IO_MMAP;
+		}
+	}
+#else
+	p_io->prefix_fd = -1;
+	if( 0 > (p_io->fd = open( filename, O_RDONLY )) )
+		goto fail;
+	if( p_settings->init_segment ){
+		struct stat init_st;
+		if( 0 > (p_io->prefix_fd = open( p_settings->init_segment, O_RDONLY )) || fstat( p_io->prefix_fd, &init_st ) )
+			goto fail;
+		p_io->prefix_size = init_st.st_size;
+	}
+	if( IO_MMAP == p_settings->io && !p_io->prefix_size && st.st_size > 0 && (uint64_t)st.st_size <= SIZE_MAX ){
+		void *p_map = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, p_io->fd, 0 );
+		if( MAP_FAILED != p_map ){
+			p_io->p_map = (const uint8_t *)p_map;
+			p_io->map_size = st.st_size;
+			p_io->backend = IO_MMAP;
+		}
+	}
+	#if !defined( __APPLE__ )
+	if( !p_io->p_map )
+		posix_fadvise( p_io->fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+	#endif
+#endif
+
+	if( !(p_buf = (uint8_t *)av_malloc( (size_t)p_settings->io_buffer )) )
+		goto fail;
+	if( !(p_io->p_avio = avio_alloc_context( p_buf, (int)p_settings->io_buffer, 0, p_io, io_read, NULL, io_seek )) ){
+		av_free( p_buf );
+		goto fail;
+	}
+	return p_io;
+
+stream:
+	if( stream_open( p_io, p_settings ) )
+		return p_io;
+fail:
+	io_close_file( p_io );
+	return NULL;
+}
+
+// our file input behind a demuxer, if any
+static file_io_t *io_of( AVFormatContext *p_ctx ){
+	if( !p_ctx || !( p_ctx->flags & AVFMT_FLAG_CUSTOM_IO ) || !p_ctx->pb )
+		return NULL;
+	return (file_io_t *)p_ctx->pb->opaque;
+}
+
+// avformat_open_input( ... ) on our own file input where it applies; the
+// demuxer's messages go to the console of p_owner, see log_callback( ... )
+static int32_t io_open_input( AVFormatContext **pp_ctx, const char *filename, const reader_settings_t *p_settings, void *p_owner ){
+	file_io_t *p_io = io_open_file( filename, p_settings );
+	int32_t i_ret;
+	if( !*pp_ctx && !(*pp_ctx = avformat_alloc_context()) ){
+		if( p_io )
+			io_close_file( p_io );
+		return AVERROR( ENOMEM );
+	}
+	(*pp_ctx)->opaque = p_owner;
+	if( p_io ){
+		(*pp_ctx)->pb = p_io->p_avio;
+		(*pp_ctx)->flags |= AVFMT_FLAG_CUSTOM_IO;
+	}
+	// enough to read the headers; every demuxer of a file is bounded alike,
+	// so they all find the same streams
+	if( p_settings->fast_open ){
+		(*pp_ctx)->probesize = p_settings->probe_size;
+		(*pp_ctx)->format_probesize = (int)FFMIN( p_settings->probe_size, 1 << 20 );
+		(*pp_ctx)->max_analyze_duration = p_settings->analyze_ms * (int64_t)1000;
+	}
+	// on failure the context is freed, but a custom AVIOContext is not
+	if( 0 > (i_ret = avformat_open_input( pp_ctx, filename, NULL, NULL )) && p_io )
+		io_close_file( p_io );
+	return i_ret;
+}
+
+static void io_close_input( AVFormatContext **pp_ctx ){
+	file_io_t *p_io = io_of( *pp_ctx );
+	avformat_close_input( pp_ctx );
+	if( p_io )
+		io_close_file( p_io );
+}
+
+// Makes the demuxer wait at the end of a file being written instead of ending
+// there, see io_read( ... ). inotify tells when it changed, elsewhere the file
+// is checked every "ms".
+static vooBOOL io_follow( AVFormatContext *p_ctx, const char *filename, const volatile vooBOOL *pb_stop,
+	void (*caught_up)( void * ), void *p_arg, int32_t ms ){
+	file_io_t *p_io = io_of( p_ctx );
+	if( !p_io || IO_READ != p_io->backend )
+		return FALSE;
+#ifdef __linux__
+	if( 0 <= (p_io->notify_fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC ))
+		&& 0 > inotify_add_watch( p_io->notify_fd, filename, IN_MODIFY | IN_CLOSE_WRITE ) ){
+		close( p_io->notify_fd );
+		p_io->notify_fd = -1;
+	}
+#endif
+	p_io->follow_ms = ms;
+	p_io->caught_up = caught_up;
+	p_io->p_caught_up_arg = p_arg;
+	p_io->pb_follow_stop = pb_stop;
+	return TRUE;
+}
+
+
+// Bounded ring of decoded pictures, filled by a producer thread that demuxes
+// and decodes ahead of vooya's requests.
+typedef struct
+{
+	AVFrame **frames;
+	int32_t depth;
+	int32_t head;
+	int32_t count;
+	int32_t status;     // 0 while running, AVERROR_EOF or an error once the producer stopped
+	vooBOOL b_running;
+	vooBOOL b_stop;
+	uint64_t underruns; // in_load found the ring empty
+	voo_mutex_t lock;
+	voo_cond_t cond;
+	voo_thread_t thread;
+} decode_ahead_t;
+
+
+// Compact record of one video packet, in decode order.
+typedef struct
+{
+	int64_t pts;
+	int64_t dts;
+	int64_t pos;
+	int32_t size;
+	int32_t flags;   // AV_PKT_FLAG_*
+} index_entry_t;
+
+// Packet index of the video stream. Built in the background after in_open( ... )
+// and immutable once b_complete is set, so lookups then need no locking.
+typedef struct
+{
+	index_entry_t *entries;
+	int32_t count;
+	int32_t capacity;
+
+	int32_t frames;         // displayable pictures
+	int32_t keyframes;
+	int32_t *display;       // display order -> entry
+	int64_t *display_pts;   // display order -> pts
+	int32_t *key_of;        // display order -> display index of the keyframe to decode from
+
+	vooBOOL b_complete;
+	vooBOOL b_from_cache;
+	volatile vooBOOL b_stop;
+	vooBOOL b_running;
+	voo_mutex_t lock;
+	voo_thread_t thread;
+} packet_index_t;
+
+// Follow mode: the index thread keeps demuxing a file that is still being
+// written, into an index of its own. Grown copies of it are handed over to
+// vooya's thread, which takes them over between requests; so while following,
+// only vooya's thread reads the reader's index and GOP threading and reverse
+// reconstruction, which read it from threads of their own, are off.
+typedef struct
+{
+	packet_index_t work;            // every packet so far, the index thread's
+	packet_index_t *p_pending;      // handed over, not yet taken over
+	int64_t pending_limit;          // the end of its last packet in the file
+	int32_t handed_count;           // work.count when last handed over
+	vooBOOL b_handed_all;           // ... and whether all of its pictures were
+	int32_t handed_frames;
+	int32_t last_count;
+	int64_t last_growth;            // av_gettime_relative( ) work.count last changed at
+	int64_t resumed_limit;          // the decoder was last restarted for this limit
+	uint64_t updates;
+	void (*seq_len_changed)( void *p_vooya_ctx, unsigned int new_len );
+	void *p_vooya_ctx;
+	voo_mutex_t lock;
+} follow_t;
+
+// a file unchanged this long is taken to be complete up to its last packet
+#define FOLLOW_SETTLE 2000000
+
+#define INDEX_MAGIC "VOO+IDX"
+#define INDEX_VERSION 2
+#define INDEX_SUFFIX ".vooidx"
+
+typedef struct
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t entry_size;
+	int64_t file_size;
+	int64_t file_mtime;
+	int32_t stream_index;
+	int32_t codec_id;
+	int64_t count;
+} index_file_header_t;
+
+
+// Bytes of pictures and packets a reader holds, against an optional ceiling.
+// Picture buffers, for the decoder as for the frame cache, are recycled
+// rather than freed: pictures of tens of MiB would otherwise be mapped and
+// unmapped by malloc for every frame. Demuxers allocate packets themselves,
+// so those are only counted while the reader queues them. Buffers may outlive
+// the reader, the last one returned frees the memory_t.
+typedef struct
+{
+	int64_t ceiling;          // VOOPLUS_MEMORY, 0 for none
+	int64_t pictures;         // picture buffers allocated, idle ones included
+	int64_t packets;          // demuxed packets queued for intra batches and GOPs
+	int64_t peak;             // of both together
+	size_t block_size;        // the largest picture asked for, every buffer has this size
+	uint8_t *idle;            // buffers to hand out again, linked through their headers
+	int32_t n_idle;
+	int32_t refs;             // buffers out, plus one until the reader closes
+	vooBOOL b_closed;
+	uint64_t allocs;
+	uint64_t reuses;
+	uint64_t refusals;        // buffers the ceiling did not allow
+	voo_mutex_t lock;
+} memory_t;
+
+// in front of every picture buffer: its size, and the link while it is idle
+#define MEMORY_HEADER 64
+
+
+// Decoded pictures in vooya's layout, keyed by frame index, least recently
+// used evicted first once the byte budget is exceeded.
+typedef struct cache_entry_s
+{
+	int64_t frame;
+	vooBOOL b_exact;                  // numbered by the complete packet index, see frame_to_pts( ... )
+	int64_t used;                     // when last put or hit, to find the oldest across caches
+	AVBufferRef *p_buf;
+	const char *p_data;               // the picture in vooya's layout, inside p_buf
+	struct cache_entry_s *prev;       // LRU list, most recently used first
+	struct cache_entry_s *next;
+	struct cache_entry_s *hash_next;
+} cache_entry_t;
+
+#define CACHE_BUCKETS 1024
+
+// What makes pictures of two readers interchangeable: the same file, unchanged,
+// decoded into the same layout.
+typedef struct
+{
+	uint64_t device;
+	uint64_t inode;
+	int64_t size;
+	int64_t mtime;
+	int32_t width;
+	int32_t height;
+	int32_t color_space;
+	int32_t arrangement;
+	int32_t channel_order;
+	int32_t bits_per_channel;
+	int32_t b_signed;
+	uint32_t frame_size;
+} cache_key_t;
+
+// One per file and layout open in the process, shared by the readers that
+// opened it; see g_caches.
+typedef struct frame_cache_s
+{
+	cache_entry_t *buckets[ CACHE_BUCKETS ];
+	cache_entry_t *mru;
+	cache_entry_t *lru;
+	int32_t count;
+	size_t frame_size;
+	int64_t budget;
+	uint64_t hits;
+	uint64_t misses;
+	voo_mutex_t lock;
+
+	cache_key_t key;
+	vooBOOL b_shared;                 // found by key, else private to one reader
+	int32_t refs;                     // readers using it, under g_caches.lock
+	struct frame_cache_s *p_next;     // see g_caches
+} frame_cache_t;
+
+
+// Where the time of loading pictures goes. Each stage keeps a histogram of
+// its latencies with four buckets per octave of microseconds, updated with
+// atomic increments from whichever thread does the work: vooya's, the
+// decode-ahead thread or the worker pool.
+typedef enum
+{
+	STAGE_LOAD,         // in_load( ... ) as vooya sees it, cache hits included
+	STAGE_DEMUX,        // av_read_frame( ... ) of the packets played
+	STAGE_SEND,         // avcodec_send_packet( ... )
+	STAGE_RECEIVE,      // avcodec_receive_frame( ... ) that returned a picture
+	STAGE_TRANSFER,     // a picture into vooya's layout
+	STAGE_SEEK,         // reader_seek( ... )
+	STAGE_COUNT
+} stage_t;
+
+// latencies up to 2^31 microseconds, the last bucket takes the rest
+#define STATS_BUCKETS 120
+
+typedef struct
+{
+	volatile int64_t buckets[ STATS_BUCKETS ];
+	volatile int64_t bytes;            // demuxed, for STAGE_DEMUX
+} stage_stats_t;
+
+typedef struct
+{
+	stage_stats_t stages[ STAGE_COUNT ];
+	// rates over the last full second, measured on vooya's thread
+	int64_t window_start;
+	int64_t window_frames;
+	int64_t window_bytes;
+	volatile int64_t fps_x100;
+	volatile int64_t bytes_per_s;
+	int64_t last_summary;
+} stats_t;
+
+
+// Intra-only streams (ProRes, MJPEG, DNxHD, ...): every picture decodes on
+// its own, so batches of packets are spread over single-threaded decoder
+// contexts on the worker pool and handed out in stream order.
+typedef struct
+{
+	AVCodecContext **ctxs;  // ctxs[ 0 ] is the reader's codec_ctx
+	AVPacket *pkts;
+	AVFrame **frames;
+	int32_t *results;
+	int32_t n_ctx;          // planned by setup_threading( ... ), 0 or 1 if unused
+	int32_t count;          // pictures in the current batch
+	int32_t pos;            // next one to hand out
+	int32_t status;         // demuxer state once the batch is used up
+	uint64_t batches;
+	stats_t *p_stats;       // the reader's, for the pool threads
+} intra_decode_t;
+
+
+// GOP-parallel decoding of long-GOP streams: once the packet index is
+// complete, every GOP is decoded from its keyframe on a decoder context of
+// its own, and the pictures are handed out GOP by GOP in display order.
+typedef struct
+{
+	int32_t first, end;     // display indices [first, end) this GOP delivers
+	int32_t next;           // lowest display index it may still deliver
+	AVPacket *pkts;         // decode order, up to the last packet shown in [first, end)
+	int32_t n_pkts;
+	AVFrame **frames;       // ring of decoded pictures waiting to be handed out
+	int32_t head, count;
+	int32_t status;         // 0 while decoding, then AVERROR_EOF
+	vooBOOL b_taken;        // a worker is on it
+} gop_job_t;
+
+typedef struct
+{
+	AVCodecContext **ctxs;
+	int32_t n_ctx;          // planned by setup_threading( ... ), one worker thread each
+	voo_thread_t *threads;
+	int32_t n_threads;
+	gop_job_t *jobs;        // ring of n_ctx GOPs in flight, oldest first
+	int32_t job_head, n_jobs;
+	int32_t depth;          // pictures buffered per GOP
+	int32_t next_key;       // display index of the keyframe starting the next GOP, -1 past the end
+	int64_t next_out;       // display index of the picture handed out next
+
+	AVPacket *pkt_buf;      // demuxed packets of entries [pkt_first, pkt_first + pkt_count)
+	int32_t pkt_first, pkt_count, pkt_capacity;
+	int32_t read_pos;       // entry expected from the demuxer next
+
+	vooBOOL b_active;       // decode_next( ... ) goes through the GOP workers
+	vooBOOL b_broken;       // the demuxer disagreed with the index, decode serially
+	volatile vooBOOL b_cancel;  // also polled by workers between packets
+	volatile vooBOOL b_stop;
+	uint64_t gops;
+	voo_mutex_t lock;
+	voo_cond_t cond;
+} gop_decode_t;
+
+
+// Reverse playback: a private demuxer and decoder reconstruct whole ranges of
+// pictures into the frame cache, so stepping backwards costs one decode from
+// the keyframe per range instead of one per picture. While vooya plays a
+// range, the one before it is prefetched.
+typedef struct
+{
+	AVFormatContext *format_ctx;  // opened on the first backward step
+	AVCodecContext *codec_ctx;
+	int64_t last_request;         // previous frame asked for by in_load( ... ), -1 if none
+	int32_t backward;             // backward steps in a row
+	int64_t first, last;          // range posted to the thread, last < 0 once taken
+	int64_t prefetched;           // last frame of the latest prefetch, so it is posted once
+	volatile uint32_t gen;        // ranges posted; a newer one preempts the running one
+	uint32_t done_gen;            // ranges finished
+	vooBOOL b_running;
+	vooBOOL b_failed;
+	volatile vooBOOL b_stop;
+	uint64_t ranges;
+	voo_mutex_t lock;
+	voo_cond_t cond;
+	voo_thread_t thread;
+} reverse_t;
+
+// backward steps up to this many frames count as reverse playback
+#define REVERSE_MAX_STEP 8
+
+// Scrubbing: while vooya jumps around faster than the scrub interval (the user
+// drags the timeline), only the keyframe before each position is decoded, on a
+// private keyframe-only decoder and at reduced resolution where the codec can.
+// Once the playhead has rested for an interval, vooya is asked to reload, and
+// the picture is then decoded exactly.
+typedef struct
+{
+	AVFormatContext *format_ctx;  // opened on the first fast jump
+	AVCodecContext *codec_ctx;
+	int32_t lowres;               // what the decoder accepted
+	int64_t last_frame;           // previous request, -1 if none
+	int64_t last_time;            // of the previous request, av_gettime_relative( ) microseconds
+	int64_t shown;                // frame shown in scrub quality, -1 once reloaded
+	vooBOOL b_running;
+	vooBOOL b_failed;
+	vooBOOL b_stop;
+	uint64_t pictures;
+	voo_mutex_t lock;
+	voo_cond_t cond;
+	voo_thread_t thread;
+} scrub_t;
+
+// Real-time playback: a clock started at the first of a run of consecutive
+// requests says when each following frame is due. While vooya asks for frames
+// later than that and the decoder is the reason, non-reference pictures (and
+// further behind, all B-pictures) are discarded; requests they leave without a
+// picture of their own are reported as skipped.
+#define REALTIME_SENT 32
+
+typedef struct
+{
+	int64_t base_frame;        // due at base_time, av_gettime_relative( ) microseconds
+	int64_t base_time;
+	int64_t last_frame;        // previous request, -1 if none
+	int64_t period;            // of a frame, microseconds
+	int64_t load_time;         // average time in_load( ... ) spends decoding
+	volatile int64_t discard;  // enum AVDiscard, applied by the thread that decodes
+	// that thread's: timestamps of packets it sent while discarding and has
+	// not seen a picture of yet, see realtime_received( ... )
+	int64_t sent_pts[ REALTIME_SENT ];
+	int32_t n_sent;
+	uint64_t dropped;
+	uint64_t restarts;         // clock restarted because playback stalled
+} realtime_t;
+
+// further behind than this is a pause, not something to catch up with
+#define REALTIME_MAX_LAG 1000000
+
+
+// Decoder output straight into buffers laid out the way vooya expects.
+typedef struct
+{
+	vooBOOL b_enabled;
+	enum AVPixelFormat pix_fmt;  // the decoder format matching vooya's layout, or AV_PIX_FMT_NONE
+	uint64_t frames;             // pictures allocated from the reader's memory_t
+	uint64_t fallbacks;          // pictures left to libavcodec's allocator
+	voo_mutex_t lock;
+} direct_alloc_t;
+
+#define DIRECT_PADDING 64
+
+
+// How long opening took, stage by stage, in microseconds. Opening fast takes
+// what the container headers say; the stream analysis, which can read for
+// seconds in large MXF files, then runs on a thread of its own, for what the
+// headers left open. vooya's thread adopts its findings, see probe_adopt( ... ).
+typedef struct
+{
+	int64_t header;            // avformat_open_input( ... )
+	int64_t stream_info;       // avformat_find_stream_info( ... ) on vooya's thread, if it had to
+	int64_t decoder;           // avcodec_open2( ... )
+	int64_t format;            // setup_pixel_format( ... ), decodes a picture if the headers lack the format
+	int64_t total;             // all of opening
+	int64_t analysis;          // on the thread
+	vooBOOL b_analyzed;        // on vooya's thread while opening
+	vooBOOL b_rate_guessed;    // the headers have no frame rate
+	AVRational frame_rate;     // found by the thread
+	int64_t bit_rate;
+	vooBOOL b_done;            // the thread finished
+	vooBOOL b_adopted;
+	volatile vooBOOL b_stop;
+	vooBOOL b_running;
+	voo_mutex_t lock;
+	voo_thread_t thread;
+} probe_t;
+
+typedef struct ffmpeg_reader_s
+{
+	voo_sequence_t properties;
+	reader_settings_t settings;
+
+	AVPacket avpkt;
+	AVFormatContext *format_ctx;
+	AVCodecContext *codec_ctx;
+	AVStream *stream;
+	AVFrame *picture;
+	AVCodec *codec;
+
+	AVRational frame_rate;
+	int64_t start_pts;
+	int64_t cur_frame;   // index of the picture held in "picture", -1 if none
+	int64_t cover_from;  // "picture" also answers requests from here up to cur_frame
+	int64_t next_frame;  // lowest index the decoder can deliver without seeking
+	vooBOOL b_eof;
+#define ERRBUFF_LEN 2048
+	char last_err[ERRBUFF_LEN];
+	
+	void *p_msg_cargo;
+	void (*message)(void *,const char*);
+	void *p_reload_cargo;
+	int (*trigger_reload)( void * );
+
+	const pix_fmt_map_t *p_fmt;  // NULL for v210 packets passed through
+	voo_layout_t layout;         // of a picture in vooya's buffer
+	vooBOOL b_raw_v210;
+	vooBOOL b_scalable;          // pictures of other sizes can be scaled to vooya's
+	int32_t proxy;               // vooya's pictures are the stream's reduced by 2^proxy
+
+	char *filename;
+	vooBOOL b_stream;            // stdin or a pipe: forward only, nothing opens it a second time
+	vooBOOL b_prefetch_checked;  // whether packets are big enough for prefetching was decided
+	vooBOOL b_index_adopted;     // vooya's thread has seen the index complete, see index_adopt( ... )
+	vooBOOL b_intra_only;
+	intra_decode_t intra;
+	gop_decode_t gop;
+	reverse_t reverse;
+	scrub_t scrub;
+	realtime_t realtime;
+	decode_ahead_t ahead;
+	packet_index_t index;
+	follow_t follow;
+	frame_cache_t *p_cache;
+	memory_t *p_mem;
+	direct_alloc_t direct;
+	probe_t probe;
+	stats_t stats;
+	struct segments_s *p_segments;  // a sequence of segment files, each with a reader of its own
+	vooBOOL b_segment;              // ... or one of those
+	int32_t thread_share;           // decoder threads if VOOPLUS_THREADS leaves it to us, see readers_add( ... )
+	struct ffmpeg_reader_s *p_next_open;  // see g_readers
+	char last_log[ 256 ];           // repeats of a libav* message are counted, not shown
+	uint32_t log_repeats;
+
+} ffmpeg_reader_t;
+
+
+static memory_t *memory_create( int64_t ceiling ){
+	memory_t *p_mem = (memory_t *)calloc( 1, sizeof(memory_t) );
+	if( !p_mem )
+		return NULL;
+	p_mem->ceiling = ceiling;
+	p_mem->refs = 1;
+	voo_mutex_init( &p_mem->lock );
+	return p_mem;
+}
+
+// under the lock
+static void memory_count( memory_t *p_mem, int64_t *p_bytes, int64_t delta ){
+	*p_bytes += delta;
+	p_mem->peak = FFMAX( p_mem->peak, p_mem->pictures + p_mem->packets );
+}
+
+static uint8_t *memory_pop_idle( memory_t *p_mem ){
+	uint8_t *p_block = p_mem->idle;
+	if( p_block ){
+		p_mem->idle = *(uint8_t **)( p_block + sizeof(size_t) );
+		p_mem->n_idle--;
+	}
+	return p_block;
+}
+
+// under the lock
+static void memory_drop_idle( memory_t *p_mem, int32_t keep ){
+	uint8_t *p_block;
+	while( p_mem->n_idle > keep && (p_block = memory_pop_idle( p_mem )) ){
+		memory_count( p_mem, &p_mem->pictures, -(int64_t)( MEMORY_HEADER + *(size_t *)p_block ) );
+		av_free( p_block );
+	}
+}
+
+// the AVBuffer free callback: back to the idle list, unless the buffer is of
+// an outgrown size or the reader is gone
+static void memory_release( void *p_opaque, uint8_t *p_data ){
+	memory_t *p_mem = (memory_t *)p_opaque;
+	uint8_t *p_block = p_data - MEMORY_HEADER;
+	vooBOOL b_last;
+
+	voo_mutex_lock( &p_mem->lock );
+	if( !p_mem->b_closed && *(size_t *)p_block == p_mem->block_size ){
+		*(uint8_t **)( p_block + sizeof(size_t) ) = p_mem->idle;
+		p_mem->idle = p_block;
+		p_mem->n_idle++;
+	} else {
+		memory_count( p_mem, &p_mem->pictures, -(int64_t)( MEMORY_HEADER + *(size_t *)p_block ) );
+		av_free( p_block );
+	}
+	b_last = !--p_mem->refs;
+	voo_mutex_unlock( &p_mem->lock );
+	if( b_last ){
+		voo_mutex_destroy( &p_mem->lock );
+		free( p_mem );
+	}
+}
+
+// A picture buffer of at least "size" bytes, or NULL at the ceiling.
+static AVBufferRef *memory_buffer( memory_t *p_mem, size_t size ){
+	AVBufferRef *p_buf;
+	uint8_t *p_block;
+	size_t block_size;
+
+	voo_mutex_lock( &p_mem->lock );
+	// decoder buffers are a little larger than vooya's pictures; all are made to fit either
+	if( size > p_mem->block_size ){
+		memory_drop_idle( p_mem, 0 );
+		p_mem->block_size = size;
+	}
+	block_size = p_mem->block_size;
+	if( (p_block = memory_pop_idle( p_mem )) )
+		p_mem->reuses++;
+	else if( p_mem->ceiling && p_mem->pictures + p_mem->packets + MEMORY_HEADER + (int64_t)block_size > p_mem->ceiling ){
+		p_mem->refusals++;
+		voo_mutex_unlock( &p_mem->lock );
+		return NULL;
+	} else {
+		memory_count( p_mem, &p_mem->pictures, MEMORY_HEADER + (int64_t)block_size );
+		p_mem->allocs++;
+	}
+	p_mem->refs++;
+	voo_mutex_unlock( &p_mem->lock );
+
+	if( !p_block ){
+		if( !(p_block = (uint8_t *)av_malloc( MEMORY_HEADER + block_size )) ){
+			// the reader holds a reference of its own, this is not the last
+			voo_mutex_lock( &p_mem->lock );
+			memory_count( p_mem, &p_mem->pictures, -(int64_t)( MEMORY_HEADER + block_size ) );
+			p_mem->refs--;
+			voo_mutex_unlock( &p_mem->lock );
+			return NULL;
+		}
+		*(size_t *)p_block = block_size;
+	}
+	if( !(p_buf = av_buffer_create( p_block + MEMORY_HEADER, (int)block_size, memory_release, p_mem, 0 )) )
+		memory_release( p_mem, p_block + MEMORY_HEADER );
+	return p_buf;
+}
+
+static void memory_packets( memory_t *p_mem, int64_t delta ){
+	if( !p_mem )
+		return;
+	voo_mutex_lock( &p_mem->lock );
+	memory_count( p_mem, &p_mem->packets, delta );
+	voo_mutex_unlock( &p_mem->lock );
+}
+
+// Frees idle buffers beyond what decoding needs again right away.
+static void memory_trim( memory_t *p_mem, int32_t keep ){
+	if( !p_mem )
+		return;
+	voo_mutex_lock( &p_mem->lock );
+	memory_drop_idle( p_mem, keep );
+	voo_mutex_unlock( &p_mem->lock );
+}
+
+// Buffers still out free themselves when returned, the last one the memory_t.
+static void memory_close( memory_t **pp_mem ){
+	memory_t *p_mem = *pp_mem;
+	vooBOOL b_last;
+	if( !p_mem )
+		return;
+	voo_mutex_lock( &p_mem->lock );
+	p_mem->b_closed = TRUE;
+	memory_drop_idle( p_mem, 0 );
+	b_last = !--p_mem->refs;
+	voo_mutex_unlock( &p_mem->lock );
+	if( b_last ){
+		voo_mutex_destroy( &p_mem->lock );
+		free( p_mem );
+	}
+	*pp_mem = NULL;
+}
+
+
+// Readers open in the process. Side-by-side and difference views open several
+// at once, each seeking and loading on threads of its own; what they share is
+// this list, the worker pool and libav*'s single log callback, which hands a
+// message to the console of the reader whose context it concerns.
+static struct
+{
+	voo_mutex_t lock;
+	ffmpeg_reader_t *head;   // linked through p_next_open
+	vooBOOL b_log;           // log_callback( ... ) is installed
+} g_readers;
+
+static voo_once_t g_readers_once = VOO_ONCE_INIT;
+
+// Demuxers and decoders of a reader carry it in their "opaque", which frame
+// threading copies into its worker contexts. Messages about contexts that are
+// not ours, or are not about a context at all, are dropped.
+static void log_callback( void *p_avcl, int level, const char *format, va_list args ){
+	const AVClass *p_class = p_avcl ? *(const AVClass **)p_avcl : NULL;
+	void (*p_message)( void *, const char * ) = NULL;
+	void *p_ctx = p_avcl, *p_owner = NULL, *p_cargo = NULL;
+	ffmpeg_reader_t *p;
+	char line[ 256 ], text[ 320 ];
+	int print_prefix = 1, depth;
+
+	if( level > AV_LOG_INFO )
+		return;
+	// a demuxer's or decoder's private context logs through its parent's
+	for( depth = 0; p_class && depth < 3; depth++ ){
+		if( p_class == avcodec_get_class() ){
+			p_owner = ((AVCodecContext *)p_ctx)->opaque;
+			break;
+		}
+		if( p_class == avformat_get_class() ){
+			p_owner = ((AVFormatContext *)p_ctx)->opaque;
+			break;
+		}
+		if( !p_class->parent_log_context_offset || !(p_ctx = *(void **)( (uint8_t *)p_ctx + p_class->parent_log_context_offset )) )
+			break;
+		p_class = *(const AVClass **)p_ctx;
+	}
+	if( !p_owner )
+		return;
+
+	av_log_format_line( p_avcl, level, format, args, line, sizeof(line), &print_prefix );
+	voo_mutex_lock( &g_readers.lock );
+	for( p = g_readers.head; p && p != p_owner; p = p->p_next_open );
+	if( p && level <= p->settings.log_level ){
+		if( !strcmp( line, p->last_log ) )
+			p->log_repeats++;
+		else {
+			text[ 0 ] = 0;
+			if( p->log_repeats )
+				sprintf( text, "Last message repeated %u times\n", p->log_repeats );
+			strcat( text, line );
+			strcpy( p->last_log, line );
+			p->log_repeats = 0;
+			p_message = p->message;
+			p_cargo = p->p_msg_cargo;
+		}
+	}
+	voo_mutex_unlock( &g_readers.lock );
+	if( p_message )
+		p_message( p_cargo, text );
+}
+
+static void readers_init( void ){
+	voo_mutex_init( &g_readers.lock );
+	av_log_set_callback( log_callback );
+	g_readers.b_log = TRUE;
+}
+
+// Registers p_reader and decides its share of the cores, which are divided
+// among the sequences open (the segments of one counting as one), so that a
+// few views side by side do not run a few times more decoder threads than
+// there are cores. Who opened first does not get more later, though.
+static void readers_add( ffmpeg_reader_t *p_reader ){
+	ffmpeg_reader_t *p;
+	int32_t n = !p_reader->b_segment;
+	voo_once( &g_readers_once, readers_init );
+	voo_mutex_lock( &g_readers.lock );
+	for( p = g_readers.head; p; p = p->p_next_open )
+		n += !p->b_segment;
+	p_reader->p_next_open = g_readers.head;
+	g_readers.head = p_reader;
+	voo_mutex_unlock( &g_readers.lock );
+	p_reader->thread_share = FFMIN( FFMAX( av_cpu_count() / FFMAX( n, 1 ), 1 ), MAX_DECODER_THREADS );
+}
+
+// before p_reader goes; not being registered is fine
+static void readers_remove( ffmpeg_reader_t *p_reader ){
+	ffmpeg_reader_t **pp;
+	voo_once( &g_readers_once, readers_init );
+	voo_mutex_lock( &g_readers.lock );
+	for( pp = &g_readers.head; *pp && *pp != p_reader; pp = &(*pp)->p_next_open );
+	if( *pp )
+		*pp = p_reader->p_next_open;
+	voo_mutex_unlock( &g_readers.lock );
+}
+
+
+// Segmented sequences: a numbered pattern or a playlist of files shown as one
+// sequence. The frame counts of the segments are surveyed in order, mostly in
+// the background; readers are opened for a few segments at a time, the next
+// one on a background thread before playback gets there.
+typedef struct
+{
+	char *filename;
+	char *init;                // HLS fMP4 init segment, or NULL
+	int64_t first;             // global index of its first frame, once surveyed
+	int32_t frames;
+	ffmpeg_reader_t *p_reader; // open, or NULL
+	vooBOOL b_failed;
+	char *err;                 // why it could not be opened
+	uint64_t last_used;
+} segment_t;
+
+typedef struct segments_s
+{
+	segment_t *items;
+	int32_t count;
+	int32_t surveyed;          // segments [0, surveyed) have known frame counts
+	int64_t total;             // their frames
+	int64_t told;              // ... as vooya knows it
+	vooBOOL b_nudged;          // vooya was asked to reload since
+	int32_t current;           // segment of the last request
+	int32_t want;              // to be opened in the background, -1 if none
+	int32_t opening;           // being opened in the background, -1 if none
+	uint64_t clock;            // for last_used
+	vooBOOL b_stop;
+	voo_app_info_t app_info;
+	void (*seq_len_changed)( void *p_vooya_ctx, unsigned int new_len );
+	void *p_vooya_ctx;
+	uint64_t switches;
+	uint64_t waited;           // switches that found the next segment still opening
+	uint64_t missed;           // ... or not opened at all
+	voo_mutex_t lock;
+	voo_cond_t cond;
+	voo_thread_t thread;
+	vooBOOL b_running;
+} segments_t;
+
+// readers open at once: the current segment, the next and the previous one
+#define SEGMENTS_OPEN 3
+// in_open( ... ) surveys segments for this long, the background thread the rest
+#define SEGMENT_SURVEY_TIME 500000
+
+
+// VOOPLUS_THREADS if set, else the reader's share of the cores.
+static int32_t decoder_threads( ffmpeg_reader_t *p_reader ){
+	if( THREAD_MODE_OFF == p_reader->settings.thread_mode )
+		return 1;
+	return 0 < p_reader->settings.thread_count ? p_reader->settings.thread_count : p_reader->thread_share;
+}
+
+// Must be called before avcodec_open2( ... ); what the decoder actually ends up
+// with is found in codec_ctx->active_thread_type and thread_count afterwards.
+static void setup_threading( ffmpeg_reader_t *p_reader ){
+	AVCodecContext *ctx = p_reader->codec_ctx;
+	const AVCodecDescriptor *p_desc = avcodec_descriptor_get( p_reader->codec->id );
+	int32_t caps = p_reader->codec->capabilities;
+	int32_t n = decoder_threads( p_reader );
+
+	p_reader->b_intra_only = p_desc && ( p_desc->props & AV_CODEC_PROP_INTRA_ONLY );
+	if( THREAD_MODE_OFF != p_reader->settings.thread_mode && THREAD_MODE_FRAME != p_reader->settings.thread_mode
+		&& THREAD_MODE_SLICE != p_reader->settings.thread_mode && p_reader->b_intra_only && n > 1 ){
+		// one thread per context, see intra_init( ... )
+		p_reader->intra.n_ctx = FFMIN( n, MAX_DECODER_THREADS );
+		ctx->thread_type = 0;
+		ctx->thread_count = 1;
+		return;
+	}
+
+	// the reader's own context keeps decoding until the GOP contexts take over
+	if( THREAD_MODE_GOP == p_reader->settings.thread_mode )
+		p_reader->gop.n_ctx = FFMIN( n, MAX_DECODER_THREADS );
+
+	switch( p_reader->settings.thread_mode ){
+	case THREAD_MODE_FRAME: ctx->thread_type = FF_THREAD_FRAME; break;
+	case THREAD_MODE_SLICE: ctx->thread_type = FF_THREAD_SLICE; break;
+	case THREAD_MODE_OFF:   ctx->thread_type = 0; n = 1; break;
+	default:
+		// libavcodec prefers frame threading when both bits are set
+		ctx->thread_type = 0;
+		if( caps & AV_CODEC_CAP_FRAME_THREADS ) ctx->thread_type |= FF_THREAD_FRAME;
+		if( caps & AV_CODEC_CAP_SLICE_THREADS ) ctx->thread_type |= FF_THREAD_SLICE;
+		if( !ctx->thread_type ) n = 1;
+		break;
+	}
+	ctx->thread_count = n;
+}
+
+
+static int32_t stats_bucket( int64_t us ){
+	int32_t msb;
+	if( us < 4 )
+		return (int32_t)FFMAX( us, 0 );
+	us = FFMIN( us, INT32_MAX );
+	msb = av_log2( (unsigned)us );
+	return FFMIN( 4 * msb - 4 + (int32_t)( ( us >> ( msb - 2 ) ) & 3 ), STATS_BUCKETS - 1 );
+}
+
+// the middle of bucket b in microseconds
+static double stats_bucket_us( int32_t b ){
+	int32_t msb = b / 4 + 1;
+	if( b < 4 )
+		return b;
+	return (double)( ( 4 + b % 4 ) << ( msb - 2 ) ) + ( 1 << ( msb - 2 ) ) / 2.0;
+}
+
+// One latency of "stage", which began at "start".
+static void stats_add( stats_t *p_stats, stage_t stage, int64_t start, int64_t bytes ){
+	stage_stats_t *p_stage = &p_stats->stages[ stage ];
+	voo_atomic_add( &p_stage->buckets[ stats_bucket( av_gettime_relative() - start ) ], 1 );
+	if( bytes )
+		voo_atomic_add( &p_stage->bytes, bytes );
+}
+
+static int32_t timed_read_frame( stats_t *p_stats, AVFormatContext *p_ctx, AVPacket *p_pkt ){
+	int64_t start = av_gettime_relative();
+	int32_t i_ret = av_read_frame( p_ctx, p_pkt );
+	stats_add( p_stats, STAGE_DEMUX, start, 0 <= i_ret ? p_pkt->size : 0 );
+	return i_ret;
+}
+
+static int32_t timed_send_packet( stats_t *p_stats, AVCodecContext *ctx, const AVPacket *p_pkt ){
+	int64_t start = av_gettime_relative();
+	int32_t i_ret = avcodec_send_packet( ctx, p_pkt );
+	stats_add( p_stats, STAGE_SEND, start, 0 );
+	return i_ret;
+}
+
+// Polls that find no picture yet are not counted.
+static int32_t timed_receive_frame( stats_t *p_stats, AVCodecContext *ctx, AVFrame *p_frame ){
+	int64_t start = av_gettime_relative();
+	int32_t i_ret = avcodec_receive_frame( ctx, p_frame );
+	if( 0 <= i_ret )
+		stats_add( p_stats, STAGE_RECEIVE, start, 0 );
+	return i_ret;
+}
+
+// "p50 0.42 ms, p99 3.10 ms" into p_text; returns how many latencies there are.
+static int64_t stats_format( stage_stats_t *p_stage, char *p_text ){
+	int64_t counts[ STATS_BUCKETS ], n = 0, seen = 0;
+	double p50 = -1, p99 = -1;
+	int32_t b;
+
+	for( b = 0; b < STATS_BUCKETS; b++ )
+		n += ( counts[ b ] = voo_atomic_get( &p_stage->buckets[ b ] ) );
+	for( b = 0; b < STATS_BUCKETS && p99 < 0; b++ ){
+		seen += counts[ b ];
+		if( p50 < 0 && 2 * seen >= n )
+			p50 = stats_bucket_us( b );
+		if( 100 * seen >= 99 * n )
+			p99 = stats_bucket_us( b );
+	}
+	sprintf( p_text, "p50 %1.2f ms, p99 %1.2f ms", p50 / 1e3, p99 / 1e3 );
+	return n;
+}
+
+static const char *stage_names[ STAGE_COUNT ] = { "load", "demux", "send", "receive", "copy", "seek" };
+
+// On vooya's thread after each load: the rates over the last second, and
+// every VOOPLUS_STATS seconds a summary on the console.
+static void stats_tick( ffmpeg_reader_t *p_reader ){
+	stats_t *p_stats = &p_reader->stats;
+	int64_t now = av_gettime_relative(), bytes;
+	char text[ 1024 ], stage[ 64 ];
+	int32_t i;
+
+	if( !p_stats->window_start )
+		p_stats->window_start = p_stats->last_summary = now;
+	p_stats->window_frames++;
+	if( now - p_stats->window_start >= 1000000 ){
+		bytes = voo_atomic_get( &p_stats->stages[ STAGE_DEMUX ].bytes );
+		voo_atomic_set( &p_stats->fps_x100, p_stats->window_frames * 100000000 / ( now - p_stats->window_start ) );
+		voo_atomic_set( &p_stats->bytes_per_s, ( bytes - p_stats->window_bytes ) * 1000000 / ( now - p_stats->window_start ) );
+		p_stats->window_start = now;
+		p_stats->window_frames = 0;
+		p_stats->window_bytes = bytes;
+	}
+
+	if( !p_reader->settings.stats_s || now - p_stats->last_summary < p_reader->settings.stats_s * (int64_t)1000000 )
+		return;
+	p_stats->last_summary = now;
+	sprintf( text, "%s: %1.1f fps, %1.1f MB/s", p_reader->filename, voo_atomic_get( &p_stats->fps_x100 ) / 100.0,
+		voo_atomic_get( &p_stats->bytes_per_s ) / (double)( 1 << 20 ) );
+	for( i = 0; i < STAGE_COUNT; i++ )
+		if( stats_format( &p_stats->stages[ i ], stage ) && strlen( text ) + strlen( stage ) + 16 < sizeof(text) )
+			sprintf( text + strlen( text ), "; %s %s", stage_names[ i ], stage );
+	strcat( text, "\n" );
+	p_reader->message( p_reader->p_msg_cargo, text );
+}
+
+
+// v210 without row padding is what vooya reads, so its packets are wrapped
+// as pictures rather than decoded.
+static int32_t raw_next( ffmpeg_reader_t *p_reader, AVFrame *p_frame ){
+	AVPacket *p_pkt = &p_reader->avpkt;
+	int32_t i_ret;
+
+	for( ;; ){
+		if( (i_ret = timed_read_frame( &p_reader->stats, p_reader->format_ctx, p_pkt )) < 0 )
+			return i_ret;
+		if( p_pkt->stream_index == p_reader->stream->index && (size_t)p_pkt->size >= p_reader->layout.size )
+			break;
+		av_packet_unref( p_pkt ); // other streams, truncated pictures
+	}
+	if( p_pkt->buf ){
+		p_frame->buf[ 0 ] = av_buffer_ref( p_pkt->buf );
+		p_frame->data[ 0 ] = p_pkt->data;
+	} else if( (p_frame->buf[ 0 ] = av_buffer_alloc( p_pkt->size )) ){
+		memcpy( p_frame->buf[ 0 ]->data, p_pkt->data, p_pkt->size );
+		p_frame->data[ 0 ] = p_frame->buf[ 0 ]->data;
+	}
+	if( !p_frame->buf[ 0 ] ){
+		av_packet_unref( p_pkt );
+		return AVERROR( ENOMEM );
+	}
+	p_frame->extended_data = p_frame->data;
+	p_frame->linesize[ 0 ] = p_reader->layout.row_bytes[ 0 ];
+	p_frame->width = p_reader->properties.width;
+	p_frame->height = p_reader->properties.height;
+	p_frame->format = AV_PIX_FMT_NONE;
+	p_frame->key_frame = 1;
+	p_frame->pts = p_frame->best_effort_timestamp = AV_NOPTS_VALUE != p_pkt->pts ? p_pkt->pts : p_pkt->dts;
+	av_packet_unref( p_pkt );
+	return 0;
+}
+
+static void intra_decode_item( void *p_ctx, int32_t i ){
+	intra_decode_t *p_intra = (intra_decode_t *)p_ctx;
+	AVCodecContext *ctx = p_intra->ctxs[ i ];
+	int32_t i_ret = timed_send_packet( p_intra->p_stats, ctx, &p_intra->pkts[ i ] );
+	if( 0 <= i_ret )
+		i_ret = timed_receive_frame( p_intra->p_stats, ctx, p_intra->frames[ i ] );
+	if( i_ret < 0 )
+		avcodec_flush_buffers( ctx ); // nothing may linger into the next batch
+	p_intra->results[ i ] = i_ret;
+	av_packet_unref( &p_intra->pkts[ i ] );
+}
+
+static int32_t intra_next( ffmpeg_reader_t *p_reader, AVFrame *p_frame ){
+	intra_decode_t *p_intra = &p_reader->intra;
+	int64_t batch;
+	int32_t i, i_ret;
+
+	for( ;; ){
+		while( p_intra->pos < p_intra->count ){
+			i = p_intra->pos++;
+			if( 0 <= p_intra->results[ i ] ){
+				av_frame_move_ref( p_frame, p_intra->frames[ i ] );
+				return 0;
+			}
+			av_strerror( p_intra->results[ i ], p_reader->last_err, ERRBUFF_LEN ); // skip broken packets
+		}
+		if( p_intra->status < 0 )
+			return p_intra->status;
+
+		// demux the next batch, then decode it on the pool
+		p_intra->count = p_intra->pos = 0;
+		batch = 0;
+		while( p_intra->count < p_intra->n_ctx ){
+			if( (i_ret = timed_read_frame( &p_reader->stats, p_reader->format_ctx, &p_reader->avpkt )) < 0 ){
+				p_intra->status = i_ret;
+				break;
+			}
+			if( p_reader->avpkt.stream_index != p_reader->stream->index ){
+				av_packet_unref( &p_reader->avpkt );
+				continue;
+			}
+			batch += p_reader->avpkt.size;
+			av_packet_move_ref( &p_intra->pkts[ p_intra->count++ ], &p_reader->avpkt );
+		}
+		if( p_intra->count ){
+			memory_packets( p_reader->p_mem, batch );
+			pool_run( intra_decode_item, p_intra, p_intra->count );
+			memory_packets( p_reader->p_mem, -batch );
+			p_intra->batches++;
+		}
+	}
+}
+
+// drops the rest of the current batch after a seek
+static void intra_reset( ffmpeg_reader_t *p_reader ){
+	intra_decode_t *p_intra = &p_reader->intra;
+	for( ; p_intra->pos < p_intra->count; p_intra->pos++ )
+		av_frame_unref( p_intra->frames[ p_intra->pos ] );
+	p_intra->count = p_intra->pos = 0;
+	p_intra->status = 0;
+}
+
+// defined with the seek engine, which it depends on
+static int32_t gop_next( ffmpeg_reader_t *p_reader, AVFrame *p_frame );
+
+// On the thread that decodes: remembers a packet the decoder was allowed to
+// discard, and marks the picture after one that did not come out with
+// p_frame->opaque = p_rt, for realtime_dropped( ... ). Decoders may reorder,
+// so this goes by timestamps rather than by the order pictures come out in.
+static void realtime_sent( realtime_t *p_rt, const AVPacket *p_pkt, int64_t discard ){
+	if( AVDISCARD_DEFAULT == discard || AV_NOPTS_VALUE == p_pkt->pts )
+		return;
+	if( p_rt->n_sent == REALTIME_SENT )
+		memmove( p_rt->sent_pts, p_rt->sent_pts + 1, --p_rt->n_sent * sizeof(int64_t) );
+	p_rt->sent_pts[ p_rt->n_sent++ ] = p_pkt->pts;
+}
+
+static void realtime_received( realtime_t *p_rt, AVFrame *p_frame ){
+	int64_t ts = p_frame->best_effort_timestamp;
+	int32_t i, n = 0;
+	vooBOOL b_gap = FALSE;
+
+	if( AV_NOPTS_VALUE == ts )
+		ts = p_frame->pts;
+	p_frame->opaque = NULL;
+	if( AV_NOPTS_VALUE == ts )
+		return;
+	for( i = 0; i < p_rt->n_sent; i++ ){
+		if( p_rt->sent_pts[ i ] > ts )
+			p_rt->sent_pts[ n++ ] = p_rt->sent_pts[ i ];
+		else if( p_rt->sent_pts[ i ] < ts )
+			b_gap = TRUE;
+	}
+	p_rt->n_sent = n;
+	if( b_gap )
+		p_frame->opaque = p_rt;
+}
+
+// Demuxes and decodes until the next picture of our stream is in p_frame.
+// Returns 0, AVERROR_EOF once the decoder has been drained, or another error.
+static int32_t decode_next( ffmpeg_reader_t *p_reader, AVFrame *p_frame ){
+	int64_t discard;
+	int32_t i_ret;
+	if( p_reader->b_raw_v210 )
+		return raw_next( p_reader, p_frame );
+	if( p_reader->intra.ctxs )
+		return intra_next( p_reader, p_frame );
+	if( p_reader->gop.b_active )
+		return gop_next( p_reader, p_frame );
+	for( ;; ){
+		i_ret = timed_receive_frame( &p_reader->stats, p_reader->codec_ctx, p_frame );
+		if( i_ret != AVERROR( EAGAIN ) ){
+			if( 0 == i_ret && p_reader->settings.realtime )
+				realtime_received( &p_reader->realtime, p_frame );
+			return i_ret;
+		}
+
+		if( (i_ret = timed_read_frame( &p_reader->stats, p_reader->format_ctx, &p_reader->avpkt )) < 0 ){
+			// end of input, collect what the decoder still holds back
+			avcodec_send_packet( p_reader->codec_ctx, NULL );
+			continue;
+		}
+		if( p_reader->avpkt.stream_index != p_reader->stream->index ){
+			av_packet_unref( &p_reader->avpkt );
+			continue;
+		}
+		// lowered by real-time playback while it is behind
+		discard = voo_atomic_get( &p_reader->realtime.discard );
+		p_reader->codec_ctx->skip_frame = (enum AVDiscard)discard;
+		realtime_sent( &p_reader->realtime, &p_reader->avpkt, discard );
+		i_ret = timed_send_packet( &p_reader->stats, p_reader->codec_ctx, &p_reader->avpkt );
+		av_packet_unref( &p_reader->avpkt );
+		if( i_ret < 0 && AVERROR_EOF != i_ret )
+			av_strerror( i_ret, p_reader->last_err, ERRBUFF_LEN ); // skip broken packets
+	}
+}
+
+// Can the decoder write fmt straight into vooya's layout? Formats needing a
+// repack or carrying an alpha plane cannot.
+static vooBOOL layout_matches( ffmpeg_reader_t *p_reader, enum AVPixelFormat fmt ){
+	return p_reader->p_fmt && !p_reader->p_fmt->repack && fmt == p_reader->p_fmt->pix_fmt
+		&& av_pix_fmt_count_planes( fmt ) == p_reader->layout.n_planes;
+}
+
+// True for pictures whose planes sit back to back in a single buffer, exactly
+// as in vooya's; they go over with one copy.
+static vooBOOL frame_in_vooya_layout( ffmpeg_reader_t *p_reader, const AVFrame *p_frame ){
+	const voo_layout_t *p_layout = &p_reader->layout;
+	const AVBufferRef *p_buf = p_frame->buf[ 0 ];
+	int32_t i;
+
+	if( !p_buf || p_frame->buf[ 1 ] )
+		return FALSE;
+	if( !p_reader->b_raw_v210 && ( p_frame->format != p_reader->p_fmt->pix_fmt || p_reader->p_fmt->repack ) )
+		return FALSE;
+	if( p_frame->data[ 0 ] < p_buf->data || p_frame->data[ 0 ] + p_layout->size > p_buf->data + p_buf->size )
+		return FALSE;
+	for( i = 0; i < p_layout->n_planes; i++ )
+		if( p_frame->linesize[ i ] != p_layout->row_bytes[ i ] || p_frame->data[ i ] != p_frame->data[ 0 ] + p_layout->offset[ i ] )
+			return FALSE;
+	return TRUE;
+}
+
+static AVBufferRef *picture_buffer( ffmpeg_reader_t *p_reader, size_t size );
+
+// get_buffer2 handing out tightly strided planes from our own pool. If the
+// decoder's alignment needs no extra rows, the planes are back to back,
+// exactly as in vooya's buffer. Anything else goes to libavcodec's allocator.
+static int get_direct_buffer( AVCodecContext *p_ctx, AVFrame *p_frame, int flags ){
+	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_ctx->opaque;
+	direct_alloc_t *p_direct = &p_reader->direct;
+	const voo_layout_t *p_layout = &p_reader->layout;
+	const AVPixFmtDescriptor *p_desc;
+	AVBufferRef *p_buf = NULL;
+	int w = p_frame->width, h = p_frame->height;
+	int align[ AV_NUM_DATA_POINTERS ], linesizes[ 4 ];
+	int32_t i, rows[ 4 ], offset[ 4 ], size = 0;
+	vooBOOL b_back_to_back = TRUE;
+
+	if( p_frame->format != p_direct->pix_fmt || w != p_reader->properties.width || h < p_reader->properties.height )
+		goto fallback;
+	avcodec_align_dimensions2( p_ctx, &w, &h, align );
+	// the decoder writes whole aligned rows, they must not spill into the next one
+	if( w != p_frame->width || 0 > av_image_fill_linesizes( linesizes, (enum AVPixelFormat)p_frame->format, w ) )
+		goto fallback;
+
+	p_desc = av_pix_fmt_desc_get( (enum AVPixelFormat)p_frame->format );
+	for( i = 0; i < p_layout->n_planes; i++ ){
+		if( linesizes[ i ] % align[ i ] )
+			goto fallback;
+		rows[ i ] = ( 1 == i || 2 == i ) ? AV_CEIL_RSHIFT( h, p_desc->log2_chroma_h ) : h;
+		if( rows[ i ] != p_layout->rows[ i ] )
+			b_back_to_back = FALSE;
+	}
+	for( i = 0; i < p_layout->n_planes; i++ ){
+		offset[ i ] = size;
+		size += linesizes[ i ] * rows[ i ];
+		if( !b_back_to_back )
+			size = FFALIGN( size + DIRECT_PADDING, DIRECT_PADDING );
+	}
+	size += DIRECT_PADDING;
+
+	if( !(p_buf = picture_buffer( p_reader, size )) )
+		goto fallback;
+	voo_mutex_lock( &p_direct->lock );
+	p_direct->frames++;
+	voo_mutex_unlock( &p_direct->lock );
+
+	p_frame->buf[ 0 ] = p_buf;
+	for( i = 0; i < p_layout->n_planes; i++ ){
+		p_frame->data[ i ] = p_buf->data + offset[ i ];
+		p_frame->linesize[ i ] = linesizes[ i ];
+	}
+	p_frame->extended_data = p_frame->data;
+	return 0;
+
+fallback:
+	voo_mutex_lock( &p_direct->lock );
+	p_direct->fallbacks++;
+	voo_mutex_unlock( &p_direct->lock );
+	return avcodec_default_get_buffer2( p_ctx, p_frame, flags );
+}
+
+static void direct_attach( ffmpeg_reader_t *p_reader, AVCodecContext *ctx ){
+	ctx->opaque = p_reader;
+	ctx->get_buffer2 = get_direct_buffer;
+#if LIBAVCODEC_VERSION_MAJOR < 59
+	ctx->thread_safe_callbacks = 1;
+#endif
+}
+
+// Called before avcodec_open2( ... ); the pixel format is armed once the
+// properties are known, see direct_arm( ... ).
+static void direct_init( ffmpeg_reader_t *p_reader ){
+	direct_alloc_t *p_direct = &p_reader->direct;
+	p_direct->pix_fmt = AV_PIX_FMT_NONE;
+	if( !p_reader->settings.direct || !( p_reader->codec->capabilities & AV_CODEC_CAP_DR1 ) )
+		return;
+
+	voo_mutex_init( &p_direct->lock );
+	p_direct->b_enabled = TRUE;
+	direct_attach( p_reader, p_reader->codec_ctx );
+}
+
+static void direct_arm( ffmpeg_reader_t *p_reader ){
+	// proxies scaled after decoding are not in vooya's layout either
+	if( p_reader->direct.b_enabled && layout_matches( p_reader, p_reader->codec_ctx->pix_fmt ) && p_reader->proxy == p_reader->codec_ctx->lowres )
+		p_reader->direct.pix_fmt = p_reader->codec_ctx->pix_fmt;
+}
+
+// after the decoder is gone
+static void direct_free( ffmpeg_reader_t *p_reader ){
+	direct_alloc_t *p_direct = &p_reader->direct;
+	if( !p_direct->b_enabled )
+		return;
+	voo_mutex_destroy( &p_direct->lock );
+	p_direct->b_enabled = FALSE;
+}
+
+// Describes a contiguous block as rows of row_bytes plus a remainder.
+static int32_t describe_block( plane_desc_t *planes, uint8_t *p_dst, const uint8_t *p_src, size_t size, int32_t row_bytes ){
+	int32_t n = 0;
+	size_t rows = size / row_bytes;
+	if( rows ){
+		planes[ n ].p_src = p_src;
+		planes[ n ].p_dst = p_dst;
+		planes[ n ].src_stride = planes[ n ].dst_stride = planes[ n ].row_bytes = row_bytes;
+		planes[ n ].rows = (int32_t)rows;
+		n++;
+	}
+	if( size - rows * row_bytes ){
+		planes[ n ].p_src = p_src + rows * row_bytes;
+		planes[ n ].p_dst = p_dst + rows * row_bytes;
+		planes[ n ].src_stride = planes[ n ].dst_stride = planes[ n ].row_bytes = (int32_t)( size - rows * row_bytes );
+		planes[ n ].rows = 1;
+		n++;
+	}
+	return n;
+}
+
+// The decoder may switch formats mid-stream; pictures of another format are
+// accepted as long as they look the same to vooya (yuv vs. yuvj, alpha or not).
+static const pix_fmt_map_t *frame_format( ffmpeg_reader_t *p_reader, enum AVPixelFormat fmt ){
+	const pix_fmt_map_t *p_map = pix_fmt_lookup( fmt ), *p_open = p_reader->p_fmt;
+	const AVPixFmtDescriptor *p_desc = av_pix_fmt_desc_get( fmt ), *p_desc_open = av_pix_fmt_desc_get( p_open->pix_fmt );
+
+	if( fmt == p_open->pix_fmt )
+		return p_open;
+	if( !p_map || p_map->arrangement != p_open->arrangement || p_map->color_space != p_open->color_space
+		|| p_map->channel_order != p_open->channel_order || p_desc->comp[ 0 ].depth != p_desc_open->comp[ 0 ].depth
+		|| ( p_desc->flags & AV_PIX_FMT_FLAG_BE ) != ( p_desc_open->flags & AV_PIX_FMT_FLAG_BE ) )
+		return NULL;
+	return p_map;
+}
+
+static vooBOOL transfer_picture( ffmpeg_reader_t *p_reader, const AVFrame *p_frame, char *p_buffer ){
+	const voo_layout_t *p_layout = &p_reader->layout;
+	const pix_fmt_map_t *p_map = NULL;
+	plane_desc_t planes[ MAX_TRANSFER_PLANES ];
+	uint8_t *p_dst = (uint8_t *)p_buffer;
+	int32_t i, k, n = 0;
+
+	if( !p_reader->b_raw_v210 && !(p_map = frame_format( p_reader, (enum AVPixelFormat)p_frame->format )) ){
+		snprintf( p_reader->last_err, ERRBUFF_LEN, "Pixel format changed from %s to %s.",
+			pix_fmt_name( p_reader->p_fmt->pix_fmt ), pix_fmt_name( (enum AVPixelFormat)p_frame->format ) );
+		return FALSE;
+	}
+	if( p_reader->b_scalable && ( p_frame->width != p_reader->properties.width || p_frame->height != p_reader->properties.height ) ){
+		k = scale_shift( p_frame->width, p_reader->properties.width );
+		if( k && k == scale_shift( p_frame->height, p_reader->properties.height ) ){
+			repack_frame( repack_scale_down, p_frame, p_layout, p_dst, p_reader->settings.parallel_copy );
+			return TRUE;
+		}
+		k = scale_shift( p_reader->properties.width, p_frame->width );
+		if( k && k == scale_shift( p_reader->properties.height, p_frame->height ) ){
+			repack_frame( repack_scale_up, p_frame, p_layout, p_dst, p_reader->settings.parallel_copy );
+			return TRUE;
+		}
+	}
+	if( p_frame->width < p_reader->properties.width || p_frame->height < p_reader->properties.height ){
+		snprintf( p_reader->last_err, ERRBUFF_LEN, "Picture size changed to %ix%i.", p_frame->width, p_frame->height );
+		return FALSE;
+	}
+
+	if( p_map && p_map->repack ){
+		repack_frame( p_map->repack, p_frame, p_layout, p_dst, p_reader->settings.parallel_copy );
+		return TRUE;
+	}
+
+	if( frame_in_vooya_layout( p_reader, p_frame ) ){
+
+		n = describe_block( planes, p_dst, p_frame->data[ 0 ], p_layout->size, p_frame->linesize[ 0 ] );
+
+	} else {
+		for( i = 0; i < p_layout->n_planes; i++, n++ ){
+			planes[ i ].p_src = p_frame->data[ i ];
+			planes[ i ].src_stride = p_frame->linesize[ i ];
+			planes[ i ].p_dst = p_dst + p_layout->offset[ i ];
+			planes[ i ].dst_stride = planes[ i ].row_bytes = p_layout->row_bytes[ i ];
+			planes[ i ].rows = p_layout->rows[ i ];
+		}
+	}
+
+	transfer_planes( planes, n, p_reader->settings.parallel_copy );
+	return TRUE;
+}
+
+// Timed copies of the pictures played; the reverse and scrub decoders call
+// transfer_picture( ... ) and stay out of the statistics.
+static vooBOOL transfer_frame( ffmpeg_reader_t *p_reader, const AVFrame *p_frame, char *p_buffer ){
+	int64_t start = av_gettime_relative();
+	vooBOOL b_ok = transfer_picture( p_reader, p_frame, p_buffer );
+	stats_add( &p_reader->stats, STAGE_TRANSFER, start, 0 );
+	return b_ok;
+}
+
+
+static void cache_init( frame_cache_t *p_cache, int64_t budget, size_t frame_size ){
+	memset( p_cache, 0, sizeof(frame_cache_t) );
+	p_cache->budget = budget;
+	p_cache->frame_size = frame_size;
+	voo_mutex_init( &p_cache->lock );
+}
+
+static void cache_unlink( frame_cache_t *p_cache, cache_entry_t *e ){
+	if( e->prev ) e->prev->next = e->next;
+	else p_cache->mru = e->next;
+	if( e->next ) e->next->prev = e->prev;
+	else p_cache->lru = e->prev;
+	e->prev = e->next = NULL;
+}
+
+static void cache_link_mru( frame_cache_t *p_cache, cache_entry_t *e ){
+	e->prev = NULL;
+	e->next = p_cache->mru;
+	e->used = av_gettime_relative();
+	if( p_cache->mru ) p_cache->mru->prev = e;
+	p_cache->mru = e;
+	if( !p_cache->lru ) p_cache->lru = e;
+}
+
+static void cache_unhash( frame_cache_t *p_cache, cache_entry_t *e ){
+	cache_entry_t **pp = &p_cache->buckets[ e->frame % CACHE_BUCKETS ];
+	for( ; *pp; pp = &(*pp)->hash_next )
+		if( *pp == e ){
+			*pp = e->hash_next;
+			break;
+		}
+}
+
+// Frames are numbered at a constant rate until the packet index is complete
+// and by display order after; pictures of one numbering are not those of the
+// other, also where views sharing the cache are at different stages.
+static cache_entry_t *cache_find( frame_cache_t *p_cache, int64_t frame, vooBOOL b_exact ){
+	cache_entry_t *e = p_cache->buckets[ frame % CACHE_BUCKETS ];
+	for( ; e && ( e->frame != frame || e->b_exact != b_exact ); e = e->hash_next );
+	return e;
+}
+
+// under the lock
+static vooBOOL cache_drop_lru( frame_cache_t *p_cache ){
+	cache_entry_t *e = p_cache->lru;
+	if( !e )
+		return FALSE;
+	cache_unlink( p_cache, e );
+	cache_unhash( p_cache, e );
+	av_buffer_unref( &e->p_buf );
+	free( e );
+	p_cache->count--;
+	return TRUE;
+}
+
+// Gives back the least recently used picture drawn from p_mem, for memory
+// wanted elsewhere; in a shared cache, those of other views would only go
+// back to their own reader.
+static vooBOOL cache_shrink( frame_cache_t *p_cache, const memory_t *p_mem ){
+	cache_entry_t *e;
+	if( !p_cache || !p_cache->budget )
+		return FALSE;
+	voo_mutex_lock( &p_cache->lock );
+	for( e = p_cache->lru; e && av_buffer_get_opaque( e->p_buf ) != p_mem; e = e->prev );
+	if( e ){
+		cache_unlink( p_cache, e );
+		cache_unhash( p_cache, e );
+		av_buffer_unref( &e->p_buf );
+		free( e );
+		p_cache->count--;
+	}
+	voo_mutex_unlock( &p_cache->lock );
+	return e != NULL;
+}
+
+static void cache_free( frame_cache_t *p_cache ){
+	cache_entry_t *e, *next;
+	if( !p_cache->frame_size )
+		return;
+	for( e = p_cache->mru; e; e = next ){
+		next = e->next;
+		av_buffer_unref( &e->p_buf );
+		free( e );
+	}
+	voo_mutex_destroy( &p_cache->lock );
+	memset( p_cache, 0, sizeof(frame_cache_t) );
+}
+
+
+// Frame caches of the readers open in the process. Views of the same file in
+// the same layout, side by side or one after the other while the first is
+// still open, share one, so the second is served from pictures the first has
+// decoded and costs little more than the copies into vooya's buffers. Pictures
+// are refcounted buffers of the reader that decoded them, which outlive it if
+// need be. All caches draw on one budget, the largest any was opened with;
+// once it is used up, whichever cache holds the picture used longest ago gives
+// it up.
+static struct
+{
+	voo_mutex_t lock;          // taken before that of a cache, never after
+	frame_cache_t *head;       // linked through p_next
+} g_caches;
+
+static voo_once_t g_caches_once = VOO_ONCE_INIT;
+
+static void caches_init( void ){
+	voo_mutex_init( &g_caches.lock );
+}
+
+// The file's device and inode (volume serial number and file index on
+// Windows), size and modification time, whatever path it is opened by.
+static vooBOOL file_key_of( const char *filename, cache_key_t *p_key ){
+#ifdef WIN32
+	BY_HANDLE_FILE_INFORMATION info;
+	HANDLE file;
+	BOOL b_ok;
+
+	file = CreateFileA( filename, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL );
+	if( INVALID_HANDLE_VALUE == file )
+		return FALSE;
+	b_ok = GetFileInformationByHandle( file, &info );
+	CloseHandle( file );
+	if( !b_ok )
+		return FALSE;
+	p_key->device = info.dwVolumeSerialNumber;
+	p_key->inode = ( (uint64_t)info.nFileIndexHigh << 32 ) | info.nFileIndexLow;
+	p_key->size = ( (int64_t)info.nFileSizeHigh << 32 ) | info.nFileSizeLow;
+	p_key->mtime = ( (int64_t)info.ftLastWriteTime.dwHighDateTime << 32 ) | info.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat st;
+	if( stat( filename, &st ) )
+		return FALSE;
+	p_key->device = (uint64_t)st.st_dev;
+	p_key->inode = (uint64_t)st.st_ino;
+	p_key->size = st.st_size;
+	p_key->mtime = st.st_mtime;
+#endif
+	return TRUE;
+}
+
+static vooBOOL cache_key_of( const ffmpeg_reader_t *p_reader, const char *filename, cache_key_t *p_key ){
+	if( !file_key_of( filename, p_key ) )
+		return FALSE;
+	p_key->width = p_reader->properties.width;
+	p_key->height = p_reader->properties.height;
+	p_key->color_space = p_reader->properties.color_space;
+	p_key->arrangement = p_reader->properties.arrangement;
+	p_key->channel_order = p_reader->properties.channel_order;
+	p_key->bits_per_channel = p_reader->properties.bits_per_channel;
+	p_key->b_signed = p_reader->properties.b_signed;
+	p_key->frame_size = p_reader->properties.frame_size;
+	return TRUE;
+}
+
+// The cache for p_reader's pictures: that of another reader showing the same
+// file in the same layout, else a new one. Streams, files still being written
+// and segments behind an init segment keep theirs to themselves.
+static frame_cache_t *caches_attach( ffmpeg_reader_t *p_reader, const char *filename, int64_t budget ){
+	frame_cache_t *p_cache;
+	cache_key_t key;
+	vooBOOL b_shared;
+
+	memset( &key, 0, sizeof(cache_key_t) );
+	b_shared = budget > 0 && !p_reader->b_stream && !p_reader->settings.follow && !p_reader->settings.init_segment
+		&& cache_key_of( p_reader, filename, &key );
+	voo_once( &g_caches_once, caches_init );
+	voo_mutex_lock( &g_caches.lock );
+	for( p_cache = b_shared ? g_caches.head : NULL; p_cache; p_cache = p_cache->p_next )
+		if( p_cache->b_shared && !memcmp( &p_cache->key, &key, sizeof(cache_key_t) ) )
+			break;
+	if( p_cache ){
+		voo_mutex_lock( &p_cache->lock );
+		p_cache->budget = FFMAX( p_cache->budget, budget );
+		voo_mutex_unlock( &p_cache->lock );
+		p_cache->refs++;
+	} else if( (p_cache = (frame_cache_t *)malloc( sizeof(frame_cache_t) )) ){
+		cache_init( p_cache, budget, p_reader->properties.frame_size );
+		p_cache->key = key;
+		p_cache->b_shared = b_shared;
+		p_cache->refs = 1;
+		p_cache->p_next = g_caches.head;
+		g_caches.head = p_cache;
+	}
+	voo_mutex_unlock( &g_caches.lock );
+	return p_cache;
+}
+
+static void caches_detach( frame_cache_t **pp_cache ){
+	frame_cache_t *p_cache = *pp_cache, **pp;
+	vooBOOL b_last;
+	if( !p_cache )
+		return;
+	voo_mutex_lock( &g_caches.lock );
+	if( (b_last = !--p_cache->refs) ){
+		for( pp = &g_caches.head; *pp != p_cache; pp = &(*pp)->p_next );
+		*pp = p_cache->p_next;
+	}
+	voo_mutex_unlock( &g_caches.lock );
+	if( b_last ){
+		cache_free( p_cache );
+		free( p_cache );
+	}
+	*pp_cache = NULL;
+}
+
+// Before a picture goes into p_for: while all caches together would exceed
+// the budget, the one holding the oldest picture lets it go. Two readers
+// putting at the same time may overshoot by a picture each.
+static void caches_make_room( frame_cache_t *p_for ){
+	frame_cache_t *p, *p_victim;
+	int64_t total, budget, oldest = 0;
+
+	voo_mutex_lock( &g_caches.lock );
+	for( ;; ){
+		total = (int64_t)p_for->frame_size;
+		budget = 0;
+		p_victim = NULL;
+		for( p = g_caches.head; p; p = p->p_next ){
+			voo_mutex_lock( &p->lock );
+			total += (int64_t)p->count * (int64_t)p->frame_size;
+			budget = FFMAX( budget, p->budget );
+			if( p->lru && ( !p_victim || p->lru->used < oldest ) ){
+				p_victim = p;
+				oldest = p->lru->used;
+			}
+			voo_mutex_unlock( &p->lock );
+		}
+		if( total <= budget || !p_victim )
+			break;
+		voo_mutex_lock( &p_victim->lock );
+		cache_drop_lru( p_victim );
+		voo_mutex_unlock( &p_victim->lock );
+	}
+	voo_mutex_unlock( &g_caches.lock );
+}
+
+// A hit costs exactly one copy into p_buffer.
+static vooBOOL cache_get( frame_cache_t *p_cache, int64_t frame, vooBOOL b_exact, char *p_buffer ){
+	cache_entry_t *e;
+	if( !p_cache || !p_cache->budget )
+		return FALSE;
+
+	voo_mutex_lock( &p_cache->lock );
+	if( (e = cache_find( p_cache, frame, b_exact )) ){
+		cache_unlink( p_cache, e );
+		cache_link_mru( p_cache, e );
+		memcpy( p_buffer, e->p_data, p_cache->frame_size );
+		p_cache->hits++;
+	} else
+		p_cache->misses++;
+	voo_mutex_unlock( &p_cache->lock );
+	return e != NULL;
+}
+
+// The cache takes over p_buf, which holds the picture in vooya's layout at
+// p_data. Another reader of the file may have put it already.
+static void cache_insert( frame_cache_t *p_cache, int64_t frame, vooBOOL b_exact, AVBufferRef *p_buf, const char *p_data ){
+	cache_entry_t *e;
+	if( !p_cache || (int64_t)p_cache->frame_size > p_cache->budget ){
+		av_buffer_unref( &p_buf );
+		return;
+	}
+
+	caches_make_room( p_cache );
+	voo_mutex_lock( &p_cache->lock );
+	if( (e = cache_find( p_cache, frame, b_exact )) ){
+		cache_unlink( p_cache, e );
+		cache_link_mru( p_cache, e );
+		voo_mutex_unlock( &p_cache->lock );
+		av_buffer_unref( &p_buf );
+		return;
+	}
+
+	if( (int64_t)( p_cache->count + 1 ) * (int64_t)p_cache->frame_size > p_cache->budget ){
+		// opened with a smaller budget than others: recycle its least recently used entry
+		e = p_cache->lru;
+		cache_unlink( p_cache, e );
+		cache_unhash( p_cache, e );
+		av_buffer_unref( &e->p_buf );
+	} else {
+		if( !(e = (cache_entry_t *)calloc( 1, sizeof(cache_entry_t) )) ){
+			voo_mutex_unlock( &p_cache->lock );
+			av_buffer_unref( &p_buf );
+			return;
+		}
+		p_cache->count++;
+	}
+
+	e->p_buf = p_buf;
+	e->p_data = p_data;
+	e->frame = frame;
+	e->b_exact = b_exact;
+	e->hash_next = p_cache->buckets[ frame % CACHE_BUCKETS ];
+	p_cache->buckets[ frame % CACHE_BUCKETS ] = e;
+	cache_link_mru( p_cache, e );
+	voo_mutex_unlock( &p_cache->lock );
+}
+
+static void cache_put_ref( frame_cache_t *p_cache, int64_t frame, vooBOOL b_exact, AVBufferRef *p_buf, const char *p_data ){
+	cache_insert( p_cache, frame, b_exact, av_buffer_ref( p_buf ), p_data );
+}
+
+static vooBOOL cache_has( frame_cache_t *p_cache, int64_t frame, vooBOOL b_exact ){
+	vooBOOL b_has;
+	if( !p_cache || !p_cache->budget )
+		return FALSE;
+	voo_mutex_lock( &p_cache->lock );
+	b_has = cache_find( p_cache, frame, b_exact ) != NULL;
+	voo_mutex_unlock( &p_cache->lock );
+	return b_has;
+}
+
+
+// For the decoder and copies into the cache; at the memory ceiling, the
+// frame cache gives back its oldest pictures of this reader first.
+static AVBufferRef *picture_buffer( ffmpeg_reader_t *p_reader, size_t size ){
+	AVBufferRef *p_buf;
+	if( !p_reader->p_mem )
+		return av_buffer_alloc( (int)size );
+	while( !(p_buf = memory_buffer( p_reader->p_mem, size )) && p_reader->p_mem->ceiling && cache_shrink( p_reader->p_cache, p_reader->p_mem ) );
+	return p_buf;
+}
+
+
+static void decode_ahead_thread( void *p_arg ){
+	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_arg;
+	decode_ahead_t *p_ahead = &p_reader->ahead;
+	AVFrame *p_frame = av_frame_alloc();
+	int32_t i_ret;
+
+	voo_mutex_lock( &p_ahead->lock );
+	while( !p_ahead->b_stop ){
+		if( p_ahead->count == p_ahead->depth ){
+			voo_cond_wait( &p_ahead->cond, &p_ahead->lock );
+			continue;
+		}
+		voo_mutex_unlock( &p_ahead->lock );
+		i_ret = decode_next( p_reader, p_frame );
+		voo_mutex_lock( &p_ahead->lock );
+
+		if( i_ret < 0 ){
+			p_ahead->status = i_ret;
+			break;
+		}
+		av_frame_move_ref( p_ahead->frames[ ( p_ahead->head + p_ahead->count ) % p_ahead->depth ], p_frame );
+		p_ahead->count++;
+		voo_cond_broadcast( &p_ahead->cond );
+	}
+	voo_cond_broadcast( &p_ahead->cond );
+	voo_mutex_unlock( &p_ahead->lock );
+
+	av_frame_free( &p_frame );
+}
+
+static vooBOOL decode_ahead_init( ffmpeg_reader_t *p_reader ){
+	decode_ahead_t *p_ahead = &p_reader->ahead;
+	int32_t i;
+	if( p_reader->settings.decode_ahead <= 0 )
+		return TRUE;
+
+	if( !(p_ahead->frames = (AVFrame **)calloc( p_reader->settings.decode_ahead, sizeof(AVFrame *) )) )
+		goto fail;
+	for( i = 0; i < p_reader->settings.decode_ahead; i++ )
+		if( !(p_ahead->frames[ i ] = av_frame_alloc()) )
+			goto fail;
+	p_ahead->depth = p_reader->settings.decode_ahead;
+	voo_mutex_init( &p_ahead->lock );
+	voo_cond_init( &p_ahead->cond );
+	return TRUE;
+
+fail:
+	for( i = 0; p_ahead->frames && i < p_reader->settings.decode_ahead; i++ )
+		av_frame_free( &p_ahead->frames[ i ] );
+	free( p_ahead->frames );
+	p_ahead->frames = NULL;
+	sprintf( p_reader->last_err, "Cannot allocate the decode-ahead buffer." );
+	return FALSE;
+}
+
+static vooBOOL decode_ahead_start( ffmpeg_reader_t *p_reader ){
+	decode_ahead_t *p_ahead = &p_reader->ahead;
+	if( !p_ahead->depth || p_ahead->b_running )
+		return TRUE;
+
+	p_ahead->head = p_ahead->count = 0;
+	p_ahead->status = 0;
+	p_ahead->b_stop = FALSE;
+	if( !voo_thread_create( &p_ahead->thread, decode_ahead_thread, p_reader ) ){
+		sprintf( p_reader->last_err, "Cannot start the decoding thread." );
+		p_reader->message( p_reader->p_msg_cargo, p_reader->last_err );
+		return FALSE;
+	}
+	p_ahead->b_running = TRUE;
+	return TRUE;
+}
+
+// Stops the producer and drops everything it decoded; afterwards the demuxer
+// and decoder belong to the calling thread again.
+static void decode_ahead_stop( ffmpeg_reader_t *p_reader ){
+	decode_ahead_t *p_ahead = &p_reader->ahead;
+	if( !p_ahead->b_running )
+		return;
+
+	voo_mutex_lock( &p_ahead->lock );
+	p_ahead->b_stop = TRUE;
+	voo_cond_broadcast( &p_ahead->cond );
+	voo_mutex_unlock( &p_ahead->lock );
+	voo_thread_join( p_ahead->thread );
+	p_ahead->b_running = FALSE;
+
+	for( ; p_ahead->count; p_ahead->count-- ){
+		av_frame_unref( p_ahead->frames[ p_ahead->head ] );
+		p_ahead->head = ( p_ahead->head + 1 ) % p_ahead->depth;
+	}
+}
+
+static void decode_ahead_free( ffmpeg_reader_t *p_reader ){
+	decode_ahead_t *p_ahead = &p_reader->ahead;
+	int32_t i;
+	if( !p_ahead->depth )
+		return;
+
+	decode_ahead_stop( p_reader );
+	for( i = 0; i < p_ahead->depth; i++ )
+		av_frame_free( &p_ahead->frames[ i ] );
+	free( p_ahead->frames );
+	voo_mutex_destroy( &p_ahead->lock );
+	voo_cond_destroy( &p_ahead->cond );
+	p_ahead->depth = 0;
+}
+
+// Takes the oldest decoded picture from the ring into p_frame, waiting for the
+// producer if necessary.
+static int32_t decode_ahead_pop( ffmpeg_reader_t *p_reader, AVFrame *p_frame ){
+	decode_ahead_t *p_ahead = &p_reader->ahead;
+	int32_t i_ret = 0;
+
+	voo_mutex_lock( &p_ahead->lock );
+	if( !p_ahead->count && !p_ahead->status )
+		p_ahead->underruns++;
+	while( !p_ahead->count && !p_ahead->status )
+		voo_cond_wait( &p_ahead->cond, &p_ahead->lock );
+
+	if( p_ahead->count ){
+		av_frame_move_ref( p_frame, p_ahead->frames[ p_ahead->head ] );
+		p_ahead->head = ( p_ahead->head + 1 ) % p_ahead->depth;
+		p_ahead->count--;
+		voo_cond_broadcast( &p_ahead->cond );
+	} else
+		i_ret = p_ahead->status;
+	voo_mutex_unlock( &p_ahead->lock );
+
+	return i_ret;
+}
+
+
+
+
+
+
+// Candidate 0 is the sidecar next to the movie, candidate 1 lives in the user's
+// cache directory for movies on read-only storage, named after the file's
+// device and inode so that any path to it finds the same one.
+static vooBOOL index_cache_path( const char *filename, int32_t i_candidate, char *path, size_t len ){
+	cache_key_t key;
+	const char *base;
+
+	if( 0 == i_candidate ){
+		snprintf( path, len, "%s" INDEX_SUFFIX, filename );
+		return TRUE;
+	}
+	if( !file_key_of( filename, &key ) )
+		return FALSE;
+#ifdef WIN32
+	if( !(base = getenv( "LOCALAPPDATA" )) )
+		return FALSE;
+	snprintf( path, len, "%s\\vooplus", base );
+	_mkdir( path );
+#else
+	char home_cache[ 1024 ];
+	const char *p;
+	if( !(base = getenv( "XDG_CACHE_HOME" )) ){
+		if( !(p = getenv( "HOME" )) )
+			return FALSE;
+		snprintf( home_cache, sizeof(home_cache), "%s/.cache", p );
+		base = home_cache;
+		mkdir( base, 0755 );
+	}
+	snprintf( path, len, "%s/vooplus", base );
+	mkdir( path, 0755 );
+#endif
+	snprintf( path + strlen( path ), len - strlen( path ), "/%016llx-%016llx" INDEX_SUFFIX,
+		(unsigned long long)key.device, (unsigned long long)key.inode );
+	return TRUE;
+}
+
+static vooBOOL index_push( packet_index_t *p_index, const index_entry_t *p_entry ){
+	index_entry_t *p_entries;
+	int32_t capacity;
+	if( p_index->count == p_index->capacity ){
+		capacity = p_index->capacity ? p_index->capacity * 2 : 4096;
+		if( !(p_entries = (index_entry_t *)realloc( p_index->entries, capacity * sizeof(index_entry_t) )) )
+			return FALSE;
+		p_index->entries = p_entries;
+		p_index->capacity = capacity;
+	}
+	p_index->entries[ p_index->count++ ] = *p_entry;
+	return TRUE;
+}
+
+static vooBOOL index_load( ffmpeg_reader_t *p_reader ){
+	packet_index_t *p_index = &p_reader->index;
+	index_file_header_t hdr;
+	char path[ 2048 ];
+	cache_key_t key;
+	int32_t i;
+	FILE *f = NULL;
+
+	if( !file_key_of( p_reader->filename, &key ) )
+		return FALSE;
+
+	for( i = 0; i < 2 && !f; i++ ){
+		if( !index_cache_path( p_reader->filename, i, path, sizeof(path) ) || !(f = fopen( path, "rb" )) )
+			continue;
+		if( 1 != fread( &hdr, sizeof(hdr), 1, f )
+			|| memcmp( hdr.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC) )
+			|| hdr.version != INDEX_VERSION
+			|| hdr.entry_size != sizeof(index_entry_t)
+			|| hdr.file_size != key.size || hdr.file_mtime != key.mtime
+			|| hdr.stream_index != p_reader->stream->index
+			|| hdr.codec_id != p_reader->stream->codecpar->codec_id
+			|| hdr.count <= 0 || hdr.count > INT32_MAX ){
+			fclose( f );
+			f = NULL;
+		}
+	}
+	if( !f )
+		return FALSE;
+
+	p_index->entries = (index_entry_t *)malloc( (size_t)hdr.count * sizeof(index_entry_t) );
+	p_index->capacity = (int32_t)hdr.count;
+	if( p_index->entries && hdr.count == (int64_t)fread( p_index->entries, sizeof(index_entry_t), (size_t)hdr.count, f ) )
+		p_index->count = (int32_t)hdr.count;
+	fclose( f );
+	return 0 < p_index->count;
+}
+
+static void index_save( ffmpeg_reader_t *p_reader ){
+	packet_index_t *p_index = &p_reader->index;
+	index_file_header_t hdr;
+	char path[ 2048 ], tmp_path[ 2100 ];
+	cache_key_t key;
+	int32_t i;
+	FILE *f;
+
+	if( !file_key_of( p_reader->filename, &key ) )
+		return;
+	memset( &hdr, 0, sizeof(hdr) );
+	memcpy( hdr.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC) );
+	hdr.version = INDEX_VERSION;
+	hdr.entry_size = sizeof(index_entry_t);
+	hdr.stream_index = p_reader->stream->index;
+	hdr.codec_id = p_reader->stream->codecpar->codec_id;
+	hdr.count = p_index->count;
+	hdr.file_size = key.size;
+	hdr.file_mtime = key.mtime;
+
+	for( i = 0; i < 2; i++ ){
+		if( !index_cache_path( p_reader->filename, i, path, sizeof(path) ) )
+			continue;
+		snprintf( tmp_path, sizeof(tmp_path), "%s.tmp", path );
+		if( !(f = fopen( tmp_path, "wb" )) )
+			continue;
+		if( 1 == fwrite( &hdr, sizeof(hdr), 1, f )
+			&& (size_t)p_index->count == fwrite( p_index->entries, sizeof(index_entry_t), p_index->count, f ) ){
+			fclose( f );
+			remove( path );
+			if( !rename( tmp_path, path ) )
+				return;
+		} else
+			fclose( f );
+		remove( tmp_path );
+	}
+}
+
+// For intra-only streams in QuickTime/MP4, the demuxer's sample table already
+// is the complete index (pts == dts), which saves reading the whole file.
+static vooBOOL index_from_container( ffmpeg_reader_t *p_reader, AVFormatContext *p_ctx ){
+	packet_index_t *p_index = &p_reader->index;
+	AVStream *st = p_ctx->streams[ p_reader->stream->index ];
+	const AVCodecDescriptor *p_desc = avcodec_descriptor_get( st->codecpar->codec_id );
+	index_entry_t e;
+	int32_t i, n;
+
+	if( !strstr( p_ctx->iformat->name, "mov" ) || !p_desc || !( p_desc->props & AV_CODEC_PROP_INTRA_ONLY ) )
+		return FALSE;
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT( 58, 78, 100 )
+	n = avformat_index_get_entries_count( st );
+#else
+	n = st->nb_index_entries;
+#endif
+	if( n <= 0 || ( st->nb_frames > 0 && n != st->nb_frames ) )
+		return FALSE;
+
+	for( i = 0; i < n; i++ ){
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT( 58, 78, 100 )
+		const AVIndexEntry *p_ie = avformat_index_get_entry( st, i );
+#else
+		const AVIndexEntry *p_ie = &st->index_entries[ i ];
+#endif
+		e.pts = e.dts = p_ie->timestamp;
+		e.pos = p_ie->pos;
+		e.size = p_ie->size;
+		// samples an edit list trims are not shown, index_finalize( ... ) leaves them out
+		e.flags = AV_PKT_FLAG_KEY | ( p_ie->flags & AVINDEX_DISCARD_FRAME ? AV_PKT_FLAG_DISCARD : 0 );
+		if( !index_push( p_index, &e ) ){
+			p_index->count = 0;
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+// into p_target, the reader's index or the one follow mode keeps growing
+static vooBOOL index_by_demuxing( ffmpeg_reader_t *p_reader, AVFormatContext *p_ctx, packet_index_t *p_target ){
+	packet_index_t *p_index = &p_reader->index;
+	AVPacket pkt;
+	index_entry_t e;
+	uint32_t i;
+
+	for( i = 0; i < p_ctx->nb_streams; i++ )
+		if( (int32_t)i != p_reader->stream->index )
+			p_ctx->streams[ i ]->discard = AVDISCARD_ALL;
+
+	av_init_packet( &pkt );
+	while( !p_index->b_stop && 0 <= av_read_frame( p_ctx, &pkt ) ){
+		if( pkt.stream_index == p_reader->stream->index ){
+			e.pts = pkt.pts;
+			e.dts = pkt.dts;
+			e.pos = pkt.pos;
+			e.size = pkt.size;
+			e.flags = pkt.flags;
+			// out of memory, the reader seeks without an index
+			if( !index_push( p_target, &e ) ){
+				av_packet_unref( &pkt );
+				return FALSE;
+			}
+		}
+		av_packet_unref( &pkt );
+	}
+	return !p_index->b_stop && p_target->count;
+}
+
+typedef struct {
+	int64_t ts;
+	int32_t entry;
+} index_sort_t;
+
+static int index_sort_cmp( const void *a, const void *b ){
+	const index_sort_t *p_a = (const index_sort_t *)a, *p_b = (const index_sort_t *)b;
+	if( p_a->ts != p_b->ts )
+		return p_a->ts < p_b->ts ? -1 : 1;
+	return p_a->entry - p_b->entry;
+}
+
+// Derives display order and the keyframe each picture has to be decoded from;
+// FALSE without pictures or memory for them.
+static vooBOOL index_finalize( packet_index_t *p_index ){
+	index_sort_t *p_sort;
+	int32_t i, n = 0, key = 0;
+
+	if( !p_index->count || !(p_sort = (index_sort_t *)malloc( p_index->count * sizeof(index_sort_t) )) )
+		return FALSE;
+	for( i = 0; i < p_index->count; i++ ){
+		index_entry_t *e = &p_index->entries[ i ];
+		if( e->flags & AV_PKT_FLAG_DISCARD )
+			continue;
+		p_sort[ n ].ts = AV_NOPTS_VALUE != e->pts ? e->pts : e->dts;
+		p_sort[ n ].entry = i;
+		n++;
+	}
+	qsort( p_sort, n, sizeof(index_sort_t), index_sort_cmp );
+
+	p_index->display = (int32_t *)malloc( n * sizeof(int32_t) );
+	p_index->display_pts = (int64_t *)malloc( n * sizeof(int64_t) );
+	p_index->key_of = (int32_t *)malloc( n * sizeof(int32_t) );
+	if( !n || !p_index->display || !p_index->display_pts || !p_index->key_of ){
+		free( p_sort );
+		free( p_index->display );
+		free( p_index->display_pts );
+		free( p_index->key_of );
+		p_index->display = NULL;
+		p_index->display_pts = NULL;
+		p_index->key_of = NULL;
+		return FALSE;
+	}
+	for( i = 0; i < n; i++ ){
+		p_index->display[ i ] = p_sort[ i ].entry;
+		p_index->display_pts[ i ] = p_sort[ i ].ts;
+		if( p_index->entries[ p_sort[ i ].entry ].flags & AV_PKT_FLAG_KEY ){
+			key = i;
+			p_index->keyframes++;
+		}
+		p_index->key_of[ i ] = key;
+	}
+	p_index->frames = n;
+	free( p_sort );
+	return TRUE;
+}
+
+// Pictures whose place in display order can no longer change: those shown
+// before the keyframe preceding the last one in decode order. Pictures still
+// to come may be shown before the last keyframe (open GOPs), not before that.
+static int32_t follow_stable_frames( const packet_index_t *p_index ){
+	int64_t ts = AV_NOPTS_VALUE;
+	int32_t i, keys = 0, lo = 0, hi = p_index->frames, mid;
+	for( i = p_index->count - 1; i >= 0 && keys < 2; i-- ){
+		const index_entry_t *e = &p_index->entries[ i ];
+		if( ( e->flags & AV_PKT_FLAG_KEY ) && !( e->flags & AV_PKT_FLAG_DISCARD ) ){
+			ts = AV_NOPTS_VALUE != e->pts ? e->pts : e->dts;
+			keys++;
+		}
+	}
+	if( keys < 2 )
+		return 0;
+	while( lo < hi ){
+		mid = ( lo + hi ) >> 1;
+		if( p_index->display_pts[ mid ] < ts ) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+static void index_release( packet_index_t *p_index ){
+	if( !p_index )
+		return;
+	free( p_index->entries );
+	free( p_index->display );
+	free( p_index->display_pts );
+	free( p_index->key_of );
+	free( p_index );
+}
+
+// Called on the index thread whenever it has read all there is of the file:
+// hands over a copy of the index with the pictures that are final by now. The
+// new length is told on vooya's thread by follow_adopt( ... ), which a reload
+// gets to if vooya is idle; a nudge is due only once the previous copy was
+// taken over.
+static void follow_caught_up( void *p_arg ){
+	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_arg;
+	follow_t *f = &p_reader->follow;
+	packet_index_t *p_next;
+	int64_t now = av_gettime_relative(), limit = 0;
+	vooBOOL b_settled, b_nudge;
+	int32_t i, frames;
+
+	if( f->work.count != f->last_count ){
+		f->last_count = f->work.count;
+		f->last_growth = now;
+	}
+	// nothing written for a while, the last GOP is as complete as it gets
+	b_settled = now - f->last_growth >= FOLLOW_SETTLE;
+	if( !f->work.count || ( f->work.count == f->handed_count && ( f->b_handed_all || !b_settled ) ) )
+		return;
+	f->handed_count = f->work.count;
+	f->b_handed_all = b_settled;
+
+	if( !(p_next = (packet_index_t *)calloc( 1, sizeof(packet_index_t) )) )
+		return;
+	if( !(p_next->entries = (index_entry_t *)malloc( f->work.count * sizeof(index_entry_t) )) ){
+		free( p_next );
+		return;
+	}
+	memcpy( p_next->entries, f->work.entries, f->work.count * sizeof(index_entry_t) );
+	p_next->count = p_next->capacity = f->work.count;
+	if( !index_finalize( p_next ) ){
+		index_release( p_next );
+		return;
+	}
+	frames = b_settled ? p_next->frames : FFMIN( FFMAX( follow_stable_frames( p_next ), f->handed_frames ), p_next->frames );
+	if( frames <= f->handed_frames ){
+		index_release( p_next );
+		return;
+	}
+	p_next->frames = frames;
+	for( p_next->keyframes = 0, i = 0; i < frames; i++ )
+		p_next->keyframes += p_next->key_of[ i ] == i;
+	// the reader's demuxer ends after the last complete packet, not in the middle of one
+	for( i = 0; i < p_next->count; i++ )
+		if( p_next->entries[ i ].pos >= 0 )
+			limit = FFMAX( limit, p_next->entries[ i ].pos + p_next->entries[ i ].size );
+
+	voo_mutex_lock( &f->lock );
+	b_nudge = !f->p_pending;
+	index_release( f->p_pending );
+	f->p_pending = p_next;
+	f->pending_limit = limit;
+	f->updates++;
+	voo_mutex_unlock( &f->lock );
+
+	f->handed_frames = frames;
+	if( b_nudge && p_reader->trigger_reload )
+		p_reader->trigger_reload( p_reader->p_reload_cargo );
+}
+
+static void index_thread( void *p_arg ){
+	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_arg;
+	packet_index_t *p_index = &p_reader->index;
+	AVFormatContext *p_ctx = NULL;
+	vooBOOL b_ok, b_demuxed;
+
+	if( !(b_ok = p_reader->settings.index_cache && index_load( p_reader )) ){
+		// a private demuxer, the reader's own one belongs to the decoding side
+		if( 0 > io_open_input( &p_ctx, p_reader->filename, &p_reader->settings, p_reader ) )
+			return;
+		// until in_close( ... ), handing over what it found whenever it waits for more
+		if( p_reader->settings.follow && io_follow( p_ctx, p_reader->filename, &p_index->b_stop,
+			follow_caught_up, p_reader, p_reader->settings.follow_ms ) ){
+			index_by_demuxing( p_reader, p_ctx, &p_reader->follow.work );
+			io_close_input( &p_ctx );
+			return;
+		}
+		b_demuxed = !(b_ok = index_from_container( p_reader, p_ctx )) && (b_ok = index_by_demuxing( p_reader, p_ctx, p_index ));
+		io_close_input( &p_ctx );
+		// the container's own index is rebuilt in no time, not worth a file
+		// next to every intra-only movie or segment opened
+		if( b_demuxed && p_reader->settings.index_cache )
+			index_save( p_reader );
+	} else
+		p_index->b_from_cache = TRUE;
+
+	// without memory for the index, the reader seeks without one
+	if( !b_ok || !index_finalize( p_index ) )
+		return;
+
+	voo_mutex_lock( &p_index->lock );
+	p_index->b_complete = TRUE;
+	voo_mutex_unlock( &p_index->lock );
+}
+
+static void index_start( ffmpeg_reader_t *p_reader ){
+	packet_index_t *p_index = &p_reader->index;
+	if( !p_reader->settings.index || p_reader->b_stream )
+		return;
+
+	voo_mutex_init( &p_index->lock );
+	p_index->b_running = voo_thread_create( &p_index->thread, index_thread, p_reader );
+}
+
+static void index_free( ffmpeg_reader_t *p_reader ){
+	packet_index_t *p_index = &p_reader->index;
+	if( !p_index->b_running )
+		return;
+
+	p_index->b_stop = TRUE;
+	voo_thread_join( p_index->thread );
+	voo_mutex_destroy( &p_index->lock );
+	free( p_index->entries );
+	free( p_index->display );
+	free( p_index->display_pts );
+	free( p_index->key_of );
+	memset( p_index, 0, sizeof(packet_index_t) );
+}
+
+static vooBOOL index_ready( ffmpeg_reader_t *p_reader ){
+	vooBOOL b_ready;
+	if( !p_reader->index.b_running )
+		return FALSE;
+	voo_mutex_lock( &p_reader->index.lock );
+	b_ready = p_reader->index.b_complete;
+	voo_mutex_unlock( &p_reader->index.lock );
+	return b_ready;
+}
+
+// On vooya's thread: takes over the index last handed over by the index
+// thread, lets the reader's demuxer read up to its last packet and tells
+// vooya the new length.
+static void follow_adopt( ffmpeg_reader_t *p_reader ){
+	packet_index_t *p_index = &p_reader->index, *p_next;
+	void (*seq_len_changed)( void *, unsigned int );
+	void *p_vooya_ctx;
+	file_io_t *p_io;
+	int64_t limit;
+	if( !p_reader->settings.follow || !p_index->b_running )
+		return;
+
+	voo_mutex_lock( &p_reader->follow.lock );
+	p_next = p_reader->follow.p_pending;
+	limit = p_reader->follow.pending_limit;
+	p_reader->follow.p_pending = NULL;
+	seq_len_changed = p_reader->follow.seq_len_changed;
+	p_vooya_ctx = p_reader->follow.p_vooya_ctx;
+	voo_mutex_unlock( &p_reader->follow.lock );
+	if( !p_next )
+		return;
+
+	free( p_index->entries );
+	free( p_index->display );
+	free( p_index->display_pts );
+	free( p_index->key_of );
+	p_index->entries = p_next->entries;
+	p_index->count = p_next->count;
+	p_index->capacity = p_next->capacity;
+	p_index->frames = p_next->frames;
+	p_index->keyframes = p_next->keyframes;
+	p_index->display = p_next->display;
+	p_index->display_pts = p_next->display_pts;
+	p_index->key_of = p_next->key_of;
+	free( p_next );
+
+	voo_mutex_lock( &p_index->lock );
+	p_index->b_complete = TRUE;
+	voo_mutex_unlock( &p_index->lock );
+	if( (p_io = io_of( p_reader->format_ctx )) && limit > 0 )
+		voo_atomic_set( &p_io->limit, limit );
+	if( seq_len_changed )
+		seq_len_changed( p_vooya_ctx, (unsigned int)p_index->frames );
+}
+
+// after index_free( ... ), the index thread is gone
+static void follow_free( ffmpeg_reader_t *p_reader ){
+	follow_t *f = &p_reader->follow;
+	if( !p_reader->settings.follow )
+		return;
+	index_release( f->p_pending );
+	free( f->work.entries );
+	voo_mutex_destroy( &f->lock );
+	memset( f, 0, sizeof(follow_t) );
+}
+
+// frame index <-> stream timestamp; exact once the packet index is complete,
+// until then counting frames at a constant rate from the stream start
+static int64_t frame_to_pts( ffmpeg_reader_t *p_reader, int64_t frame ){
+	if( index_ready( p_reader ) ){
+		frame = FFMIN( FFMAX( frame, 0 ), p_reader->index.frames - 1 );
+		return p_reader->index.display_pts[ frame ];
+	}
+	return p_reader->start_pts + av_rescale_q( frame, av_inv_q( p_reader->frame_rate ), p_reader->stream->time_base );
+}
+
+static int64_t pts_to_frame( ffmpeg_reader_t *p_reader, int64_t pts ){
+	if( index_ready( p_reader ) ){
+		const int64_t *p_pts = p_reader->index.display_pts;
+		int32_t lo = 0, hi = p_reader->index.frames, mid;
+		while( lo < hi ){
+			mid = ( lo + hi ) >> 1;
+			if( p_pts[ mid ] < pts ) lo = mid + 1;
+			else hi = mid;
+		}
+		if( lo > 0 && ( lo == p_reader->index.frames || pts - p_pts[ lo - 1 ] < p_pts[ lo ] - pts ) )
+			lo--;
+		return lo;
+	}
+	return av_rescale_q_rnd( pts - p_reader->start_pts, p_reader->stream->time_base,
+		av_inv_q( p_reader->frame_rate ), AV_ROUND_NEAR_INF );
+}
+
+// the picture decoding has to start from to reconstruct "frame"
+static int64_t keyframe_of( ffmpeg_reader_t *p_reader, int64_t frame ){
+	if( index_ready( p_reader ) && frame < p_reader->index.frames )
+		return p_reader->index.key_of[ frame ];
+	return frame;
+}
+
+static int64_t picture_index( ffmpeg_reader_t *p_reader, const AVFrame *p_frame, int64_t prev ){
+	int64_t ts = p_frame->best_effort_timestamp;
+	if( AV_NOPTS_VALUE == ts )
+		ts = p_frame->pts;
+	if( AV_NOPTS_VALUE == ts )
+		return prev + 1;
+	return pts_to_frame( p_reader, ts );
+}
+
+// GOP-parallel decoding, see gop_decode_t.
+
+typedef struct
+{
+	ffmpeg_reader_t *p_reader;
+	int32_t i_ctx;
+} gop_worker_t;
+
+// Hands a decoded picture to the consumer, waiting while the GOP's ring is full.
+static vooBOOL gop_push( gop_decode_t *p_gop, gop_job_t *p_job, AVFrame *p_frame ){
+	voo_mutex_lock( &p_gop->lock );
+	while( p_job->count == p_gop->depth && !p_gop->b_cancel && !p_gop->b_stop )
+		voo_cond_wait( &p_gop->cond, &p_gop->lock );
+	if( p_gop->b_cancel || p_gop->b_stop ){
+		voo_mutex_unlock( &p_gop->lock );
+		av_frame_unref( p_frame );
+		return FALSE;
+	}
+	av_frame_move_ref( p_job->frames[ ( p_job->head + p_job->count ) % p_gop->depth ], p_frame );
+	p_job->count++;
+	voo_cond_broadcast( &p_gop->cond );
+	voo_mutex_unlock( &p_gop->lock );
+	return TRUE;
+}
+
+static void gop_decode_job( ffmpeg_reader_t *p_reader, AVCodecContext *ctx, gop_job_t *p_job, AVFrame *p_frame ){
+	int32_t p, i_ret;
+	int64_t idx;
+
+	for( p = 0; p <= p_job->n_pkts && !p_reader->gop.b_cancel && !p_reader->gop.b_stop; p++ ){
+		// errors on single packets are skipped as in decode_next( ... )
+		timed_send_packet( &p_reader->stats, ctx, p < p_job->n_pkts ? &p_job->pkts[ p ] : NULL );
+		while( 0 <= (i_ret = timed_receive_frame( &p_reader->stats, ctx, p_frame )) ){
+			idx = picture_index( p_reader, p_frame, p_job->next - 1 );
+			// leading pictures of an open GOP belong to the one before
+			if( idx < p_job->next || idx >= p_job->end ){
+				av_frame_unref( p_frame );
+				continue;
+			}
+			p_job->next = (int32_t)idx + 1;
+			if( !gop_push( &p_reader->gop, p_job, p_frame ) )
+				goto done;
+		}
+	}
+done:
+	avcodec_flush_buffers( ctx );
+}
+
+static void gop_thread( void *p_arg ){
+	gop_worker_t *p_worker = (gop_worker_t *)p_arg;
+	ffmpeg_reader_t *p_reader = p_worker->p_reader;
+	gop_decode_t *p_gop = &p_reader->gop;
+	AVFrame *p_frame = av_frame_alloc();
+	gop_job_t *p_job;
+	int32_t i;
+
+	voo_mutex_lock( &p_gop->lock );
+	while( !p_gop->b_stop ){
+		p_job = NULL;
+		for( i = 0; !p_gop->b_cancel && i < p_gop->n_jobs && !p_job; i++ ){
+			gop_job_t *p = &p_gop->jobs[ ( p_gop->job_head + i ) % p_gop->n_ctx ];
+			if( !p->b_taken && !p->status )
+				p_job = p;
+		}
+		if( !p_job ){
+			voo_cond_wait( &p_gop->cond, &p_gop->lock );
+			continue;
+		}
+		p_job->b_taken = TRUE;
+		voo_mutex_unlock( &p_gop->lock );
+
+		gop_decode_job( p_reader, p_gop->ctxs[ p_worker->i_ctx ], p_job, p_frame );
+
+		voo_mutex_lock( &p_gop->lock );
+		p_job->b_taken = FALSE;
+		p_job->status = AVERROR_EOF;
+		voo_cond_broadcast( &p_gop->cond );
+	}
+	voo_mutex_unlock( &p_gop->lock );
+
+	av_frame_free( &p_frame );
+	free( p_worker );
+}
+
+// Next packet of our stream, which must be index entry read_pos.
+static int32_t gop_read( ffmpeg_reader_t *p_reader ){
+	gop_decode_t *p_gop = &p_reader->gop;
+	const index_entry_t *e;
+	AVPacket *p_pkt = &p_reader->avpkt, *p_buf;
+	int32_t i_ret, capacity;
+
+	if( p_gop->read_pos >= p_reader->index.count )
+		return AVERROR_EOF;
+	// before reading, so that no packet gets lost on failure
+	if( p_gop->pkt_count == p_gop->pkt_capacity ){
+		capacity = FFMAX( 2 * p_gop->pkt_capacity, 64 );
+		if( !(p_buf = (AVPacket *)realloc( p_gop->pkt_buf, capacity * sizeof(AVPacket) )) )
+			return AVERROR(ENOMEM);
+		p_gop->pkt_buf = p_buf;
+		p_gop->pkt_capacity = capacity;
+	}
+	e = &p_reader->index.entries[ p_gop->read_pos ];
+	for( ;; ){
+		if( (i_ret = timed_read_frame( &p_reader->stats, p_reader->format_ctx, p_pkt )) < 0 )
+			return i_ret;
+		if( p_pkt->stream_index != p_reader->stream->index ){
+			av_packet_unref( p_pkt );
+			continue;
+		}
+		if( p_pkt->dts == e->dts && p_pkt->pts == e->pts )
+			break;
+		// a seek may land a few packets early
+		if( !p_gop->pkt_count && AV_NOPTS_VALUE != p_pkt->dts && p_pkt->dts < e->dts ){
+			av_packet_unref( p_pkt );
+			continue;
+		}
+		av_packet_unref( p_pkt );
+		return AVERROR_INVALIDDATA;
+	}
+
+	if( !p_gop->pkt_count )
+		p_gop->pkt_first = p_gop->read_pos;
+	memory_packets( p_reader->p_mem, p_pkt->size );
+	av_packet_move_ref( &p_gop->pkt_buf[ p_gop->pkt_count++ ], p_pkt );
+	p_gop->read_pos++;
+	return 0;
+}
+
+// Cuts the GOP starting at next_key out of the stream into a new job.
+static int32_t gop_schedule( ffmpeg_reader_t *p_reader ){
+	gop_decode_t *p_gop = &p_reader->gop;
+	const packet_index_t *p_index = &p_reader->index;
+	gop_job_t *p_job;
+	AVPacket *p_pkts;
+	int32_t d, i, i_ret, first = p_gop->next_key, end = first + 1, last = p_index->display[ first ], drop, n_pkts;
+
+	while( end < p_index->frames && p_index->key_of[ end ] == first ){
+		last = FFMAX( last, p_index->display[ end ] );
+		end++;
+	}
+	if( p_gop->pkt_count && p_index->display[ first ] < p_gop->pkt_first )
+		return AVERROR_INVALIDDATA;
+	while( !p_gop->pkt_count || p_gop->pkt_first + p_gop->pkt_count <= last )
+		if( (i_ret = gop_read( p_reader )) < 0 )
+			return i_ret;
+	n_pkts = last - p_index->display[ first ] + 1;
+	if( !(p_pkts = (AVPacket *)calloc( n_pkts, sizeof(AVPacket) )) )
+		return AVERROR(ENOMEM);
+
+	voo_mutex_lock( &p_gop->lock );
+	p_job = &p_gop->jobs[ ( p_gop->job_head + p_gop->n_jobs ) % p_gop->n_ctx ];
+	p_job->first = p_job->next = first;
+	p_job->end = end;
+	p_job->n_pkts = n_pkts;
+	p_job->pkts = p_pkts;
+	for( i = 0; i < p_job->n_pkts; i++ )
+		av_packet_ref( &p_job->pkts[ i ], &p_gop->pkt_buf[ p_index->display[ first ] - p_gop->pkt_first + i ] );
+	p_job->head = p_job->count = p_job->status = 0;
+	p_job->b_taken = FALSE;
+	p_gop->n_jobs++;
+	p_gop->gops++;
+	voo_cond_broadcast( &p_gop->cond );
+	voo_mutex_unlock( &p_gop->lock );
+
+	// packets before the next keyframe are not needed anymore
+	p_gop->next_key = end < p_index->frames ? end : -1;
+	drop = end < p_index->frames ? p_index->display[ end ] - p_gop->pkt_first : p_gop->pkt_count;
+	drop = FFMIN( FFMAX( drop, 0 ), p_gop->pkt_count );
+	for( d = 0; d < drop; d++ ){
+		memory_packets( p_reader->p_mem, -p_gop->pkt_buf[ d ].size );
+		av_packet_unref( &p_gop->pkt_buf[ d ] );
+	}
+	memmove( p_gop->pkt_buf, p_gop->pkt_buf + drop, ( p_gop->pkt_count - drop ) * sizeof(AVPacket) );
+	p_gop->pkt_count -= drop;
+	p_gop->pkt_first += drop;
+	return 0;
+}
+
+static void gop_job_clear( gop_decode_t *p_gop, gop_job_t *p_job ){
+	int32_t i;
+	for( i = 0; i < p_job->n_pkts; i++ )
+		av_packet_unref( &p_job->pkts[ i ] );
+	free( p_job->pkts );
+	p_job->pkts = NULL;
+	p_job->n_pkts = 0;
+	for( ; p_job->count; p_job->count-- ){
+		av_frame_unref( p_job->frames[ p_job->head ] );
+		p_job->head = ( p_job->head + 1 ) % p_gop->depth;
+	}
+}
+
+static int32_t gop_serial( ffmpeg_reader_t *p_reader, AVFrame *p_frame );
+
+// The next picture in display order; the consumer side of decode_next( ... ).
+static int32_t gop_next( ffmpeg_reader_t *p_reader, AVFrame *p_frame ){
+	gop_decode_t *p_gop = &p_reader->gop;
+	gop_job_t *p_job;
+	int32_t i_ret;
+
+	for( ;; ){
+		// keep every context busy
+		while( p_gop->n_jobs < p_gop->n_ctx && 0 <= p_gop->next_key ){
+			if( AVERROR_INVALIDDATA == (i_ret = gop_schedule( p_reader )) ){
+				sprintf( p_reader->last_err, "The stream does not match its packet index, decoding serially." );
+				p_gop->b_broken = TRUE;
+				return gop_serial( p_reader, p_frame );
+			}
+			// nothing is lost, the GOP is scheduled again on the next call
+			if( AVERROR(ENOMEM) == i_ret )
+				return i_ret;
+			if( i_ret < 0 )
+				p_gop->next_key = -1;
+		}
+		if( !p_gop->n_jobs )
+			return AVERROR_EOF;
+
+		voo_mutex_lock( &p_gop->lock );
+		p_job = &p_gop->jobs[ p_gop->job_head ];
+		while( !p_job->count && !p_job->status )
+			voo_cond_wait( &p_gop->cond, &p_gop->lock );
+		if( p_job->count ){
+			av_frame_move_ref( p_frame, p_job->frames[ p_job->head ] );
+			p_job->head = ( p_job->head + 1 ) % p_gop->depth;
+			p_job->count--;
+			voo_cond_broadcast( &p_gop->cond );
+			voo_mutex_unlock( &p_gop->lock );
+			p_gop->next_out = picture_index( p_reader, p_frame, p_gop->next_out - 1 ) + 1;
+			return 0;
+		}
+		gop_job_clear( p_gop, p_job );
+		p_job->status = 0;
+		p_gop->job_head = ( p_gop->job_head + 1 ) % p_gop->n_ctx;
+		p_gop->n_jobs--;
+		voo_mutex_unlock( &p_gop->lock );
+	}
+}
+
+// Called with the demuxer positioned on the keyframe of "frame"; the caller
+// has stopped decode-ahead. Drops all GOPs in flight and starts anew there,
+// in GOP-parallel mode if the index is complete by now.
+static void gop_restart( ffmpeg_reader_t *p_reader, int64_t frame ){
+	gop_decode_t *p_gop = &p_reader->gop;
+	int32_t i;
+	if( !p_gop->ctxs )
+		return;
+
+	voo_mutex_lock( &p_gop->lock );
+	p_gop->b_cancel = TRUE;
+	voo_cond_broadcast( &p_gop->cond );
+	for( ;; ){
+		for( i = 0; i < p_gop->n_ctx && !p_gop->jobs[ i ].b_taken; i++ );
+		if( i == p_gop->n_ctx )
+			break;
+		voo_cond_wait( &p_gop->cond, &p_gop->lock );
+	}
+	for( i = 0; i < p_gop->n_ctx; i++ ){
+		gop_job_clear( p_gop, &p_gop->jobs[ i ] );
+		p_gop->jobs[ i ].status = 0;
+	}
+	p_gop->job_head = p_gop->n_jobs = 0;
+	p_gop->b_cancel = FALSE;
+	voo_mutex_unlock( &p_gop->lock );
+
+	for( i = 0; i < p_gop->pkt_count; i++ ){
+		memory_packets( p_reader->p_mem, -p_gop->pkt_buf[ i ].size );
+		av_packet_unref( &p_gop->pkt_buf[ i ] );
+	}
+	p_gop->pkt_count = 0;
+
+	p_gop->b_active = !p_gop->b_broken && index_ready( p_reader ) && p_reader->index.frames > 0;
+	if( p_gop->b_active ){
+		frame = FFMIN( FFMAX( frame, 0 ), p_reader->index.frames - 1 );
+		p_gop->next_key = p_reader->index.key_of[ frame ];
+		p_gop->next_out = p_gop->next_key;
+		p_gop->read_pos = p_gop->pkt_first = p_reader->index.display[ p_gop->next_key ];
+	}
+}
+
+// On the thread that decodes, once the demuxer disagreed with the index:
+// drops the GOPs in flight and reseeks the reader's own decoder to the
+// picture due next, so that decoding goes on serially without a gap.
+static int32_t gop_serial( ffmpeg_reader_t *p_reader, AVFrame *p_frame ){
+	int64_t frame = p_reader->gop.next_out, idx = keyframe_of( p_reader, frame ) - 1;
+	int32_t i_ret;
+
+	gop_restart( p_reader, frame );
+	if( av_seek_frame( p_reader->format_ctx, p_reader->stream->index,
+		frame_to_pts( p_reader, idx + 1 ), AVSEEK_FLAG_BACKWARD ) < 0 ){
+		sprintf( p_reader->last_err, "Cannot seek to frame %lli.", (long long)frame );
+		return AVERROR_INVALIDDATA;
+	}
+	avcodec_flush_buffers( p_reader->codec_ctx );
+	p_reader->realtime.n_sent = 0;
+	for( ;; ){
+		if( (i_ret = decode_next( p_reader, p_frame )) < 0 )
+			return i_ret;
+		if( (idx = picture_index( p_reader, p_frame, idx )) >= frame )
+			return 0;
+		av_frame_unref( p_frame );
+	}
+}
+
+// GOP-parallel decoding is planned but waits for the index to be complete.
+static vooBOOL gop_pending( ffmpeg_reader_t *p_reader ){
+	return p_reader->gop.ctxs && !p_reader->gop.b_active && !p_reader->gop.b_broken && index_ready( p_reader );
+}
+
+static int32_t next_picture( ffmpeg_reader_t *p_reader, AVFrame *p_frame ){
+	if( p_reader->ahead.b_running )
+		return decode_ahead_pop( p_reader, p_frame );
+	return decode_next( p_reader, p_frame );
+}
+
+// Repositions the demuxer on the keyframe at or before "frame"; the pictures
+// before "frame" are decoded and dropped by fetch_frame( ... ) afterwards.
+static vooBOOL reader_seek( ffmpeg_reader_t *p_reader, int64_t frame ){
+	int64_t start = av_gettime_relative();
+	vooBOOL b_ok = FALSE;
+
+	decode_ahead_stop( p_reader );
+
+	if( 0 <= av_seek_frame( p_reader->format_ctx, p_reader->stream->index,
+		frame_to_pts( p_reader, keyframe_of( p_reader, frame ) ), AVSEEK_FLAG_BACKWARD ) ){
+		avcodec_flush_buffers( p_reader->codec_ctx );
+		p_reader->realtime.n_sent = 0;
+		intra_reset( p_reader );
+		gop_restart( p_reader, frame );
+		// the pictures in flight are back, keep what decoding takes up again
+		memory_trim( p_reader->p_mem, p_reader->ahead.depth + FFMAX( p_reader->codec_ctx->thread_count, 1 ) + 2 );
+		p_reader->b_eof = FALSE;
+		b_ok = TRUE;
+	} else
+		sprintf( p_reader->last_err, "Cannot seek to frame %lli.", (long long)frame );
+
+	av_frame_unref( p_reader->picture );
+	p_reader->cur_frame = -1;
+	p_reader->next_frame = frame;
+
+	decode_ahead_start( p_reader );
+	stats_add( &p_reader->stats, STAGE_SEEK, start, 0 );
+	return b_ok;
+}
+
+static vooBOOL needs_seek( ffmpeg_reader_t *p_reader, int64_t frame ){
+	if( 0 <= p_reader->cur_frame && p_reader->cover_from <= frame && frame <= p_reader->cur_frame )
+		return FALSE;
+	if( frame < p_reader->next_frame )
+		return TRUE;
+	if( p_reader->b_stream )
+		return FALSE;
+	// every picture is a keyframe; a seek costs less than decoding more than a batch
+	if( p_reader->b_intra_only )
+		return frame - p_reader->next_frame > FFMAX( p_reader->intra.n_ctx, 1 );
+	// with an index, decode forward exactly while no keyframe lies in between
+	if( index_ready( p_reader ) )
+		return keyframe_of( p_reader, frame ) > p_reader->next_frame;
+	return frame - p_reader->next_frame > MAX_DECODE_FORWARD;
+}
+
+// Tells the OS where the packets from "frame" (or its keyframe, if that is
+// to be sought) on lie, which after a seek is not where the last read ended.
+static void io_prefetch( ffmpeg_reader_t *p_reader, int64_t frame ){
+	file_io_t *p_io = io_of( p_reader->format_ctx );
+	int64_t pos;
+	if( !p_io || !index_ready( p_reader ) || frame < 0 || frame >= p_reader->index.frames )
+		return;
+	if( needs_seek( p_reader, frame ) )
+		frame = keyframe_of( p_reader, frame );
+	pos = p_reader->index.entries[ p_reader->index.display[ frame ] ].pos;
+	io_hint( p_io, pos, p_io->readahead );
+
+#ifndef WIN32
+	// big packets are also read ahead, the demuxer's position on; the
+	// decode-ahead thread's demuxer may be reading already, so the prefetcher
+	// is published once it is set up and knows that position by itself
+	if( !p_reader->b_prefetch_checked && p_reader->settings.prefetch && IO_READ == p_io->backend && !p_io->prefix_size ){
+		int64_t bytes = 0;
+		int32_t i;
+		for( i = 0; i < p_reader->index.count; i++ )
+			bytes += p_reader->index.entries[ i ].size;
+		if( bytes / p_reader->index.count >= PREFETCH_MIN_PACKET )
+			voo_atomic_set_ptr( &p_io->p_prefetch, prefetch_init( p_io->fd, p_reader->settings.prefetch ) );
+		p_reader->b_prefetch_checked = TRUE;
+	}
+	if( p_io->p_prefetch ){
+		int64_t positions[ MAX_PREFETCH ];
+		int32_t sizes[ MAX_PREFETCH ], n = 0, e;
+		for( e = p_reader->index.display[ frame ]; e < p_reader->index.count && n < MAX_PREFETCH; e++ ){
+			const index_entry_t *p_entry = &p_reader->index.entries[ e ];
+			if( p_entry->pos < 0 )
+				continue;
+			positions[ n ] = p_entry->pos;
+			sizes[ n++ ] = p_entry->size;
+		}
+		prefetch_want( (prefetcher_t *)p_io->p_prefetch, positions, sizes, n );
+	}
+#endif
+}
+
+// Streams only go forward; of what lies behind, the frame cache holds the
+// pictures last shown, see STREAM_HISTORY.
+static int32_t stream_behind( ffmpeg_reader_t *p_reader, int64_t frame ){
+	sprintf( p_reader->last_err, "Frame %lli has passed; a stream cannot go back further than the pictures last shown.", (long long)frame );
+	return AVERROR( EINVAL );
+}
+
+// The reader's demuxer ended where the followed file did when it got there;
+// once the file has grown past "frame", decoding restarts from its keyframe.
+static vooBOOL follow_resume( ffmpeg_reader_t *p_reader, int64_t frame ){
+	file_io_t *p_io = io_of( p_reader->format_ctx );
+	int64_t limit;
+	if( !p_reader->settings.follow || !p_io || !index_ready( p_reader ) || frame >= p_reader->index.frames )
+		return FALSE;
+	if( (limit = voo_atomic_get( &p_io->limit )) == p_reader->follow.resumed_limit )
+		return FALSE;
+	p_reader->follow.resumed_limit = limit;
+	return reader_seek( p_reader, frame );
+}
+
+// Leaves the picture for "frame" in p_reader->picture, seeking only if
+// decoding forward from the current position would not get there cheaply.
+static int32_t fetch_frame( ffmpeg_reader_t *p_reader, int64_t frame ){
+	int32_t i_ret;
+	int64_t idx;
+
+	if( index_ready( p_reader ) && frame >= p_reader->index.frames )
+		return AVERROR_EOF;
+	if( needs_seek( p_reader, frame ) && p_reader->b_stream )
+		return stream_behind( p_reader, frame );
+	if( ( needs_seek( p_reader, frame ) || gop_pending( p_reader ) ) && !reader_seek( p_reader, frame ) )
+		return AVERROR( EINVAL );
+
+	if( 0 <= p_reader->cur_frame && p_reader->cover_from <= frame && frame <= p_reader->cur_frame )
+		return 0;
+
+	idx = p_reader->next_frame - 1;
+	do {
+		av_frame_unref( p_reader->picture );
+		p_reader->cur_frame = -1;
+		if( (i_ret = next_picture( p_reader, p_reader->picture )) < 0 ){
+			// the pictures dropped on the way are gone from the decoder all the same
+			p_reader->next_frame = idx + 1;
+			if( AVERROR_EOF == i_ret && follow_resume( p_reader, frame ) )
+				return fetch_frame( p_reader, frame );
+			return i_ret;
+		}
+		idx = picture_index( p_reader, p_reader->picture, idx );
+	} while( idx < frame );
+
+	// with gaps in the timestamps the next picture may be a later one;
+	// it is shown for all requests up to its own index.
+	p_reader->cover_from = frame;
+	p_reader->cur_frame = idx;
+	p_reader->next_frame = idx + 1;
+	return 0;
+}
+
+// Restarts the clock unless "frame" follows the previous request, and decides
+// how much the decoder may discard to get back on time.
+static void realtime_track( ffmpeg_reader_t *p_reader, int64_t frame ){
+	realtime_t *p_rt = &p_reader->realtime;
+	int64_t now = av_gettime_relative(), lag;
+
+	if( !p_reader->settings.realtime || p_reader->b_intra_only || p_reader->b_raw_v210 )
+		return;
+	if( frame != p_rt->last_frame + 1 ){
+		p_rt->base_frame = frame;
+		p_rt->base_time = now;
+		p_rt->last_frame = frame;
+		voo_atomic_set( &p_rt->discard, AVDISCARD_DEFAULT );
+		return;
+	}
+	p_rt->last_frame = frame;
+	lag = now - p_rt->base_time - ( frame - p_rt->base_frame ) * p_rt->period;
+	if( lag > REALTIME_MAX_LAG ){
+		p_rt->base_frame = frame;
+		p_rt->base_time = now;
+		p_rt->restarts++;
+		lag = 0;
+	}
+	// late because vooya plays slower than the stream's rate is no reason to drop
+	if( lag <= 0 || p_rt->load_time < p_rt->period / 2 )
+		voo_atomic_set( &p_rt->discard, AVDISCARD_DEFAULT );
+	else if( lag > 4 * p_rt->period )
+		voo_atomic_set( &p_rt->discard, AVDISCARD_BIDIR );
+	else if( lag > p_rt->period )
+		voo_atomic_set( &p_rt->discard, AVDISCARD_NONREF );
+}
+
+static void realtime_loaded( ffmpeg_reader_t *p_reader, int64_t start ){
+	realtime_t *p_rt = &p_reader->realtime;
+	p_rt->load_time += ( av_gettime_relative() - start - p_rt->load_time ) / 4;
+}
+
+// The requested picture was discarded and a later one stands in for it; a
+// gap in the timestamps alone is covered by the later picture, see
+// fetch_frame( ... ).
+static vooBOOL realtime_dropped( ffmpeg_reader_t *p_reader, int64_t frame ){
+	if( !p_reader->settings.realtime || p_reader->cur_frame == frame || p_reader->picture->opaque != &p_reader->realtime )
+		return FALSE;
+	p_reader->realtime.dropped++;
+	return TRUE;
+}
+
+// A demuxer and decoder of their own for work beside the reader's position.
+// "b_throughput" threads the decoder for whole ranges of pictures, otherwise
+// it decodes single pictures with the least latency.
+static vooBOOL private_decoder_open( ffmpeg_reader_t *p_reader, AVFormatContext **pp_format, AVCodecContext **pp_codec,
+	int32_t lowres, vooBOOL b_throughput ){
+	int32_t caps = p_reader->codec->capabilities;
+	uint32_t i;
+
+	if( 0 > io_open_input( pp_format, p_reader->filename, &p_reader->settings, p_reader ) )
+		return FALSE;
+	if( (uint32_t)p_reader->stream->index >= (*pp_format)->nb_streams )
+		goto fail;
+	for( i = 0; i < (*pp_format)->nb_streams; i++ )
+		if( (int32_t)i != p_reader->stream->index )
+			(*pp_format)->streams[ i ]->discard = AVDISCARD_ALL;
+
+	if( !(*pp_codec = avcodec_alloc_context3( p_reader->codec )) )
+		goto fail;
+	avcodec_parameters_to_context( *pp_codec, p_reader->stream->codecpar );
+	(*pp_codec)->opaque = p_reader;
+	(*pp_codec)->thread_count = decoder_threads( p_reader );
+	(*pp_codec)->thread_type = ( caps & AV_CODEC_CAP_SLICE_THREADS ? FF_THREAD_SLICE : 0 )
+		| ( b_throughput && ( caps & AV_CODEC_CAP_FRAME_THREADS ) ? FF_THREAD_FRAME : 0 );
+	(*pp_codec)->lowres = lowres;
+	if( p_reader->direct.b_enabled )
+		direct_attach( p_reader, *pp_codec );
+	if( 0 > avcodec_open2( *pp_codec, p_reader->codec, NULL ) )
+		goto fail;
+	return TRUE;
+
+fail:
+	avcodec_free_context( pp_codec );
+	io_close_input( pp_format );
+	return FALSE;
+}
+
+// Once the packet index is complete, frames are numbered in display order
+// and those numbered at a constant rate before are not asked for again.
+// Views sharing the cache may still number that way and keep them.
+static void cache_drop_estimated( frame_cache_t *p_cache ){
+	cache_entry_t *e, *next;
+	if( !p_cache )
+		return;
+	voo_mutex_lock( &g_caches.lock );
+	voo_mutex_lock( &p_cache->lock );
+	if( 1 == p_cache->refs )
+		for( e = p_cache->mru; e; e = next ){
+			next = e->next;
+			if( e->b_exact )
+				continue;
+			cache_unlink( p_cache, e );
+			cache_unhash( p_cache, e );
+			av_buffer_unref( &e->p_buf );
+			free( e );
+			p_cache->count--;
+		}
+	voo_mutex_unlock( &p_cache->lock );
+	voo_mutex_unlock( &g_caches.lock );
+}
+
+// On vooya's thread, the first time it finds the index complete.
+static void index_adopt( ffmpeg_reader_t *p_reader ){
+	if( p_reader->b_index_adopted || !index_ready( p_reader ) )
+		return;
+	p_reader->b_index_adopted = TRUE;
+	cache_drop_estimated( p_reader->p_cache );
+}
+
+// Caches a decoded picture vooya has not asked for yet.
+static void cache_put_picture( ffmpeg_reader_t *p_reader, int64_t frame, vooBOOL b_exact, const AVFrame *p_frame ){
+	AVBufferRef *p_buf;
+	if( frame_in_vooya_layout( p_reader, p_frame ) ){
+		cache_put_ref( p_reader->p_cache, frame, b_exact, p_frame->buf[ 0 ], (const char *)p_frame->data[ 0 ] );
+		return;
+	}
+	if( !(p_buf = picture_buffer( p_reader, p_reader->layout.size )) )
+		return;
+	if( transfer_picture( p_reader, p_frame, (char *)p_buf->data ) )
+		cache_insert( p_reader->p_cache, frame, b_exact, p_buf, (const char *)p_buf->data );
+	else
+		av_buffer_unref( &p_buf );
+}
+
+// Caches a copy of a picture vooya was handed.
+static void cache_put_copy( ffmpeg_reader_t *p_reader, int64_t frame, vooBOOL b_exact, const char *p_buffer ){
+	AVBufferRef *p_buf;
+	if( !cache_has( p_reader->p_cache, frame, b_exact ) && (p_buf = picture_buffer( p_reader, p_reader->layout.size )) ){
+		memcpy( p_buf->data, p_buffer, p_reader->layout.size );
+		cache_insert( p_reader->p_cache, frame, b_exact, p_buf, (const char *)p_buf->data );
+	}
+}
+
+// The range of pictures reconstructed for a backward step to "frame": from its
+// keyframe, but no more than a third of what the frame cache holds, so the
+// range being played and the one prefetched before it fit side by side.
+static int64_t reverse_range_start( ffmpeg_reader_t *p_reader, int64_t frame ){
+	int64_t window = FFMAX( p_reader->p_cache->budget / (int64_t)p_reader->layout.size / 3, 1 );
+	int64_t key = index_ready( p_reader ) ? keyframe_of( p_reader, frame ) : frame - MAX_DECODE_FORWARD + 1;
+	return FFMAX( FFMAX( key, frame - window + 1 ), 0 );
+}
+
+// Decodes from the keyframe of "first" through "last" and caches [first, last],
+// unless a newer range is posted meanwhile.
+static void reverse_decode( ffmpeg_reader_t *p_reader, int64_t first, int64_t last, uint32_t gen ){
+	reverse_t *r = &p_reader->reverse;
+	int32_t i_stream = p_reader->stream->index, i_ret;
+	AVFrame *p_frame = av_frame_alloc();
+	AVPacket pkt;
+	int64_t idx = first - 1;
+	// the range was asked for in this numbering; it ends where the index completes
+	vooBOOL b_exact = index_ready( p_reader );
+
+	av_init_packet( &pkt );
+	if( 0 > av_seek_frame( r->format_ctx, i_stream, frame_to_pts( p_reader, keyframe_of( p_reader, first ) ), AVSEEK_FLAG_BACKWARD ) ){
+		av_frame_free( &p_frame );
+		return;
+	}
+	avcodec_flush_buffers( r->codec_ctx );
+
+	while( idx < last && r->gen == gen && !r->b_stop && index_ready( p_reader ) == b_exact ){
+		i_ret = avcodec_receive_frame( r->codec_ctx, p_frame );
+		if( AVERROR( EAGAIN ) == i_ret ){
+			if( 0 > av_read_frame( r->format_ctx, &pkt ) )
+				avcodec_send_packet( r->codec_ctx, NULL );
+			else if( pkt.stream_index == i_stream )
+				avcodec_send_packet( r->codec_ctx, &pkt );
+			av_packet_unref( &pkt );
+			continue;
+		}
+		if( i_ret < 0 )
+			break;
+		idx = picture_index( p_reader, p_frame, idx );
+		if( first <= idx && idx <= last && !cache_has( p_reader->p_cache, idx, b_exact ) )
+			cache_put_picture( p_reader, idx, b_exact, p_frame );
+		av_frame_unref( p_frame );
+	}
+	av_frame_free( &p_frame );
+}
+
+static void reverse_thread( void *p_arg ){
+	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_arg;
+	reverse_t *r = &p_reader->reverse;
+	int64_t first, last;
+	uint32_t gen;
+
+	voo_mutex_lock( &r->lock );
+	while( !r->b_stop ){
+		if( r->last < 0 ){
+			voo_cond_wait( &r->cond, &r->lock );
+			continue;
+		}
+		first = r->first;
+		last = r->last;
+		gen = r->gen;
+		r->last = -1;
+		voo_mutex_unlock( &r->lock );
+
+		reverse_decode( p_reader, first, last, gen );
+
+		voo_mutex_lock( &r->lock );
+		r->done_gen = gen;
+		r->ranges++;
+		voo_cond_broadcast( &r->cond );
+	}
+	voo_mutex_unlock( &r->lock );
+}
+
+// a private demuxer and decoder, the reader's own ones keep their position
+static vooBOOL reverse_open( ffmpeg_reader_t *p_reader ){
+	reverse_t *r = &p_reader->reverse;
+
+	if( r->b_running || r->b_failed )
+		return r->b_running;
+	r->b_failed = TRUE;
+	// a whole range is decoded at once, throughput matters more than latency
+	if( !private_decoder_open( p_reader, &r->format_ctx, &r->codec_ctx, p_reader->codec_ctx->lowres, TRUE ) )
+		return FALSE;
+
+	r->last = -1;
+	voo_mutex_init( &r->lock );
+	voo_cond_init( &r->cond );
+	if( !voo_thread_create( &r->thread, reverse_thread, p_reader ) ){
+		voo_mutex_destroy( &r->lock );
+		voo_cond_destroy( &r->cond );
+		avcodec_free_context( &r->codec_ctx );
+		io_close_input( &r->format_ctx );
+		return FALSE;
+	}
+	r->b_running = TRUE;
+	r->b_failed = FALSE;
+	return TRUE;
+}
+
+static uint32_t reverse_post( reverse_t *r, int64_t first, int64_t last ){
+	uint32_t gen;
+	voo_mutex_lock( &r->lock );
+	r->first = first;
+	r->last = last;
+	gen = ++r->gen;
+	voo_cond_broadcast( &r->cond );
+	voo_mutex_unlock( &r->lock );
+	return gen;
+}
+
+// whether "frame" is a backward step that in_load( ... ) reconstructs itself;
+// intra-only streams decode any picture on its own anyway
+static vooBOOL reverse_step( ffmpeg_reader_t *p_reader, int64_t frame ){
+	reverse_t *r = &p_reader->reverse;
+	if( !p_reader->settings.reverse || p_reader->b_stream || p_reader->b_intra_only || p_reader->b_raw_v210
+		|| !p_reader->p_cache || p_reader->p_cache->budget < 3 * (int64_t)p_reader->layout.size )
+		return FALSE;
+	return frame < r->last_request && r->last_request - frame <= REVERSE_MAX_STEP;
+}
+
+// Counts backward steps; TRUE while vooya plays or steps backwards.
+static vooBOOL reverse_track( ffmpeg_reader_t *p_reader, int64_t frame ){
+	reverse_t *r = &p_reader->reverse;
+	if( reverse_step( p_reader, frame ) )
+		r->backward++;
+	else if( frame != r->last_request )
+		r->backward = 0;
+	r->last_request = frame;
+	return r->backward > 0;
+}
+
+// Reconstructs the range ending at "frame" into the cache and waits for it.
+static vooBOOL reverse_fetch( ffmpeg_reader_t *p_reader, int64_t frame ){
+	reverse_t *r = &p_reader->reverse;
+	uint32_t gen;
+	if( !reverse_open( p_reader ) )
+		return FALSE;
+
+	gen = reverse_post( r, reverse_range_start( p_reader, frame ), frame );
+	voo_mutex_lock( &r->lock );
+	while( r->done_gen != gen && r->gen == gen )
+		voo_cond_wait( &r->cond, &r->lock );
+	voo_mutex_unlock( &r->lock );
+	return TRUE;
+}
+
+// Once playback is going backwards, the range before the current one is
+// reconstructed in the background.
+static void reverse_prefetch( ffmpeg_reader_t *p_reader, int64_t frame ){
+	reverse_t *r = &p_reader->reverse;
+	int64_t prev = reverse_range_start( p_reader, frame ) - 1;
+	vooBOOL b_idle;
+
+	if( r->backward < 2 || prev < 0 || prev == r->prefetched || !reverse_open( p_reader ) )
+		return;
+	if( cache_has( p_reader->p_cache, prev, index_ready( p_reader ) ) )
+		return;
+	voo_mutex_lock( &r->lock );
+	b_idle = r->last < 0 && r->done_gen == r->gen;
+	voo_mutex_unlock( &r->lock );
+	if( b_idle ){
+		r->prefetched = prev;
+		reverse_post( r, reverse_range_start( p_reader, prev ), prev );
+	}
+}
+
+static void reverse_free( ffmpeg_reader_t *p_reader ){
+	reverse_t *r = &p_reader->reverse;
+	if( r->b_running ){
+		voo_mutex_lock( &r->lock );
+		r->b_stop = TRUE;
+		voo_cond_broadcast( &r->cond );
+		voo_mutex_unlock( &r->lock );
+		voo_thread_join( r->thread );
+		voo_mutex_destroy( &r->lock );
+		voo_cond_destroy( &r->cond );
+		avcodec_free_context( &r->codec_ctx );
+		io_close_input( &r->format_ctx );
+	}
+	memset( r, 0, sizeof(reverse_t) );
+}
+// Waits for the playhead to rest, then has vooya reload the picture shown in
+// scrub quality.
+static void scrub_thread( void *p_arg ){
+	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_arg;
+	scrub_t *p_scrub = &p_reader->scrub;
+	int64_t rest;
+
+	voo_mutex_lock( &p_scrub->lock );
+	while( !p_scrub->b_stop ){
+		if( p_scrub->shown < 0 ){
+			voo_cond_wait( &p_scrub->cond, &p_scrub->lock );
+			continue;
+		}
+		rest = p_scrub->last_time + p_reader->settings.scrub_ms * 1000LL - av_gettime_relative();
+		if( rest > 0 ){
+			voo_cond_timedwait( &p_scrub->cond, &p_scrub->lock, (int32_t)( rest / 1000 ) + 1 );
+			continue;
+		}
+		p_scrub->shown = -1;
+		voo_mutex_unlock( &p_scrub->lock );
+		p_reader->trigger_reload( p_reader->p_reload_cargo );
+		voo_mutex_lock( &p_scrub->lock );
+	}
+	voo_mutex_unlock( &p_scrub->lock );
+}
+
+static vooBOOL scrub_open( ffmpeg_reader_t *p_reader ){
+	scrub_t *p_scrub = &p_reader->scrub;
+	// relative to the reader's pictures, which may be proxies already
+	int32_t lowres = p_reader->b_scalable ? FFMIN( p_reader->proxy + p_reader->settings.scrub_lowres, p_reader->codec->max_lowres )
+		: p_reader->codec_ctx->lowres;
+
+	if( p_scrub->b_running || p_scrub->b_failed )
+		return p_scrub->b_running;
+	p_scrub->b_failed = TRUE;
+	if( !private_decoder_open( p_reader, &p_scrub->format_ctx, &p_scrub->codec_ctx, lowres, FALSE ) )
+		return FALSE;
+	p_scrub->codec_ctx->skip_frame = AVDISCARD_NONKEY;
+	p_scrub->lowres = p_scrub->codec_ctx->lowres;
+
+	voo_mutex_init( &p_scrub->lock );
+	voo_cond_init( &p_scrub->cond );
+	if( !voo_thread_create( &p_scrub->thread, scrub_thread, p_reader ) ){
+		voo_mutex_destroy( &p_scrub->lock );
+		voo_cond_destroy( &p_scrub->cond );
+		avcodec_free_context( &p_scrub->codec_ctx );
+		io_close_input( &p_scrub->format_ctx );
+		return FALSE;
+	}
+	p_scrub->b_running = TRUE;
+	p_scrub->b_failed = FALSE;
+	return TRUE;
+}
+
+// Whether "frame" is a jump that comes within the scrub interval of the
+// previous request; only jumps the decoder cannot serve by decoding on count.
+static vooBOOL scrub_jump( ffmpeg_reader_t *p_reader, int64_t frame ){
+	scrub_t *p_scrub = &p_reader->scrub;
+	if( !p_reader->settings.scrub_ms || !p_reader->trigger_reload || p_reader->b_stream || p_reader->b_intra_only || p_reader->b_raw_v210
+		|| p_scrub->b_failed || p_scrub->last_frame < 0 || frame == p_scrub->last_frame )
+		return FALSE;
+	if( !needs_seek( p_reader, frame ) || reverse_step( p_reader, frame ) )
+		return FALSE;
+	return av_gettime_relative() - p_scrub->last_time < p_reader->settings.scrub_ms * 1000LL;
+}
+
+static void scrub_track( ffmpeg_reader_t *p_reader, int64_t frame ){
+	scrub_t *p_scrub = &p_reader->scrub;
+	if( p_scrub->b_running )
+		voo_mutex_lock( &p_scrub->lock );
+	p_scrub->last_frame = frame;
+	p_scrub->last_time = av_gettime_relative();
+	if( p_scrub->b_running ){
+		voo_cond_broadcast( &p_scrub->cond );
+		voo_mutex_unlock( &p_scrub->lock );
+	}
+}
+
+// Decodes the keyframe at or before "frame" into p_buffer.
+static vooBOOL scrub_load( ffmpeg_reader_t *p_reader, int64_t frame, char *p_buffer ){
+	scrub_t *p_scrub = &p_reader->scrub;
+	int32_t i_stream = p_reader->stream->index, i_ret = AVERROR( EAGAIN );
+	AVFrame *p_frame;
+	AVPacket pkt;
+	vooBOOL b_ok = FALSE;
+
+	if( !scrub_open( p_reader ) )
+		return FALSE;
+	if( 0 > av_seek_frame( p_scrub->format_ctx, i_stream, frame_to_pts( p_reader, keyframe_of( p_reader, frame ) ), AVSEEK_FLAG_BACKWARD ) )
+		return FALSE;
+	avcodec_flush_buffers( p_scrub->codec_ctx );
+	if( !(p_frame = av_frame_alloc()) )
+		return FALSE;
+
+	// the first keyframe packet after the seek is all that is decoded
+	av_init_packet( &pkt );
+	while( 0 <= av_read_frame( p_scrub->format_ctx, &pkt ) ){
+		if( pkt.stream_index == i_stream && ( pkt.flags & AV_PKT_FLAG_KEY ) ){
+			avcodec_send_packet( p_scrub->codec_ctx, &pkt );
+			av_packet_unref( &pkt );
+			break;
+		}
+		av_packet_unref( &pkt );
+	}
+	avcodec_send_packet( p_scrub->codec_ctx, NULL );
+	i_ret = avcodec_receive_frame( p_scrub->codec_ctx, p_frame );
+
+	if( 0 <= i_ret )
+		b_ok = transfer_picture( p_reader, p_frame, p_buffer );
+	av_frame_free( &p_frame );
+	if( b_ok ){
+		voo_mutex_lock( &p_scrub->lock );
+		p_scrub->shown = frame;
+		p_scrub->pictures++;
+		voo_cond_broadcast( &p_scrub->cond );
+		voo_mutex_unlock( &p_scrub->lock );
+	}
+	return b_ok;
+}
+
+static void scrub_free( ffmpeg_reader_t *p_reader ){
+	scrub_t *p_scrub = &p_reader->scrub;
+	if( p_scrub->b_running ){
+		voo_mutex_lock( &p_scrub->lock );
+		p_scrub->b_stop = TRUE;
+		voo_cond_broadcast( &p_scrub->cond );
+		voo_mutex_unlock( &p_scrub->lock );
+		voo_thread_join( p_scrub->thread );
+		voo_mutex_destroy( &p_scrub->lock );
+		voo_cond_destroy( &p_scrub->cond );
+		avcodec_free_context( &p_scrub->codec_ctx );
+		io_close_input( &p_scrub->format_ctx );
+	}
+	memset( p_scrub, 0, sizeof(scrub_t) );
+}
+
+// Opens the decoder contexts planned by setup_threading( ... ) beside the
+// reader's own; fewer than two leave decoding to codec_ctx alone.
+static void intra_init( ffmpeg_reader_t *p_reader ){
+	intra_decode_t *p_intra = &p_reader->intra;
+	AVCodecContext *ctx;
+	int32_t i, n = p_intra->n_ctx;
+
+	p_intra->p_stats = &p_reader->stats;
+	if( n < 2 || p_reader->b_raw_v210 ){
+		p_intra->n_ctx = 0;
+		return;
+	}
+	p_intra->ctxs = (AVCodecContext **)calloc( n, sizeof(AVCodecContext *) );
+	p_intra->ctxs[ 0 ] = p_reader->codec_ctx;
+	for( i = 1; i < n; i++ ){
+		if( !(ctx = avcodec_alloc_context3( p_reader->codec )) )
+			break;
+		avcodec_parameters_to_context( ctx, p_reader->stream->codecpar );
+		ctx->opaque = p_reader;
+		ctx->thread_type = 0;
+		ctx->thread_count = 1;
+		ctx->lowres = p_reader->codec_ctx->lowres;
+		if( p_reader->direct.b_enabled )
+			direct_attach( p_reader, ctx );
+		if( 0 > avcodec_open2( ctx, p_reader->codec, NULL ) ){
+			avcodec_free_context( &ctx );
+			break;
+		}
+		p_intra->ctxs[ i ] = ctx;
+	}
+	if( (p_intra->n_ctx = i) < 2 ){
+		free( p_intra->ctxs );
+		p_intra->ctxs = NULL;
+		p_intra->n_ctx = 0;
+		return;
+	}
+	p_intra->pkts = (AVPacket *)calloc( n, sizeof(AVPacket) );
+	p_intra->frames = (AVFrame **)calloc( n, sizeof(AVFrame *) );
+	p_intra->results = (int32_t *)calloc( n, sizeof(int32_t) );
+	for( i = 0; i < n; i++ ){
+		av_init_packet( &p_intra->pkts[ i ] );
+		p_intra->frames[ i ] = av_frame_alloc();
+	}
+}
+
+// before codec_ctx, which is ctxs[ 0 ], goes
+static void intra_free( ffmpeg_reader_t *p_reader ){
+	intra_decode_t *p_intra = &p_reader->intra;
+	int32_t i;
+	if( !p_intra->ctxs )
+		return;
+
+	intra_reset( p_reader );
+	for( i = 0; i < p_intra->n_ctx; i++ ){
+		if( i )
+			avcodec_free_context( &p_intra->ctxs[ i ] );
+		av_frame_free( &p_intra->frames[ i ] );
+	}
+	free( p_intra->ctxs );
+	free( p_intra->pkts );
+	free( p_intra->frames );
+	free( p_intra->results );
+	memset( p_intra, 0, sizeof(intra_decode_t) );
+}
+
+// Opens the contexts and worker threads planned by setup_threading( ... );
+// they are used from the first seek after the packet index is complete.
+static void gop_init( ffmpeg_reader_t *p_reader ){
+	gop_decode_t *p_gop = &p_reader->gop;
+	gop_worker_t *p_worker;
+	AVCodecContext *ctx;
+	int32_t i, n = p_gop->n_ctx;
+
+	p_gop->n_ctx = 0;
+	if( n < 2 || p_reader->b_intra_only || p_reader->b_raw_v210 || !p_reader->settings.index )
+		return;
+	p_gop->ctxs = (AVCodecContext **)calloc( n, sizeof(AVCodecContext *) );
+	for( i = 0; i < n; i++ ){
+		if( !(ctx = avcodec_alloc_context3( p_reader->codec )) )
+			break;
+		avcodec_parameters_to_context( ctx, p_reader->stream->codecpar );
+		ctx->opaque = p_reader;
+		ctx->thread_type = 0;
+		ctx->thread_count = 1;
+		ctx->lowres = p_reader->codec_ctx->lowres;
+		if( p_reader->direct.b_enabled )
+			direct_attach( p_reader, ctx );
+		if( 0 > avcodec_open2( ctx, p_reader->codec, NULL ) ){
+			avcodec_free_context( &ctx );
+			break;
+		}
+		p_gop->ctxs[ i ] = ctx;
+	}
+	if( i < 2 ){
+		for( ; i > 0; i-- )
+			avcodec_free_context( &p_gop->ctxs[ i - 1 ] );
+		free( p_gop->ctxs );
+		p_gop->ctxs = NULL;
+		return;
+	}
+	p_gop->n_ctx = n = i;
+	p_gop->depth = (int32_t)FFMIN( FFMAX( p_reader->settings.gop_memory / FFMAX( p_reader->layout.size, 1 ) / n, 2 ), 1024 );
+	p_gop->jobs = (gop_job_t *)calloc( n, sizeof(gop_job_t) );
+	for( i = 0; i < n; i++ ){
+		int32_t f;
+		p_gop->jobs[ i ].frames = (AVFrame **)calloc( p_gop->depth, sizeof(AVFrame *) );
+		for( f = 0; f < p_gop->depth; f++ )
+			p_gop->jobs[ i ].frames[ f ] = av_frame_alloc();
+	}
+	voo_mutex_init( &p_gop->lock );
+	voo_cond_init( &p_gop->cond );
+	p_gop->threads = (voo_thread_t *)calloc( n, sizeof(voo_thread_t) );
+	// workers take GOPs in order, so fewer of them than contexts still make progress
+	for( i = 0; i < n; i++ ){
+		p_worker = (gop_worker_t *)malloc( sizeof(gop_worker_t) );
+		p_worker->p_reader = p_reader;
+		p_worker->i_ctx = i;
+		if( !voo_thread_create( &p_gop->threads[ i ], gop_thread, p_worker ) ){
+			free( p_worker );
+			break;
+		}
+	}
+	p_gop->n_threads = i;
+}
+
+static void gop_free( ffmpeg_reader_t *p_reader ){
+	gop_decode_t *p_gop = &p_reader->gop;
+	int32_t i;
+	if( !p_gop->ctxs )
+		return;
+
+	voo_mutex_lock( &p_gop->lock );
+	p_gop->b_stop = TRUE;
+	voo_cond_broadcast( &p_gop->cond );
+	voo_mutex_unlock( &p_gop->lock );
+	for( i = 0; i < p_gop->n_threads; i++ )
+		voo_thread_join( p_gop->threads[ i ] );
+
+	for( i = 0; i < p_gop->n_ctx; i++ ){
+		int32_t f;
+		gop_job_clear( p_gop, &p_gop->jobs[ i ] );
+		for( f = 0; f < p_gop->depth; f++ )
+			av_frame_free( &p_gop->jobs[ i ].frames[ f ] );
+		free( p_gop->jobs[ i ].frames );
+		avcodec_free_context( &p_gop->ctxs[ i ] );
+	}
+	for( i = 0; i < p_gop->pkt_count; i++ ){
+		memory_packets( p_reader->p_mem, -p_gop->pkt_buf[ i ].size );
+		av_packet_unref( &p_gop->pkt_buf[ i ] );
+	}
+	free( p_gop->pkt_buf );
+	free( p_gop->jobs );
+	free( p_gop->threads );
+	free( p_gop->ctxs );
+	voo_mutex_destroy( &p_gop->lock );
+	voo_cond_destroy( &p_gop->cond );
+	memset( p_gop, 0, sizeof(gop_decode_t) );
+}
+
+// Properties from the decoder's output format. As no stream info is probed,
+// the format may still be open; the first picture tells it then.
+static vooBOOL setup_pixel_format( ffmpeg_reader_t *p_reader ){
+	AVCodecParameters *p_par = p_reader->stream->codecpar;
+	voo_sequence_t *p_prop = &p_reader->properties;
+	enum AVPixelFormat fmt = p_reader->codec_ctx->pix_fmt;
+	const AVPixFmtDescriptor *p_desc;
+	int32_t lowres = p_reader->codec_ctx->lowres;
+
+	// as the decoder delivers them, see avcodec_open2( ... )
+	p_prop->width = AV_CEIL_RSHIFT( p_par->width, lowres );
+	p_prop->height = AV_CEIL_RSHIFT( p_par->height, lowres );
+
+	// proxies are decoded and scaled
+	if( AV_CODEC_ID_V210 == p_par->codec_id && p_par->width > 0 && 0 == p_par->width % 48 && !p_reader->settings.proxy ){
+		p_reader->b_raw_v210 = TRUE;
+		p_prop->arrangement = vooDA_v210;
+		p_prop->color_space = vooCS_YUV;
+		p_prop->channel_order = vooCO_c123;
+		p_prop->bits_per_channel = 10;
+		p_prop->chroma_subsampling_hor = 2;
+		p_prop->chroma_subsampling_ver = 1;
+		p_reader->layout.n_planes = 1;
+		p_reader->layout.row_bytes[ 0 ] = p_par->width / 48 * 128;
+		p_reader->layout.rows[ 0 ] = p_par->height;
+		p_reader->layout.size = (size_t)p_reader->layout.row_bytes[ 0 ] * p_par->height;
+		return TRUE;
+	}
 
-	int64_t expected_seek_tgt;
-	vooBOOL b_eof;
-#define ERRBUFF_LEN 2048
-	char last_err[ERRBUFF_LEN];
-	
-	void *p_msg_cargo;
-	void (*message)(void *,const char*);
+	if( AV_PIX_FMT_NONE == fmt || p_prop->width <= 0 || p_prop->height <= 0 ){
+		if( 0 > fetch_frame( p_reader, 0 ) ){
+			sprintf( p_reader->last_err, "No picture could be decoded." );
+			return FALSE;
+		}
+		fmt = (enum AVPixelFormat)p_reader->picture->format;
+		p_prop->width = p_reader->picture->width;
+		p_prop->height = p_reader->picture->height;
+	}
 
-} ffmpeg_reader_t;
+	if( !(p_reader->p_fmt = pix_fmt_lookup( fmt )) ){
+		sprintf( p_reader->last_err, "Pixel format %s is not supported.", pix_fmt_name( fmt ) );
+		return FALSE;
+	}
+	// the rest of the reduction lowres could not do
+	p_reader->b_scalable = !p_reader->p_fmt->repack && scale_supported( fmt );
+	p_reader->proxy = lowres;
+	if( p_reader->b_scalable && p_reader->settings.proxy > lowres ){
+		p_prop->width = AV_CEIL_RSHIFT( p_prop->width, p_reader->settings.proxy - lowres );
+		p_prop->height = AV_CEIL_RSHIFT( p_prop->height, p_reader->settings.proxy - lowres );
+		p_reader->proxy = p_reader->settings.proxy;
+	}
+	p_desc = av_pix_fmt_desc_get( p_reader->p_fmt->layout_fmt );
+	p_prop->arrangement = p_reader->p_fmt->arrangement;
+	p_prop->color_space = p_reader->p_fmt->color_space;
+	p_prop->channel_order = p_reader->p_fmt->channel_order;
+	p_prop->bits_per_channel = p_desc->comp[ 0 ].depth;
+	p_prop->b_toggle_endian = p_prop->bits_per_channel > 8 && ( p_desc->flags & AV_PIX_FMT_FLAG_BE );
+	p_prop->chroma_subsampling_hor = 1 << p_desc->log2_chroma_w;
+	p_prop->chroma_subsampling_ver = 1 << p_desc->log2_chroma_h;
+	return layout_compute( &p_reader->layout, p_reader->p_fmt->layout_fmt, p_prop->width, p_prop->height );
+}
 
 
+static int32_t segments_list( const char *filename, segment_t **pp_items );
+static vooBOOL segments_open( ffmpeg_reader_t *p_master, segment_t *p_items, int32_t count, voo_app_info_t *p_app_info );
+static void segments_close( ffmpeg_reader_t *p_master );
+static unsigned int segments_framecount( ffmpeg_reader_t *p_master );
+static vooBOOL segments_seek( ffmpeg_reader_t *p_master, int64_t frame );
+static vooBOOL segments_load( ffmpeg_reader_t *p_master, int64_t frame, char *p_buffer, vooBOOL *pb_skipped, void **pp_frame_user );
+static vooBOOL segments_meta( ffmpeg_reader_t *p_master, int idx, char *buffer_k, char *buffer_v );
 
+static int probe_interrupt( void *p_arg ){
+	return ((probe_t *)p_arg)->b_stop;
+}
 
+// The full stream analysis, on a demuxer of its own and unbounded.
+static void probe_thread( void *p_arg ){
+	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_arg;
+	probe_t *p_probe = &p_reader->probe;
+	reader_settings_t settings = p_reader->settings;
+	AVFormatContext *p_ctx = avformat_alloc_context();
+	AVRational rate = { 0, 1 };
+	int64_t bit_rate = 0, start = av_gettime_relative();
+	AVStream *st;
 
+	settings.fast_open = FALSE;
+	if( p_ctx ){
+		p_ctx->interrupt_callback.callback = probe_interrupt;
+		p_ctx->interrupt_callback.opaque = p_probe;
+		if( 0 <= io_open_input( &p_ctx, p_reader->filename, &settings, p_reader ) ){
+			if( 0 <= avformat_find_stream_info( p_ctx, NULL ) && (uint32_t)p_reader->stream->index < p_ctx->nb_streams
+				&& (st = p_ctx->streams[ p_reader->stream->index ])->codecpar->codec_id == p_reader->stream->codecpar->codec_id ){
+				rate = st->avg_frame_rate;
+				if( !rate.num || !rate.den )
+					rate = st->r_frame_rate;
+				bit_rate = st->codecpar->bit_rate;
+			}
+			io_close_input( &p_ctx );
+		}
+	}
+	voo_mutex_lock( &p_probe->lock );
+	p_probe->frame_rate = rate;
+	p_probe->bit_rate = bit_rate;
+	p_probe->analysis = av_gettime_relative() - start;
+	p_probe->b_done = TRUE;
+	voo_mutex_unlock( &p_probe->lock );
+}
 
-VP_API vooBOOL in_open( const vooChar_t *filename, voo_app_info_t *p_app_info, void **pp_user ){
-	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)malloc(sizeof(ffmpeg_reader_t));
-	memset( p_reader, 0x0, sizeof(ffmpeg_reader_t) );
-	*pp_user = p_reader;
+// Analyzes the streams in the background if opening fast left something open.
+static void probe_start( ffmpeg_reader_t *p_reader ){
+	probe_t *p_probe = &p_reader->probe;
+	if( p_probe->b_analyzed || p_reader->b_stream || ( !p_probe->b_rate_guessed && p_reader->stream->codecpar->bit_rate ) )
+		return;
+	voo_mutex_init( &p_probe->lock );
+	if( !(p_probe->b_running = voo_thread_create( &p_probe->thread, probe_thread, p_reader )) )
+		voo_mutex_destroy( &p_probe->lock );
+}
 
-	#ifdef WIN32
-	char c_filename[ 256 ];
-	sprintf( c_filename, "%ws", filename );
-	#else
-	const vooChar_t *c_filename = filename;
-	#endif
+// On vooya's thread. Frames keep being numbered at the rate assumed while
+// opening until the index is complete, so the rate found only changes the one
+// vooya plays at.
+static void probe_adopt( ffmpeg_reader_t *p_reader ){
+	probe_t *p_probe = &p_reader->probe;
+	if( !p_probe->b_running || p_probe->b_adopted )
+		return;
+	voo_mutex_lock( &p_probe->lock );
+	if( (p_probe->b_adopted = p_probe->b_done) ){
+		if( p_probe->b_rate_guessed && p_probe->frame_rate.num && p_probe->frame_rate.den ){
+			p_reader->properties.fps = av_q2d( p_probe->frame_rate );
+			p_reader->realtime.period = av_rescale_q( 1, av_inv_q( p_probe->frame_rate ), AV_TIME_BASE_Q );
+		}
+		if( !p_reader->stream->codecpar->bit_rate )
+			p_reader->stream->codecpar->bit_rate = p_probe->bit_rate;
+	}
+	voo_mutex_unlock( &p_probe->lock );
+}
 
-	av_log_set_callback( av_mute_log_callback );
+static void probe_free( ffmpeg_reader_t *p_reader ){
+	probe_t *p_probe = &p_reader->probe;
+	if( !p_probe->b_running )
+		return;
+	p_probe->b_stop = TRUE;
+	voo_thread_join( p_probe->thread );
+	voo_mutex_destroy( &p_probe->lock );
+	p_probe->b_running = FALSE;
+}
 
+static void reader_bind_app( ffmpeg_reader_t *p_reader, voo_app_info_t *p_app_info ){
 	p_reader->message = message;
 	if( p_app_info->pf_console_message ){
 		p_reader->p_msg_cargo = p_app_info->p_message_cargo;
 		p_reader->message = p_app_info->pf_console_message;
 	}
+	p_reader->p_reload_cargo = p_app_info->p_reload_cargo;
+	p_reader->trigger_reload = p_app_info->pf_trigger_reload;
+	readers_add( p_reader );
+}
 
-	if( !strcmp(c_filename,"-") ){
-		sprintf( p_reader->last_err, "stdin is not supported by the Quicktime Movie/Mp4 Input Plugin." );
-		p_reader->message( p_reader->p_msg_cargo, p_reader->last_err );
-		return FALSE;
-	}
+// Undoes reader_open( ... ), also where it failed halfway; p_reader itself is
+// left to the caller.
+static void reader_close( ffmpeg_reader_t *p_reader ){
+	readers_remove( p_reader );
+	// the decode-ahead thread may be waiting for a pipe's writer
+	stream_abort( io_of( p_reader->format_ctx ) );
+	probe_free( p_reader );
+	decode_ahead_free( p_reader );
+	gop_free( p_reader );
+	reverse_free( p_reader );
+	scrub_free( p_reader );
+	index_free( p_reader );
+	follow_free( p_reader );
+	caches_detach( &p_reader->p_cache );
+	av_freep( &p_reader->filename );
+	io_close_input( &p_reader->format_ctx );
+	av_frame_free( &p_reader->picture );
+	intra_free( p_reader );
+	avcodec_free_context( &p_reader->codec_ctx );
+	direct_free( p_reader );
+	avformat_free_context( p_reader->format_ctx );
+	memory_close( &p_reader->p_mem );
+}
+
+// Opens a single movie into p_reader, whose settings are filled in already;
+// what fails is closed again.
+static vooBOOL reader_open( ffmpeg_reader_t *p_reader, const char *c_filename, voo_app_info_t *p_app_info ){
+	probe_t *p_probe = &p_reader->probe;
+	int64_t start = av_gettime_relative(), t = start;
+
+	if( p_reader->settings.follow )
+		voo_mutex_init( &p_reader->follow.lock );
+	reader_bind_app( p_reader, p_app_info );
 
 	av_init_packet( &p_reader->avpkt );
+	p_reader->p_mem = memory_create( p_reader->settings.memory );
 	p_reader->picture = av_frame_alloc();
 	p_reader->format_ctx = avformat_alloc_context();
 
-	int ret = avformat_open_input( &p_reader->format_ctx, c_filename, NULL, NULL );
+	int ret = io_open_input( &p_reader->format_ctx, c_filename, &p_reader->settings, p_reader );
 
 	if( p_reader->format_ctx == NULL ) {
 		av_strerror( ret, p_reader->last_err, ERRBUFF_LEN );
+		reader_close( p_reader );
 		return FALSE;
 	}
+	p_reader->b_stream = io_of( p_reader->format_ctx ) && IO_STREAM == io_of( p_reader->format_ctx )->backend;
+	p_probe->header = av_gettime_relative() - t;
 
-	// if (!avformat_find_stream_info(p_reader->format_ctx, NULL)) {
-	// 	av_strerror(ret, p_reader->last_err, ERRBUFF_LEN);
-	// 	sprintf(p_reader->last_err, "No Video Stream found"); // TODO
-	// 	p_reader->message(p_reader->p_msg_cargo, p_reader->last_err);
-	// 	return FALSE;
-	// }
-
+	// opening fast, the streams are analyzed here only if the headers do not
+	// even name a video stream and its codec, else later, see probe_start( ... )
 	int video_stream_index = av_find_best_stream( p_reader->format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0x0 );
+	if( !p_reader->settings.fast_open || video_stream_index < 0 ){
+		t = av_gettime_relative();
+		if( 0 <= avformat_find_stream_info( p_reader->format_ctx, NULL ) )
+			video_stream_index = av_find_best_stream( p_reader->format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0x0 );
+		p_probe->stream_info = av_gettime_relative() - t;
+		p_probe->b_analyzed = TRUE;
+	}
 	if( video_stream_index == AVERROR_STREAM_NOT_FOUND ) {
 		sprintf( p_reader->last_err, "No Video Stream found" );
 		p_reader->message( p_reader->p_msg_cargo, p_reader->last_err );
+		reader_close( p_reader );
 		return FALSE;
 	} else if (video_stream_index == AVERROR_DECODER_NOT_FOUND) {
 		sprintf(p_reader->last_err, "No Decoder found");
 		p_reader->message(p_reader->p_msg_cargo, p_reader->last_err);
-		return FALSE;
-	} else if (video_stream_index == AVERROR_DECODER_NOT_FOUND) {
-		sprintf(p_reader->last_err, "No stream found");
-		p_reader->message(p_reader->p_msg_cargo, p_reader->last_err);
+		reader_close( p_reader );
 		return FALSE;
 	}
 
@@ -127,185 +5642,263 @@ VP_API vooBOOL in_open( const vooChar_t *filename, voo_app_info_t *p_app_info, v
 	{
 		sprintf( p_reader->last_err, "Cannot find a decoder with ID %i.", p_reader->stream->codecpar->codec_id);
 		p_reader->message( p_reader->p_msg_cargo, p_reader->last_err );
-		av_frame_free( &p_reader->picture );
-		avformat_close_input( &p_reader->format_ctx );
-		avformat_free_context( p_reader->format_ctx );
+		reader_close( p_reader );
 		return FALSE;
 	}
 
 	p_reader->codec_ctx = avcodec_alloc_context3( p_reader->codec );
 	avcodec_parameters_to_context( p_reader->codec_ctx, p_reader->stream->codecpar );
+	p_reader->codec_ctx->opaque = p_reader;
+	// proxies: decoders that can reduce the resolution themselves do
+	p_reader->codec_ctx->lowres = FFMIN( p_reader->settings.proxy, p_reader->codec->max_lowres );
 #if 0
 	if( p_reader->codec->capabilities & CODEC_CAP_TRUNCATED )
 		p_reader->codec_ctx->flags |= CODEC_FLAG_TRUNCATED; /* We may send incomplete frames */
 	if( p_reader->codec->capabilities & CODEC_FLAG2_CHUNKS )
 		p_reader->codec_ctx->flags |= CODEC_FLAG2_CHUNKS;
 #endif
+	t = av_gettime_relative();
+	setup_threading( p_reader );
+	direct_init( p_reader );
 	ret = avcodec_open2( p_reader->codec_ctx, p_reader->codec, NULL );
+	p_probe->decoder = av_gettime_relative() - t;
 	
 	if( ret != 0 ) {
-		av_frame_free( &p_reader->picture );
-		avformat_close_input( &p_reader->format_ctx );
-		avcodec_free_context( &p_reader->codec_ctx );
 		av_strerror( ret, p_reader->last_err, ERRBUFF_LEN );
+		reader_close( p_reader );
 		return FALSE;
 	}
 
 	memset( &p_reader->properties, 0, sizeof(voo_sequence_t) );
 
-	p_reader->properties.bits_per_channel = p_reader->stream->codecpar->bits_per_raw_sample;
-	if( p_reader->properties.bits_per_channel == 0 )
-		p_reader->properties.bits_per_channel = p_reader->stream->codecpar->bits_per_coded_sample / 3;
-	
-	switch( p_reader->codec_ctx->pix_fmt ){
-	case AV_PIX_FMT_YUV420P10LE:
-		p_reader->properties.arrangement = vooDA_planar_420;
-		p_reader->properties.bits_per_channel = 10;
-		break;
-	case AV_PIX_FMT_YUV422P10LE:
-		p_reader->properties.arrangement = vooDA_planar_422;
-		p_reader->properties.bits_per_channel = 10;
-		break;
-	default: break;
-	}
+	p_reader->frame_rate = p_reader->stream->avg_frame_rate;
+	if( !p_reader->frame_rate.num || !p_reader->frame_rate.den )
+		p_reader->frame_rate = p_reader->stream->r_frame_rate;
+	if( (p_probe->b_rate_guessed = !p_reader->frame_rate.num || !p_reader->frame_rate.den) )
+		p_reader->frame_rate = av_make_q( 25, 1 );
+	p_reader->properties.fps = av_q2d( p_reader->frame_rate );
+	p_reader->start_pts = p_reader->stream->start_time;
+	if( AV_NOPTS_VALUE == p_reader->start_pts )
+		p_reader->start_pts = 0;
+	p_reader->cur_frame = -1;
+	p_reader->next_frame = 0;
+	p_reader->reverse.last_request = p_reader->reverse.prefetched = -1;
+	p_reader->scrub.last_frame = p_reader->scrub.shown = -1;
+	p_reader->realtime.last_frame = -1;
+	p_reader->realtime.period = av_rescale_q( 1, av_inv_q( p_reader->frame_rate ), AV_TIME_BASE_Q );
 
-	if( p_reader->stream->codecpar->codec_id == AV_CODEC_ID_PRORES )
-	{
-		if( p_reader->stream->codecpar->codec_tag == 'h4pa' ){
-			p_reader->properties.arrangement = vooDA_planar_444;
-			if( 10 >= p_reader->properties.bits_per_channel )
-				p_reader->properties.bits_per_channel = 10;
-		} else {
-			p_reader->properties.arrangement = vooDA_planar_422;
-			if( 10 >= p_reader->properties.bits_per_channel )
-				p_reader->properties.bits_per_channel = 10;
-		}
+	t = av_gettime_relative();
+	if( !setup_pixel_format( p_reader ) ){
+		p_reader->message( p_reader->p_msg_cargo, p_reader->last_err );
+		reader_close( p_reader );
+		return FALSE;
 	}
-	else if( p_reader->stream->codecpar->codec_id == AV_CODEC_ID_V210 )
-	{
-		p_reader->properties.arrangement = vooDA_planar_422;
-		p_reader->properties.bits_per_channel = 10;
-	}
-	else {
-		if( p_reader->properties.arrangement == vooDataArrangement_Unknown )
-			p_reader->properties.arrangement = vooDA_planar_420;
-		if( 0 >= p_reader->properties.bits_per_channel )
-			p_reader->properties.bits_per_channel = 8;
-	}
-	p_reader->properties.color_space = vooCS_YUV;
-	p_reader->properties.channel_order = vooCO_c123;
-	p_reader->properties.fps = (double)p_reader->stream->avg_frame_rate.num / p_reader->stream->avg_frame_rate.den;
-	p_reader->properties.width = p_reader->stream->codecpar->width;
-	p_reader->properties.height = p_reader->stream->codecpar->height;
-	
-	p_reader->expected_seek_tgt = -1;
+	p_probe->format = av_gettime_relative() - t;
+	p_reader->properties.frame_size = (unsigned int)p_reader->layout.size;
+	direct_arm( p_reader );
+	intra_init( p_reader );
+	gop_init( p_reader );
+	p_reader->p_cache = caches_attach( p_reader, c_filename, p_reader->b_stream ? FFMAX( p_reader->settings.cache_bytes, STREAM_HISTORY * (int64_t)p_reader->layout.size )
+		: p_reader->settings.cache_bytes );
 
+	p_reader->filename = av_strdup( c_filename );
+	index_start( p_reader );
+	probe_start( p_reader );
+
+	if( !decode_ahead_init( p_reader ) ){
+		p_reader->message( p_reader->p_msg_cargo, p_reader->last_err );
+		reader_close( p_reader );
+		return FALSE;
+	}
+	if( !decode_ahead_start( p_reader ) ){
+		reader_close( p_reader );
+		return FALSE;
+	}
+	p_probe->total = av_gettime_relative() - start;
 	return TRUE;
 }
 
+VP_API vooBOOL in_open( const vooChar_t *filename, voo_app_info_t *p_app_info, void **pp_user ){
+	segment_t *p_items;
+	int32_t n;
+	vooBOOL b_ok;
+	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)malloc(sizeof(ffmpeg_reader_t));
+	memset( p_reader, 0x0, sizeof(ffmpeg_reader_t) );
+	*pp_user = p_reader;
+
+	#ifdef WIN32
+	char c_filename[ 256 ];
+	sprintf( c_filename, "%ws", filename );
+	#else
+	const vooChar_t *c_filename = filename;
+	#endif
+
+	settings_from_env( &p_reader->settings );
+	if( (n = segments_list( c_filename, &p_items )) > 0 )
+		b_ok = segments_open( p_reader, p_items, n, p_app_info );
+	else
+		b_ok = reader_open( p_reader, c_filename, p_app_info );
+	// vooya need not close what did not open
+	if( !b_ok ){
+		readers_remove( p_reader );
+		if( p_reader->p_segments )
+			segments_close( p_reader );
+	}
+	return b_ok;
+}
+
 VP_API void in_close( void *p_user ){
 	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_user;
-	avformat_close_input(&p_reader->format_ctx);
-	av_frame_free( &p_reader->picture );
-	avcodec_free_context( &p_reader->codec_ctx );
-	avformat_free_context( p_reader->format_ctx );
+	if( p_reader->p_segments ){
+		readers_remove( p_reader );
+		segments_close( p_reader );
+		return;
+	}
+	reader_close( p_reader );
 }
 
 VP_API vooBOOL in_get_properties( voo_sequence_t *p_info, void *p_user ){
 	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_user;
+	probe_adopt( p_reader );
 	*p_info = p_reader->properties;
 	return TRUE;
 }
 
 VP_API unsigned int in_framecount( void *p_user ){
 	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_user;
-	return ( unsigned int)p_reader->stream->nb_frames;
+	if( p_reader->p_segments )
+		return segments_framecount( p_reader );
+	follow_adopt( p_reader );
+	index_adopt( p_reader );
+	probe_adopt( p_reader );
+	// a stream is as long as it turns out to be
+	if( p_reader->b_stream )
+		return p_reader->b_eof ? ( unsigned int)p_reader->next_frame : ~0U;
+	if( index_ready( p_reader ) )
+		return ( unsigned int)p_reader->index.frames;
+	if( p_reader->stream->nb_frames > 0 )
+		return ( unsigned int)p_reader->stream->nb_frames;
+	// MKV and MXF often have no frame count in their headers
+	if( AV_NOPTS_VALUE != p_reader->stream->duration )
+		return ( unsigned int)av_rescale_q( p_reader->stream->duration, p_reader->stream->time_base, av_inv_q( p_reader->frame_rate ) );
+	if( AV_NOPTS_VALUE != p_reader->format_ctx->duration )
+		return ( unsigned int)av_rescale_q( p_reader->format_ctx->duration, AV_TIME_BASE_Q, av_inv_q( p_reader->frame_rate ) );
+	return 0;
 }
 
 VP_API vooBOOL in_seek( unsigned int frame, void *p_user )
 {
 	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_user;
 
-	int64_t seek_target;
-	seek_target = (int64_t)(((double)frame/p_reader->properties.fps) * AV_TIME_BASE);
-	seek_target = av_rescale_q(seek_target, AV_TIME_BASE_Q, p_reader->format_ctx->streams[p_reader->stream->index]->time_base);
-	p_reader->expected_seek_tgt = seek_target;
-	if( 0 <= av_seek_frame( p_reader->format_ctx, p_reader->stream->index, seek_target, AVSEEK_FLAG_FRAME/*|AVSEEK_FLAG_ANY*/ ) ){
-		avcodec_flush_buffers( p_reader->codec_ctx );
-		p_reader->b_eof = FALSE;
+	if( p_reader->p_segments )
+		return segments_seek( p_reader, frame );
+	follow_adopt( p_reader );
+	index_adopt( p_reader );
+	// stepping on and short jumps are served by decoding forward, cached
+	// pictures and backward steps by in_load( ... ) without the decoder
+	if( !needs_seek( p_reader, frame ) || cache_has( p_reader->p_cache, frame, index_ready( p_reader ) ) || reverse_step( p_reader, frame ) )
+		return TRUE;
+	// so does scrubbing, the reader seeks once the playhead rests
+	if( scrub_jump( p_reader, frame ) )
 		return TRUE;
+	if( p_reader->b_stream ){
+		stream_behind( p_reader, frame );
+		return FALSE;
 	}
-
-	return FALSE;
+	return reader_seek( p_reader, frame );
 }
 
-VP_API vooBOOL in_load( unsigned int frame, char *p_buffer, vooBOOL *pb_skipped, void **pp_frame_user, void *p_user )
+static vooBOOL reader_load( ffmpeg_reader_t *p_reader, int64_t frame, char *p_buffer, vooBOOL *pb_skipped, int64_t start )
 {
 	int32_t i_ret;
-	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_user;
-	try_again:
-	if( (i_ret = av_read_frame( p_reader->format_ctx, &p_reader->avpkt )) >= 0 ){
-
-		i_ret = avcodec_send_packet( p_reader->codec_ctx, &p_reader->avpkt );
-		if( AVERROR( EAGAIN ) == i_ret )
-			goto receive;
-		if( AVERROR_EOF == i_ret ){
-			p_reader->b_eof = TRUE;
-			return FALSE;
-		}
-		if( i_ret < 0 ) {
-			av_strerror( i_ret, p_reader->last_err, ERRBUFF_LEN );
-			goto try_again;
-		}
-		
-		receive:
-		i_ret = avcodec_receive_frame( p_reader->codec_ctx, p_reader->picture );
-		if( AVERROR( EAGAIN ) == i_ret ) goto try_again;
-		if( AVERROR_EOF == i_ret ){
-			p_reader->b_eof = TRUE;
-			return FALSE;
-		}
-		if( i_ret < 0 ) {
-			av_strerror( i_ret, p_reader->last_err, ERRBUFF_LEN );
-			return FALSE;
-		}
-		
-		if( i_ret == 0 )
-		{
-			if( p_reader->properties.arrangement == vooDA_v210 ){
-
-				int32_t pel_width = ( p_reader->properties.bits_per_channel + 7 ) >> 3;
-
-				memcpy( p_buffer,
-					p_reader->picture->data[ 0 ],
-					pel_width * p_reader->properties.width*p_reader->properties.height );
-
-			} else {
-				int32_t chr_sh_x = p_reader->properties.arrangement == vooDA_planar_444 ? 0 : 1;
-				int32_t chr_sh_y = p_reader->properties.arrangement == vooDA_planar_420 ? 1 : 0;
-				int32_t pel_width = ( p_reader->properties.bits_per_channel + 7 ) >> 3;
-
-				memcpy( p_buffer,
-					p_reader->picture->data[ 0 ],
-					pel_width * p_reader->properties.width*p_reader->properties.height );
-				memcpy( p_buffer + p_reader->properties.width*p_reader->properties.height*pel_width,
-					p_reader->picture->data[ 1 ],
-					pel_width * ( p_reader->properties.width >> chr_sh_x )*( p_reader->properties.height >> chr_sh_y ) );
-				memcpy( p_buffer + p_reader->properties.width*p_reader->properties.height*pel_width + ( p_reader->properties.width >> chr_sh_x )*( p_reader->properties.height >> chr_sh_y )*pel_width,
-					p_reader->picture->data[ 2 ],
-					pel_width * ( p_reader->properties.width >> chr_sh_x )*( p_reader->properties.height >> chr_sh_y ) );
-			}
-		}
-			
-	} else {
-	
+	vooBOOL b_scrub, b_reverse, b_exact;
+
+	follow_adopt( p_reader );
+	index_adopt( p_reader );
+	probe_adopt( p_reader );
+	b_exact = index_ready( p_reader );
+	b_scrub = scrub_jump( p_reader, frame );
+	b_reverse = reverse_track( p_reader, frame );
+
+	*pb_skipped = FALSE;
+	scrub_track( p_reader, frame );
+	realtime_track( p_reader, frame );
+	if( cache_get( p_reader->p_cache, frame, b_exact, p_buffer ) ){
+		if( b_reverse )
+			reverse_prefetch( p_reader, frame );
+		return TRUE;
+	}
+	if( b_reverse && reverse_fetch( p_reader, frame ) && cache_get( p_reader->p_cache, frame, b_exact, p_buffer ) ){
+		reverse_prefetch( p_reader, frame );
+		return TRUE;
+	}
+	// not cached: scrub pictures are replaced once the playhead rests
+	if( b_scrub && scrub_load( p_reader, frame, p_buffer ) )
+		return TRUE;
+
+	io_prefetch( p_reader, frame );
+	i_ret = fetch_frame( p_reader, frame );
+	realtime_loaded( p_reader, start );
+
+	if( AVERROR_EOF == i_ret ){
 		p_reader->b_eof = TRUE;
 		return FALSE;
 	}
+	if( i_ret < 0 ) {
+		if( AVERROR( EINVAL ) != i_ret )
+			av_strerror( i_ret, p_reader->last_err, ERRBUFF_LEN );
+		return FALSE;
+	}
+	// vooya keeps showing the previous picture
+	if( realtime_dropped( p_reader, frame ) ){
+		*pb_skipped = TRUE;
+		return TRUE;
+	}
+
+	if( !transfer_frame( p_reader, p_reader->picture, p_buffer ) )
+		return FALSE;
+	// a picture that is already in vooya's layout is referenced, not copied
+	if( frame_in_vooya_layout( p_reader, p_reader->picture ) )
+		cache_put_ref( p_reader->p_cache, frame, b_exact, p_reader->picture->buf[ 0 ], (const char *)p_reader->picture->data[ 0 ] );
+	else
+		cache_put_copy( p_reader, frame, b_exact, p_buffer );
 
 	return TRUE;
 }
 
+VP_API vooBOOL in_load( unsigned int frame, char *p_buffer, vooBOOL *pb_skipped, void **pp_frame_user, void *p_user )
+{
+	int64_t start = av_gettime_relative();
+	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_user;
+	vooBOOL b_ok;
+
+	if( p_reader->p_segments )
+		return segments_load( p_reader, frame, p_buffer, pb_skipped, pp_frame_user );
+	b_ok = reader_load( p_reader, frame, p_buffer, pb_skipped, start );
+	stats_add( &p_reader->stats, STAGE_LOAD, start, 0 );
+	stats_tick( p_reader );
+	return b_ok;
+}
+
+// vooya's callback for length changes, called on its thread by follow_adopt( ... )
+// and segments_tell( ... )
+VP_API void in_seq_len_changed( void (*seq_len_callback)( void *p_vooya_ctx, unsigned int new_len ), void *p_vooya_ctx, void *p_user ){
+	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_user;
+	if( p_reader->p_segments ){
+		voo_mutex_lock( &p_reader->p_segments->lock );
+		p_reader->p_segments->seq_len_changed = seq_len_callback;
+		p_reader->p_segments->p_vooya_ctx = p_vooya_ctx;
+		voo_mutex_unlock( &p_reader->p_segments->lock );
+		return;
+	}
+	if( !p_reader->settings.follow )
+		return;
+	voo_mutex_lock( &p_reader->follow.lock );
+	p_reader->follow.seq_len_changed = seq_len_callback;
+	p_reader->follow.p_vooya_ctx = p_vooya_ctx;
+	voo_mutex_unlock( &p_reader->follow.lock );
+}
+
 VP_API vooBOOL in_eof( void *p_user ){
 	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_user;
 	return p_reader->b_eof;
@@ -319,7 +5912,12 @@ VP_API vooBOOL get_meta( int idx, char *buffer_k, char *buffer_v, void *p_user_s
 {
 	int32_t _idx = 0;
 	ffmpeg_reader_t *p_reader = (ffmpeg_reader_t *)p_user_seq;
+	stats_t *p_stats = &p_reader->stats;
+	char stage[ 64 ];
+	int64_t seeks;
 
+	if( p_reader->p_segments )
+		return segments_meta( p_reader, idx, buffer_k, buffer_v );
 	if (idx == _idx++) {
 		char *codec = 0x0;
 		uint32_t fourcc = p_reader->stream->codecpar->codec_tag;
@@ -345,6 +5943,14 @@ VP_API vooBOOL get_meta( int idx, char *buffer_k, char *buffer_v, void *p_user_s
 			sprintf( buffer_k, "Codec" );
 			sprintf( buffer_v, "%s", codec );
 		}
+	} else if( idx == _idx++ ) {
+		sprintf( buffer_k, "Pixel format" );
+		if( p_reader->b_raw_v210 )
+			sprintf( buffer_v, "v210 (passed through)" );
+		else if( p_reader->p_fmt->repack )
+			sprintf( buffer_v, "%s (repacked to %s)", pix_fmt_name( p_reader->p_fmt->pix_fmt ), pix_fmt_name( p_reader->p_fmt->layout_fmt ) );
+		else
+			sprintf( buffer_v, "%s", pix_fmt_name( p_reader->p_fmt->pix_fmt ) );
 	} else if( p_reader->stream->codecpar->bit_rate && idx == _idx++ ) {
 		sprintf( buffer_k, "Bitrate" );
 		const char *unit = "";
@@ -357,6 +5963,144 @@ VP_API vooBOOL get_meta( int idx, char *buffer_k, char *buffer_v, void *p_user_s
 			bps /= 1e3f;
 		}
 		sprintf( buffer_v, "%1.2f%sb/s", bps, unit );
+	} else if( idx == _idx++ ) {
+		probe_t *p_probe = &p_reader->probe;
+		sprintf( buffer_k, "Opening" );
+		sprintf( buffer_v, "%1.1f ms: headers %1.1f, ", p_probe->total / 1e3, p_probe->header / 1e3 );
+		if( p_probe->b_analyzed )
+			sprintf( buffer_v + strlen( buffer_v ), "stream analysis %1.1f, ", p_probe->stream_info / 1e3 );
+		sprintf( buffer_v + strlen( buffer_v ), "decoder %1.1f, pixel format %1.1f", p_probe->decoder / 1e3, p_probe->format / 1e3 );
+		if( p_probe->b_running ){
+			voo_mutex_lock( &p_probe->lock );
+			if( p_probe->b_done )
+				sprintf( buffer_v + strlen( buffer_v ), "; streams analyzed in the background in %1.1f ms", p_probe->analysis / 1e3 );
+			else
+				sprintf( buffer_v + strlen( buffer_v ), "; analyzing the streams in the background" );
+			voo_mutex_unlock( &p_probe->lock );
+		}
+	} else if( idx == _idx++ ) {
+		sprintf( buffer_k, "Decoder threads" );
+		if( p_reader->intra.ctxs )
+			sprintf( buffer_v, "%i contexts (intra-only), %llu batches", p_reader->intra.n_ctx,
+				(unsigned long long)p_reader->intra.batches );
+		else if( p_reader->gop.b_active )
+			sprintf( buffer_v, "%i contexts (GOP-parallel), %llu GOPs", p_reader->gop.n_ctx,
+				(unsigned long long)p_reader->gop.gops );
+		else if( p_reader->codec_ctx->active_thread_type & FF_THREAD_FRAME )
+			sprintf( buffer_v, "%i (frame)", p_reader->codec_ctx->thread_count );
+		else if( p_reader->codec_ctx->active_thread_type & FF_THREAD_SLICE )
+			sprintf( buffer_v, "%i (slice)", p_reader->codec_ctx->thread_count );
+		else
+			sprintf( buffer_v, "1" );
+	} else if( p_reader->ahead.depth && idx == _idx++ ) {
+		sprintf( buffer_k, "Decode-ahead" );
+		voo_mutex_lock( &p_reader->ahead.lock );
+		sprintf( buffer_v, "%i/%i frames, %llu underruns", p_reader->ahead.count, p_reader->ahead.depth,
+			(unsigned long long)p_reader->ahead.underruns );
+		voo_mutex_unlock( &p_reader->ahead.lock );
+	} else if( p_reader->index.b_running && idx == _idx++ ) {
+		sprintf( buffer_k, "Frame index" );
+		if( index_ready( p_reader ) )
+			sprintf( buffer_v, "%i frames, %i keyframes%s", p_reader->index.frames, p_reader->index.keyframes,
+				p_reader->index.b_from_cache ? " (cached)" : "" );
+		else
+			sprintf( buffer_v, "building" );
+		if( p_reader->settings.follow ){
+			voo_mutex_lock( &p_reader->follow.lock );
+			sprintf( buffer_v + strlen( buffer_v ), ", following the file (%llu updates)", (unsigned long long)p_reader->follow.updates );
+			voo_mutex_unlock( &p_reader->follow.lock );
+		}
+	} else if( p_reader->p_cache && p_reader->p_cache->budget && idx == _idx++ ) {
+		frame_cache_t *p_cache = p_reader->p_cache;
+		sprintf( buffer_k, "Frame cache" );
+		voo_mutex_lock( &g_caches.lock );
+		voo_mutex_lock( &p_cache->lock );
+		sprintf( buffer_v, "%i frames (%1.0f of %1.0f MB), %llu hits, %llu misses", p_cache->count,
+			p_cache->count * (double)p_cache->frame_size / ( 1 << 20 ), p_cache->budget / (double)( 1 << 20 ),
+			(unsigned long long)p_cache->hits, (unsigned long long)p_cache->misses );
+		if( p_cache->refs > 1 )
+			sprintf( buffer_v + strlen( buffer_v ), ", shared by %i views", p_cache->refs );
+		voo_mutex_unlock( &p_cache->lock );
+		voo_mutex_unlock( &g_caches.lock );
+	} else if( p_reader->p_mem && idx == _idx++ ) {
+		memory_t *p_mem = p_reader->p_mem;
+		sprintf( buffer_k, "Memory" );
+		voo_mutex_lock( &p_mem->lock );
+		sprintf( buffer_v, "%1.0f MB (pictures %1.0f, %i idle, packets %1.0f), peak %1.0f MB, %llu buffers allocated, %llu reused",
+			( p_mem->pictures + p_mem->packets ) / (double)( 1 << 20 ), p_mem->pictures / (double)( 1 << 20 ), p_mem->n_idle,
+			p_mem->packets / (double)( 1 << 20 ), p_mem->peak / (double)( 1 << 20 ),
+			(unsigned long long)p_mem->allocs, (unsigned long long)p_mem->reuses );
+		if( p_mem->ceiling )
+			sprintf( buffer_v + strlen( buffer_v ), ", limit %1.0f MB (%llu refused)", p_mem->ceiling / (double)( 1 << 20 ),
+				(unsigned long long)p_mem->refusals );
+		voo_mutex_unlock( &p_mem->lock );
+	} else if( io_of( p_reader->format_ctx ) && idx == _idx++ ) {
+		file_io_t *p_io = io_of( p_reader->format_ctx );
+		sprintf( buffer_k, "File input" );
+		if( IO_STREAM == p_io->backend )
+			sprintf( buffer_v, "stream, %lli of %lli MiB buffered, %lli MiB read", (long long)( ( voo_atomic_get( &p_io->written ) - voo_atomic_get( &p_io->consumed ) ) >> 20 ),
+				(long long)( p_io->ring_size >> 20 ), (long long)( voo_atomic_get( &p_io->consumed ) >> 20 ) );
+		else if( IO_MMAP == p_io->backend )
+			sprintf( buffer_v, "mapped, %lli MiB readahead", (long long)( p_io->readahead >> 20 ) );
+		else
+			sprintf( buffer_v, "%i KiB reads, %lli MiB readahead", p_io->p_avio->buffer_size >> 10, (long long)( p_io->readahead >> 20 ) );
+#ifndef WIN32
+		if( p_io->p_prefetch ){
+			prefetcher_t *p_pf = (prefetcher_t *)p_io->p_prefetch;
+			voo_mutex_lock( &p_pf->lock );
+			sprintf( buffer_v + strlen( buffer_v ), ", %i packets prefetched by %s (%llu hits, %llu waited for, %llu misses)", p_pf->n_slots,
+	#ifdef HAVE_IO_URING
+				p_pf->ring_fd >= 0 ? "io_uring" :
+	#endif
+				"pread threads", (unsigned long long)p_pf->hits, (unsigned long long)p_pf->waits, (unsigned long long)p_pf->misses );
+			voo_mutex_unlock( &p_pf->lock );
+		}
+#endif
+	} else if( p_reader->proxy && idx == _idx++ ) {
+		sprintf( buffer_k, "Proxy" );
+		sprintf( buffer_v, "1/%i resolution, decoded at 1/%i", 1 << p_reader->proxy, 1 << p_reader->codec_ctx->lowres );
+	} else if( p_reader->settings.realtime && idx == _idx++ ) {
+		static const char *discards[] = { "nothing", "non-reference pictures", "B-pictures" };
+		int32_t d = (int32_t)voo_atomic_get( &p_reader->realtime.discard );
+		sprintf( buffer_k, "Real-time playback" );
+		sprintf( buffer_v, "%llu pictures dropped, %llu stalls, discarding %s", (unsigned long long)p_reader->realtime.dropped,
+			(unsigned long long)p_reader->realtime.restarts, discards[ d >= AVDISCARD_BIDIR ? 2 : d >= AVDISCARD_NONREF ? 1 : 0 ] );
+	} else if( p_reader->scrub.b_running && idx == _idx++ ) {
+		sprintf( buffer_k, "Scrubbing" );
+		voo_mutex_lock( &p_reader->scrub.lock );
+		sprintf( buffer_v, "%llu keyframes shown at 1/%i resolution", (unsigned long long)p_reader->scrub.pictures, 1 << p_reader->scrub.lowres );
+		voo_mutex_unlock( &p_reader->scrub.lock );
+	} else if( p_reader->reverse.b_running && idx == _idx++ ) {
+		sprintf( buffer_k, "Reverse playback" );
+		voo_mutex_lock( &p_reader->reverse.lock );
+		sprintf( buffer_v, "%llu ranges reconstructed", (unsigned long long)p_reader->reverse.ranges );
+		voo_mutex_unlock( &p_reader->reverse.lock );
+	} else if( p_reader->direct.b_enabled && idx == _idx++ ) {
+		sprintf( buffer_k, "Zero-copy decoding" );
+		voo_mutex_lock( &p_reader->direct.lock );
+		if( AV_PIX_FMT_NONE == p_reader->direct.pix_fmt )
+			sprintf( buffer_v, "not applicable" );
+		else
+			sprintf( buffer_v, "%llu of %llu pictures", (unsigned long long)p_reader->direct.frames,
+				(unsigned long long)( p_reader->direct.frames + p_reader->direct.fallbacks ) );
+		voo_mutex_unlock( &p_reader->direct.lock );
+	} else if( stats_format( &p_stats->stages[ STAGE_LOAD ], stage ) && idx == _idx++ ) {
+		sprintf( buffer_k, "Loading" );
+		sprintf( buffer_v, "%1.1f fps, %s", voo_atomic_get( &p_stats->fps_x100 ) / 100.0, stage );
+	} else if( stats_format( &p_stats->stages[ STAGE_DEMUX ], stage ) && idx == _idx++ ) {
+		sprintf( buffer_k, "Demuxing" );
+		sprintf( buffer_v, "%1.1f MB/s, %s", voo_atomic_get( &p_stats->bytes_per_s ) / (double)( 1 << 20 ), stage );
+	} else if( stats_format( &p_stats->stages[ STAGE_SEND ], stage ) && idx == _idx++ ) {
+		sprintf( buffer_k, "Decoding" );
+		sprintf( buffer_v, "sending packets %s", stage );
+		if( stats_format( &p_stats->stages[ STAGE_RECEIVE ], stage ) )
+			sprintf( buffer_v + strlen( buffer_v ), "; receiving pictures %s", stage );
+	} else if( stats_format( &p_stats->stages[ STAGE_TRANSFER ], stage ) && idx == _idx++ ) {
+		sprintf( buffer_k, "Picture copy" );
+		sprintf( buffer_v, "%s", stage );
+	} else if( (seeks = stats_format( &p_stats->stages[ STAGE_SEEK ], stage )) && idx == _idx++ ) {
+		sprintf( buffer_k, "Seeking" );
+		sprintf( buffer_v, "%lli seeks, %s", (long long)seeks, stage );
 	}
 	else return FALSE;
 	return TRUE;
@@ -369,6 +6113,513 @@ VP_API void in_error( const char **pp_err, void *p_user_seq )
 }
 
 
+// Segmented sequences, see segments_t.
+
+static vooBOOL segments_push( segment_t **pp_items, int32_t *p_count, char *filename, const char *init ){
+	segment_t *p_items;
+	if( !filename )
+		return FALSE;
+	if( !( *p_count & 63 ) ){
+		if( !(p_items = (segment_t *)realloc( *pp_items, ( *p_count + 64 ) * sizeof(segment_t) )) ){
+			av_free( filename );
+			return FALSE;
+		}
+		*pp_items = p_items;
+	}
+	memset( &(*pp_items)[ *p_count ], 0, sizeof(segment_t) );
+	(*pp_items)[ *p_count ].filename = filename;
+	(*pp_items)[ *p_count ].init = init ? av_strdup( init ) : NULL;
+	(*p_count)++;
+	return TRUE;
+}
+
+static void segments_free_list( segment_t *p_items, int32_t count ){
+	int32_t i;
+	for( i = 0; i < count; i++ ){
+		av_free( p_items[ i ].filename );
+		av_free( p_items[ i ].init );
+		av_free( p_items[ i ].err );
+	}
+	free( p_items );
+}
+
+static vooBOOL segments_has_suffix( const char *filename, const char *suffix ){
+	size_t n = strlen( filename ), m = strlen( suffix ), i;
+	if( n <= m )
+		return FALSE;
+	for( i = 0; i < m; i++ )
+		if( tolower( (unsigned char)filename[ n - m + i ] ) != suffix[ i ] )
+			return FALSE;
+	return TRUE;
+}
+
+// "clip_%04d.mp4": a single %d conversion, with an optional width
+static vooBOOL segments_is_pattern( const char *filename ){
+	const char *p = strchr( filename, '%' );
+	if( !p || strchr( p + 1, '%' ) )
+		return FALSE;
+	for( p++; isdigit( (unsigned char)*p ); p++ );
+	return 'd' == *p;
+}
+
+// playlist entries are relative to the playlist
+static char *segments_resolve( const char *playlist, const char *entry ){
+	const char *p, *slash = NULL;
+	char *path;
+	if( '/' == entry[ 0 ] || '\\' == entry[ 0 ] || ( entry[ 0 ] && ':' == entry[ 1 ] ) )
+		return av_strdup( entry );
+	for( p = playlist; *p; p++ )
+		if( '/' == *p || '\\' == *p )
+			slash = p;
+	if( !slash )
+		return av_strdup( entry );
+	if( (path = (char *)av_malloc( slash + 1 - playlist + strlen( entry ) + 1 )) ){
+		memcpy( path, playlist, slash + 1 - playlist );
+		strcpy( path + ( slash + 1 - playlist ), entry );
+	}
+	return path;
+}
+
+// numbered from 0 or 1 on, up to the first number missing
+static int32_t segments_numbered( const char *pattern, segment_t **pp_items ){
+	char path[ 2048 ];
+	cache_key_t key;
+	int32_t i, first, count = 0;
+	for( first = 0; first < 2; first++ ){
+		snprintf( path, sizeof(path), pattern, first );
+		if( file_key_of( path, &key ) )
+			break;
+	}
+	for( i = first; first < 2; i++ ){
+		snprintf( path, sizeof(path), pattern, i );
+		if( !file_key_of( path, &key ) || !segments_push( pp_items, &count, av_strdup( path ), NULL ) )
+			break;
+	}
+	return count;
+}
+
+// An .m3u8 or .m3u list of local files, with HLS init segments (EXT-X-MAP).
+// Byte ranges, variant streams and remote segments are left to libavformat's
+// own HLS demuxer, which then opens the playlist as a single movie.
+static int32_t segments_playlist( const char *filename, segment_t **pp_items ){
+	char line[ 4096 ], *init = NULL, *p, *q;
+	int32_t count = 0, n;
+	FILE *f;
+
+	if( !(f = fopen( filename, "r" )) )
+		return 0;
+	while( fgets( line, sizeof(line), f ) ){
+		for( n = (int32_t)strlen( line ); n && isspace( (unsigned char)line[ n - 1 ] ); line[ --n ] = 0 );
+		if( !n )
+			continue;
+		if( !strncmp( line, "#EXT-X-BYTERANGE", 16 ) || !strncmp( line, "#EXT-X-STREAM-INF", 17 ) || strstr( line, "://" )
+			|| ( !strncmp( line, "#EXT-X-MAP:", 11 ) && strstr( line, "BYTERANGE" ) ) )
+			goto unsupported;
+		if( !strncmp( line, "#EXT-X-MAP:", 11 ) ){
+			if( !(p = strstr( line, "URI=\"" )) || !(q = strchr( p + 5, '"' )) )
+				goto unsupported;
+			*q = 0;
+			av_free( init );
+			init = segments_resolve( filename, p + 5 );
+		} else if( '#' != line[ 0 ] && !segments_push( pp_items, &count, segments_resolve( filename, line ), init ) )
+			goto unsupported;
+	}
+	fclose( f );
+	av_free( init );
+	return count;
+
+unsupported:
+	fclose( f );
+	av_free( init );
+	segments_free_list( *pp_items, count );
+	*pp_items = NULL;
+	return 0;
+}
+
+// The segments "filename" stands for, 0 if it is a single movie.
+static int32_t segments_list( const char *filename, segment_t **pp_items ){
+	cache_key_t key;
+	*pp_items = NULL;
+	if( segments_is_pattern( filename ) && !file_key_of( filename, &key ) )
+		return segments_numbered( filename, pp_items );
+	if( segments_has_suffix( filename, ".m3u8" ) || segments_has_suffix( filename, ".m3u" ) )
+		return segments_playlist( filename, pp_items );
+	return 0;
+}
+
+// The frames of a segment: from its header, or by counting its video packets.
+static int32_t segment_count_frames( ffmpeg_reader_t *p_master, const segment_t *p_item ){
+	reader_settings_t settings = p_master->settings;
+	AVFormatContext *p_ctx = NULL;
+	AVPacket pkt;
+	int32_t i_stream, n = 0;
+	uint32_t i;
+
+	settings.init_segment = p_item->init;
+	if( 0 > io_open_input( &p_ctx, p_item->filename, &settings, p_master ) )
+		return 0;
+	if( 0 <= (i_stream = av_find_best_stream( p_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0 )) ){
+		if( p_ctx->streams[ i_stream ]->nb_frames > 0 )
+			n = (int32_t)p_ctx->streams[ i_stream ]->nb_frames;
+		else {
+			for( i = 0; i < p_ctx->nb_streams; i++ )
+				if( (int32_t)i != i_stream )
+					p_ctx->streams[ i ]->discard = AVDISCARD_ALL;
+			av_init_packet( &pkt );
+			while( 0 <= av_read_frame( p_ctx, &pkt ) ){
+				n += pkt.stream_index == i_stream && !( pkt.flags & AV_PKT_FLAG_DISCARD );
+				av_packet_unref( &pkt );
+			}
+		}
+	}
+	io_close_input( &p_ctx );
+	return n;
+}
+
+// Counts the frames of the next segment not surveyed yet; "surveyed" is only
+// advanced here, by one thread at a time. The background thread asks vooya to
+// reload so that segments_tell( ... ) gets to run even if it is idle.
+static void segments_survey( ffmpeg_reader_t *p_master ){
+	segments_t *p_seg = p_master->p_segments;
+	int32_t s = p_seg->surveyed, n;
+	vooBOOL b_nudge;
+
+	n = segment_count_frames( p_master, &p_seg->items[ s ] );
+	voo_mutex_lock( &p_seg->lock );
+	p_seg->items[ s ].frames = n;
+	p_seg->items[ s ].first = p_seg->total;
+	p_seg->total += n;
+	p_seg->surveyed++;
+	b_nudge = n && p_seg->b_running && !p_seg->b_nudged && p_seg->seq_len_changed;
+	if( b_nudge )
+		p_seg->b_nudged = TRUE;
+	voo_cond_broadcast( &p_seg->cond );
+	voo_mutex_unlock( &p_seg->lock );
+
+	if( b_nudge && p_master->trigger_reload )
+		p_master->trigger_reload( p_master->p_reload_cargo );
+}
+
+// On vooya's thread: tells vooya the length surveyed so far, if it changed.
+static void segments_tell( ffmpeg_reader_t *p_master ){
+	segments_t *p_seg = p_master->p_segments;
+	void (*seq_len_changed)( void *, unsigned int ) = NULL;
+	void *p_vooya_ctx;
+	int64_t total;
+
+	voo_mutex_lock( &p_seg->lock );
+	p_seg->b_nudged = FALSE;
+	if( (total = p_seg->total) != p_seg->told ){
+		p_seg->told = total;
+		seq_len_changed = p_seg->seq_len_changed;
+		p_vooya_ctx = p_seg->p_vooya_ctx;
+	}
+	voo_mutex_unlock( &p_seg->lock );
+	if( seq_len_changed )
+		seq_len_changed( p_vooya_ctx, (unsigned int)total );
+}
+
+// The segment holding "frame", waiting for the survey to get there; -1 past the end.
+static int32_t segments_locate( segments_t *p_seg, int64_t frame ){
+	int32_t lo = 0, hi, mid;
+	if( frame < 0 )
+		return -1;
+	voo_mutex_lock( &p_seg->lock );
+	while( frame >= p_seg->total && p_seg->surveyed < p_seg->count && p_seg->b_running && !p_seg->b_stop )
+		voo_cond_wait( &p_seg->cond, &p_seg->lock );
+	if( frame >= p_seg->total ){
+		voo_mutex_unlock( &p_seg->lock );
+		return -1;
+	}
+	// the last segment starting at or before "frame"; empty ones start where the next one does
+	for( hi = p_seg->surveyed - 1; lo < hi; ){
+		mid = ( lo + hi + 1 ) >> 1;
+		if( p_seg->items[ mid ].first <= frame ) lo = mid;
+		else hi = mid - 1;
+	}
+	voo_mutex_unlock( &p_seg->lock );
+	return lo;
+}
+
+// Opens the reader of segment "s", on vooya's thread or the background one.
+// The first segment opened decides what the sequence looks like.
+static ffmpeg_reader_t *segment_open( ffmpeg_reader_t *p_master, int32_t s ){
+	segment_t *p_item = &p_master->p_segments->items[ s ];
+	ffmpeg_reader_t *p_sub = (ffmpeg_reader_t *)calloc( 1, sizeof(ffmpeg_reader_t) );
+	const voo_sequence_t *a = &p_master->properties, *b;
+
+	if( !p_sub )
+		return NULL;
+	p_sub->b_segment = TRUE;
+	p_sub->settings = p_master->settings;
+	p_sub->settings.memory /= SEGMENTS_OPEN;
+	p_sub->settings.init_segment = p_item->init;
+	if( !reader_open( p_sub, p_item->filename, &p_master->p_segments->app_info ) ){
+		p_item->err = av_strdup( p_sub->last_err );
+		free( p_sub );
+		return NULL;
+	}
+	b = &p_sub->properties;
+	if( a->frame_size && ( a->width != b->width || a->height != b->height || a->frame_size != b->frame_size
+		|| a->color_space != b->color_space || a->arrangement != b->arrangement || a->channel_order != b->channel_order
+		|| a->bits_per_channel != b->bits_per_channel || a->chroma_subsampling_hor != b->chroma_subsampling_hor
+		|| a->chroma_subsampling_ver != b->chroma_subsampling_ver ) ){
+		p_item->err = av_strdup( "its pictures differ in size or format from the first segment's" );
+		in_close( p_sub );
+		free( p_sub );
+		return NULL;
+	}
+	return p_sub;
+}
+
+// Opens the segments asked for by segments_prefetch( ... ) and surveys the rest.
+static void segments_thread( void *p_arg ){
+	ffmpeg_reader_t *p_master = (ffmpeg_reader_t *)p_arg;
+	segments_t *p_seg = p_master->p_segments;
+	ffmpeg_reader_t *p_sub;
+	int32_t s;
+
+	voo_mutex_lock( &p_seg->lock );
+	while( !p_seg->b_stop ){
+		if( (s = p_seg->want) >= 0 ){
+			p_seg->want = -1;
+			if( p_seg->items[ s ].p_reader || p_seg->items[ s ].b_failed )
+				continue;
+			p_seg->opening = s;
+			voo_mutex_unlock( &p_seg->lock );
+			p_sub = segment_open( p_master, s );
+			voo_mutex_lock( &p_seg->lock );
+			p_seg->items[ s ].p_reader = p_sub;
+			p_seg->items[ s ].b_failed = !p_sub;
+			p_seg->items[ s ].last_used = ++p_seg->clock;
+			p_seg->opening = -1;
+			voo_cond_broadcast( &p_seg->cond );
+		} else if( p_seg->surveyed < p_seg->count ){
+			voo_mutex_unlock( &p_seg->lock );
+			segments_survey( p_master );
+			voo_mutex_lock( &p_seg->lock );
+		} else
+			voo_cond_wait( &p_seg->cond, &p_seg->lock );
+	}
+	voo_mutex_unlock( &p_seg->lock );
+}
+
+// Has the background thread open the next segment with frames after "s".
+static void segments_prefetch( segments_t *p_seg, int32_t s ){
+	voo_mutex_lock( &p_seg->lock );
+	for( s++; s < p_seg->surveyed && !p_seg->items[ s ].frames; s++ );
+	if( s < p_seg->surveyed && !p_seg->items[ s ].p_reader && !p_seg->items[ s ].b_failed && s != p_seg->opening ){
+		p_seg->want = s;
+		voo_cond_broadcast( &p_seg->cond );
+	}
+	voo_mutex_unlock( &p_seg->lock );
+}
+
+// Closes the least recently used readers beyond SEGMENTS_OPEN; only vooya's
+// thread closes readers.
+static void segments_evict( segments_t *p_seg ){
+	ffmpeg_reader_t *p_sub;
+	int32_t i, n, lru;
+	for( ;; ){
+		voo_mutex_lock( &p_seg->lock );
+		for( n = 0, lru = -1, i = 0; i < p_seg->count; i++ ){
+			if( !p_seg->items[ i ].p_reader )
+				continue;
+			n++;
+			if( i != p_seg->current && ( lru < 0 || p_seg->items[ i ].last_used < p_seg->items[ lru ].last_used ) )
+				lru = i;
+		}
+		if( n <= SEGMENTS_OPEN || lru < 0 ){
+			voo_mutex_unlock( &p_seg->lock );
+			return;
+		}
+		p_sub = p_seg->items[ lru ].p_reader;
+		p_seg->items[ lru ].p_reader = NULL;
+		voo_mutex_unlock( &p_seg->lock );
+		in_close( p_sub );
+		free( p_sub );
+	}
+}
+
+// The reader of segment "s", opened in the background ideally.
+static ffmpeg_reader_t *segments_reader( ffmpeg_reader_t *p_master, int32_t s ){
+	segments_t *p_seg = p_master->p_segments;
+	segment_t *p_item = &p_seg->items[ s ];
+	ffmpeg_reader_t *p_sub;
+	vooBOOL b_switch;
+
+	voo_mutex_lock( &p_seg->lock );
+	if( (b_switch = s != p_seg->current) ){
+		p_seg->switches++;
+		if( s == p_seg->opening )
+			p_seg->waited++;
+		else if( !p_item->p_reader )
+			p_seg->missed++;
+	}
+	while( s == p_seg->opening )
+		voo_cond_wait( &p_seg->cond, &p_seg->lock );
+	if( s == p_seg->want )
+		p_seg->want = -1;
+	p_seg->current = s;
+	p_item->last_used = ++p_seg->clock;
+	p_sub = p_item->p_reader;
+	voo_mutex_unlock( &p_seg->lock );
+
+	if( !p_sub && !p_item->b_failed ){
+		p_sub = segment_open( p_master, s );
+		voo_mutex_lock( &p_seg->lock );
+		p_item->p_reader = p_sub;
+		p_item->b_failed = !p_sub;
+		voo_mutex_unlock( &p_seg->lock );
+		b_switch = TRUE;
+	}
+	if( !p_sub ){
+		snprintf( p_master->last_err, ERRBUFF_LEN, "Cannot open segment %s: %s", p_item->filename, p_item->err ? p_item->err : "" );
+		return NULL;
+	}
+	if( b_switch )
+		segments_evict( p_seg );
+	return p_sub;
+}
+
+static vooBOOL segments_open( ffmpeg_reader_t *p_master, segment_t *p_items, int32_t count, voo_app_info_t *p_app_info ){
+	segments_t *p_seg = (segments_t *)calloc( 1, sizeof(segments_t) );
+	int64_t start = av_gettime_relative();
+	int32_t s;
+
+	reader_bind_app( p_master, p_app_info );
+	if( !p_seg ){
+		segments_free_list( p_items, count );
+		return FALSE;
+	}
+	p_master->p_segments = p_seg;
+	p_seg->items = p_items;
+	p_seg->count = count;
+	p_seg->app_info = *p_app_info;
+	p_seg->want = p_seg->opening = -1;
+	voo_mutex_init( &p_seg->lock );
+	voo_cond_init( &p_seg->cond );
+
+	// mostly the whole length is known right away, the survey of long lists
+	// of segments without frame counts in their headers goes on in the background
+	do
+		segments_survey( p_master );
+	while( p_seg->surveyed < p_seg->count && ( !p_seg->total || av_gettime_relative() - start < SEGMENT_SURVEY_TIME ) );
+	if( (s = segments_locate( p_seg, 0 )) < 0 ){
+		sprintf( p_master->last_err, "None of the %i segments holds video frames.", count );
+		p_master->message( p_master->p_msg_cargo, p_master->last_err );
+		return FALSE;
+	}
+	p_seg->current = s;
+	if( !(p_seg->items[ s ].p_reader = segment_open( p_master, s )) ){
+		snprintf( p_master->last_err, ERRBUFF_LEN, "Cannot open segment %s: %s", p_seg->items[ s ].filename,
+			p_seg->items[ s ].err ? p_seg->items[ s ].err : "" );
+		p_master->message( p_master->p_msg_cargo, p_master->last_err );
+		return FALSE;
+	}
+	p_master->properties = p_seg->items[ s ].p_reader->properties;
+
+	if( !(p_seg->b_running = voo_thread_create( &p_seg->thread, segments_thread, p_master )) )
+		while( p_seg->surveyed < p_seg->count )
+			segments_survey( p_master );
+	segments_prefetch( p_seg, s );
+	return TRUE;
+}
+
+static void segments_close( ffmpeg_reader_t *p_master ){
+	segments_t *p_seg = p_master->p_segments;
+	int32_t i;
+	if( p_seg->b_running ){
+		voo_mutex_lock( &p_seg->lock );
+		p_seg->b_stop = TRUE;
+		voo_cond_broadcast( &p_seg->cond );
+		voo_mutex_unlock( &p_seg->lock );
+		voo_thread_join( p_seg->thread );
+	}
+	for( i = 0; i < p_seg->count; i++ )
+		if( p_seg->items[ i ].p_reader ){
+			in_close( p_seg->items[ i ].p_reader );
+			free( p_seg->items[ i ].p_reader );
+		}
+	segments_free_list( p_seg->items, p_seg->count );
+	voo_mutex_destroy( &p_seg->lock );
+	voo_cond_destroy( &p_seg->cond );
+	free( p_seg );
+	p_master->p_segments = NULL;
+}
+
+static unsigned int segments_framecount( ffmpeg_reader_t *p_master ){
+	int64_t total;
+	voo_mutex_lock( &p_master->p_segments->lock );
+	total = p_master->p_segments->told = p_master->p_segments->total;
+	voo_mutex_unlock( &p_master->p_segments->lock );
+	return (unsigned int)total;
+}
+
+static vooBOOL segments_seek( ffmpeg_reader_t *p_master, int64_t frame ){
+	segments_t *p_seg = p_master->p_segments;
+	ffmpeg_reader_t *p_sub;
+	int32_t s;
+
+	segments_tell( p_master );
+	if( (s = segments_locate( p_seg, frame )) < 0 ){
+		sprintf( p_master->last_err, "Frame %lli lies beyond the last segment.", (long long)frame );
+		return FALSE;
+	}
+	if( !(p_sub = segments_reader( p_master, s )) )
+		return FALSE;
+	p_master->b_eof = FALSE;
+	if( in_seek( (unsigned int)( frame - p_seg->items[ s ].first ), p_sub ) )
+		return TRUE;
+	memcpy( p_master->last_err, p_sub->last_err, ERRBUFF_LEN );
+	return FALSE;
+}
+
+static vooBOOL segments_load( ffmpeg_reader_t *p_master, int64_t frame, char *p_buffer, vooBOOL *pb_skipped, void **pp_frame_user ){
+	segments_t *p_seg = p_master->p_segments;
+	ffmpeg_reader_t *p_sub;
+	int32_t s;
+
+	*pb_skipped = FALSE;
+	segments_tell( p_master );
+	if( (s = segments_locate( p_seg, frame )) < 0 ){
+		p_master->b_eof = TRUE;
+		return FALSE;
+	}
+	if( !(p_sub = segments_reader( p_master, s )) )
+		return FALSE;
+	// the next segment opens and decodes its first pictures while this one plays
+	segments_prefetch( p_seg, s );
+	if( in_load( (unsigned int)( frame - p_seg->items[ s ].first ), p_buffer, pb_skipped, pp_frame_user, p_sub ) )
+		return TRUE;
+	memcpy( p_master->last_err, p_sub->last_err, ERRBUFF_LEN );
+	voo_mutex_lock( &p_seg->lock );
+	p_master->b_eof = in_eof( p_sub ) && p_seg->surveyed == p_seg->count
+		&& p_seg->items[ s ].first + p_seg->items[ s ].frames == p_seg->total;
+	voo_mutex_unlock( &p_seg->lock );
+	return FALSE;
+}
+
+// A row of its own, then the current segment's
+static vooBOOL segments_meta( ffmpeg_reader_t *p_master, int idx, char *buffer_k, char *buffer_v ){
+	segments_t *p_seg = p_master->p_segments;
+	ffmpeg_reader_t *p_sub;
+
+	voo_mutex_lock( &p_seg->lock );
+	p_sub = p_seg->items[ p_seg->current ].p_reader;
+	if( 0 == idx ){
+		sprintf( buffer_k, "Segments" );
+		snprintf( buffer_v, 1024, "%i of %i (%s), %i surveyed, %llu switches, %llu waited for the next segment, %llu opened it on demand",
+			p_seg->current + 1, p_seg->count, p_seg->items[ p_seg->current ].filename, p_seg->surveyed,
+			(unsigned long long)p_seg->switches, (unsigned long long)p_seg->waited, (unsigned long long)p_seg->missed );
+	}
+	voo_mutex_unlock( &p_seg->lock );
+	if( 0 == idx )
+		return TRUE;
+	return p_sub ? get_meta( idx - 1, buffer_k, buffer_v, p_sub ) : FALSE;
+}
+
+
 
 
 VP_API vooBOOL in_responsible( const vooChar_t *_filename, char *sixteen_bytes, void *p_user ){
@@ -383,13 +6634,17 @@ VP_API vooBOOL in_responsible( const vooChar_t *_filename, char *sixteen_bytes,
 	return !voo_strcmp( filename + voo_strlen( filename ) - 4, _v( ".mov" ) )
 		|| !voo_strcmp( filename + voo_strlen( filename ) - 4, _v( ".mkv" ) )
 		|| !voo_strcmp( filename + voo_strlen( filename ) - 4, _v( ".mxf" ) )
-		|| !voo_strcmp( filename + voo_strlen( filename ) - 4, _v( ".mp4" ) );
+		|| !voo_strcmp( filename + voo_strlen( filename ) - 4, _v( ".mp4" ) )
+		|| !voo_strcmp( filename + voo_strlen( filename ) - 4, _v( ".m3u" ) )
+		|| ( voo_strlen( filename ) > 5 && !voo_strcmp( filename + voo_strlen( filename ) - 5, _v( ".m3u8" ) ) );
 }
 
 VP_API vooBOOL in_file_suffixes( int idx, char const **pp_suffix, void *p_user ){
 	switch(idx){
 	case 0: *pp_suffix = "mov"; break;
 	case 1: *pp_suffix = "mp4"; break;
+	case 2: *pp_suffix = "m3u8"; break;
+	case 3: *pp_suffix = "m3u"; break;
 	default: return FALSE;
 	}
 	return TRUE;
@@ -397,6 +6652,14 @@ VP_API vooBOOL in_file_suffixes( int idx, char const **pp_suffix, void *p_user )
 
 
 
+static void on_unload_plugin( void *p_user ){
+	// the callback must not outlive the library
+	if( g_readers.b_log )
+		av_log_set_callback( av_log_default_callback );
+	pool_shutdown();
+}
+
+
 const char g_version[2048];
 VP_API void voo_describe( voo_plugin_t *p_plugin )
 {
@@ -436,7 +6699,10 @@ VP_API void voo_describe( voo_plugin_t *p_plugin )
 	p_plugin->input.error_msg = in_error;
 	p_plugin->input.reload = in_reload;
 	p_plugin->input.get_meta = get_meta;
+	p_plugin->input.cb_seq_len_changed = in_seq_len_changed;
+	p_plugin->on_unload_plugin = on_unload_plugin;
 	p_plugin->input.b_fileBased = TRUE;
+	// decoded pictures are cached by the plugin itself, within a byte budget (see frame_cache_t)
 	p_plugin->input.flags = VOOInputFlag_DoNotCache;
 }
 